@@ -0,0 +1,117 @@
+/** @file MidiArena.c
+ *  @brief Bump allocation for event payloads
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#ifndef MIDIARENA_H_
+#include "MidiArena.h"
+#endif
+
+/** @fn static struct MidiArenaBlock *newBlock(size_t size)
+ *  @brief Allocate an empty block
+ */
+static struct MidiArenaBlock *newBlock(size_t size)
+{
+    struct MidiArenaBlock *b;
+
+    b = (struct MidiArenaBlock *)malloc(sizeof(struct MidiArenaBlock) + size);
+    if (b == NULL)
+        return NULL;
+    b->next = NULL;
+    b->size = size;
+    b->used = 0;
+    return b;
+}
+
+/** @fn static size_t arenaSize(const struct MidiArena *a)
+ *  @brief Combined size of the blocks of an arena
+ */
+static size_t arenaSize(const struct MidiArena *a)
+{
+    const struct MidiArenaBlock *b;
+    size_t size = 0;
+
+    for (b = a->head; b != NULL; b = b->next)
+        size += b->size;
+    return size;
+}
+
+/** @fn void initMidiArena(struct MidiArena *a)
+ *  @brief Set up an empty arena, no memory is allocated until it is used
+ */
+void initMidiArena(struct MidiArena *a)
+{
+    a->head = NULL;
+    a->peak = 0;
+}
+
+/** @fn void *midiArenaAlloc(struct MidiArena *a, size_t size)
+ *  @brief Allocate from an arena
+ *
+ * The memory stays valid until the arena is reset or freed.\n
+ * Allocations are not aligned, the arena holds byte payloads only.
+ *
+ * @param a: The arena
+ * @param size: Number of bytes
+ * @return The memory, NULL if a new block could not be allocated
+ */
+void *midiArenaAlloc(struct MidiArena *a, size_t size)
+{
+    struct MidiArenaBlock *b = a->head;
+    size_t blockSize;
+
+    if ((b == NULL) || (b->size - b->used < size))
+    {
+        // Each new block doubles the arena, at least the size asked for
+        blockSize = (b == NULL) ? MIDI_ARENA_BLOCK : arenaSize(a);
+        if (blockSize < size)
+            blockSize = size;
+        if ((b = newBlock(blockSize)) == NULL)
+            return NULL;
+        b->next = a->head;
+        a->head = b;
+        if (arenaSize(a) > a->peak)
+            a->peak = arenaSize(a);
+    }
+    b->used += size;
+    return b->data + b->used - size;
+}
+
+/** @fn void resetMidiArena(struct MidiArena *a)
+ *  @brief Release everything allocated from an arena, keeping its memory
+ *
+ * An arena that grew past one block is replaced by a single block of
+ * the combined size.
+ */
+void resetMidiArena(struct MidiArena *a)
+{
+    size_t size;
+
+    if (a->head == NULL)
+        return;
+    if (a->head->next != NULL)
+    {
+        size = arenaSize(a);
+        freeMidiArena(a);
+        a->head = newBlock(size);
+        return;
+    }
+    a->head->used = 0;
+}
+
+/** @fn void freeMidiArena(struct MidiArena *a)
+ *  @brief Release the memory of an arena
+ */
+void freeMidiArena(struct MidiArena *a)
+{
+    struct MidiArenaBlock *b;
+
+    while ((b = a->head) != NULL)
+    {
+        a->head = b->next;
+        free(b);
+    }
+}
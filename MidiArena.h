@@ -0,0 +1,72 @@
+/** @file MidiArena.h
+ *  @brief Bump allocation for event payloads and (pointer, length) views
+ *
+ *  This contains the data structures and functions for a per-file bump
+ *  arena. Payloads read from a stream are placed one after the other in
+ *  large blocks and released all at once, so decoding does no malloc()
+ *  per event. When the file is held in memory payloads are not copied
+ *  at all, a view points straight into the file data.
+ *
+ *  A reset keeps the memory: if the arena had to grow it is merged into
+ *  one block of the combined size, so the next file of the same size
+ *  allocates nothing and the peak footprint is that of the largest file.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#ifndef MIDIINFO_H_
+#include "MidiInfo.h"
+#endif
+
+#ifndef MIDIARENA_H_
+#define MIDIARENA_H_
+
+/// @brief Size of the first block of an arena
+#ifndef MIDI_ARENA_BLOCK
+#define MIDI_ARENA_BLOCK 65536
+#endif
+
+// Data Structures
+/** @struct MidiView
+ *  @brief Bytes of a payload, in the file data or in an arena
+ *
+ * Data is not NUL terminated, print it with "%.*s".\n
+ */
+struct MidiView
+{
+	const unsigned char *data;
+	size_t len;
+};
+
+/** @struct MidiArenaBlock
+ *  @brief One block of an arena, blocks are chained newest first
+ */
+struct MidiArenaBlock
+{
+	struct MidiArenaBlock *next;
+	size_t size, used;
+	unsigned char data[];
+};
+
+/** @struct MidiArena
+ *  @brief A bump allocator released all at once by resetMidiArena()
+ *
+ * Head is the block being filled, NULL until the first allocation.\n
+ * Peak is the most memory the arena has held, for reports.\n
+ */
+struct MidiArena
+{
+	struct MidiArenaBlock *head;
+	size_t peak;
+};
+
+// Function Prototypes
+void initMidiArena(struct MidiArena *a);
+void *midiArenaAlloc(struct MidiArena *a, size_t size);
+void resetMidiArena(struct MidiArena *a);
+void freeMidiArena(struct MidiArena *a);
+
+#endif
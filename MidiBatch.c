@@ -0,0 +1,437 @@
+/** @file MidiBatch.c
+ *  @brief Running a job over many MIDI files on a pool of worker threads
+ *
+ *  Files are handed out to the workers one at a time from a shared
+ *  index. Each worker writes the results for a file to its own memory
+ *  buffer, which is copied to the output in one piece once the file
+ *  is done, so results from different files never interleave.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#include <dirent.h>
+#include <pthread.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef MIDIBATCH_H_
+#include "MidiBatch.h"
+#endif
+
+#ifndef MIDIPROFILE_H_
+#include "MidiProfile.h"
+#endif
+
+/** @struct BatchState
+ *  @brief State shared by the workers of one runMidiBatch() call
+ */
+struct BatchState
+{
+    const struct MidiFileList *list;
+    int (*job)(const char *filename, FILE *out, void *arg);
+    void *arg;
+    FILE *out;
+
+    pthread_mutex_t nextLock, outLock;
+    size_t next;
+    int failures;
+};
+
+/** @struct ParallelState
+ *  @brief State shared by the workers of one runMidiParallel() call
+ */
+struct ParallelState
+{
+    size_t count;
+    void (*fn)(size_t i, void *arg);
+    void *arg;
+
+    pthread_mutex_t nextLock;
+    size_t next;
+};
+
+/** @fn int addMidiFile(struct MidiFileList *list, const char *path)
+ *  @brief Add a single path to a file list
+ *
+ * @param list: The list to add to
+ * @param path: The path to add, it is copied
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+int addMidiFile(struct MidiFileList *list, const char *path)
+{
+    char **paths;
+    size_t capacity;
+
+    if (list->count == list->capacity)
+    {
+        capacity = list->capacity ? list->capacity * 2 : 256;
+        paths = (char **)realloc(list->paths, capacity * sizeof(char *));
+        if (paths == NULL)
+            return -1;
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+    list->paths[list->count] = strdup(path);
+    if (list->paths[list->count] == NULL)
+        return -1;
+    list->count++;
+    return 0;
+}
+
+/** @fn static int isMidiFileName(const char *name)
+ *  @brief Check for a MIDI file extension (.mid, .midi, .kar, .smf)
+ */
+static int isMidiFileName(const char *name)
+{
+    const char *ext = strrchr(name, '.');
+
+    if (ext == NULL)
+        return 0;
+    return (strcasecmp(ext, ".mid") == 0) || (strcasecmp(ext, ".midi") == 0) ||
+           (strcasecmp(ext, ".kar") == 0) || (strcasecmp(ext, ".smf") == 0);
+}
+
+/** @fn static int addMidiDirectory(struct MidiFileList *list, const char *dir)
+ *  @brief Recursively add the MIDI files found under a directory
+ *
+ * Symbolic links to directories are not followed, to avoid loops.
+ */
+static int addMidiDirectory(struct MidiFileList *list, const char *dir)
+{
+    DIR *d;
+    struct dirent *entry;
+    struct stat st;
+    char *path;
+    size_t len;
+    int isDir, isFile, ret = 0;
+
+    d = opendir(dir);
+    if (d == NULL)
+    {
+        fprintf(stderr, "Unable to open directory: %s\n", dir);
+        return 0;
+    }
+
+    while ((ret == 0) && ((entry = readdir(d)) != NULL))
+    {
+        if ((strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0))
+            continue;
+
+        len = strlen(dir) + strlen(entry->d_name) + 2;
+        path = (char *)malloc(len);
+        if (path == NULL)
+        {
+            ret = -1;
+            break;
+        }
+        snprintf(path, len, "%s/%s", dir, entry->d_name);
+
+        isDir = (entry->d_type == DT_DIR);
+        isFile = (entry->d_type == DT_REG);
+        if ((entry->d_type == DT_UNKNOWN) && (lstat(path, &st) == 0))
+        {
+            isDir = S_ISDIR(st.st_mode);
+            isFile = S_ISREG(st.st_mode);
+        }
+        else if ((entry->d_type == DT_LNK) && (stat(path, &st) == 0))
+        {
+            isFile = S_ISREG(st.st_mode);
+        }
+
+        if (isDir)
+            ret = addMidiDirectory(list, path);
+        else if (isFile && isMidiFileName(entry->d_name))
+            ret = addMidiFile(list, path);
+        free(path);
+    }
+    closedir(d);
+    return ret;
+}
+
+/** @fn int addMidiPath(struct MidiFileList *list, const char *path)
+ *  @brief Add a file, or every MIDI file below a directory, to a file list
+ *
+ * Files named directly are always added. Directories are searched
+ * recursively for files ending in .mid, .midi, .kar or .smf.
+ *
+ * @param list: The list to add to
+ * @param path: A file or directory
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+int addMidiPath(struct MidiFileList *list, const char *path)
+{
+    struct stat st;
+
+    if ((stat(path, &st) == 0) && S_ISDIR(st.st_mode))
+        return addMidiDirectory(list, path);
+    return addMidiFile(list, path);
+}
+
+/** @fn int addMidiManifest(struct MidiFileList *list, const char *manifest)
+ *  @brief Add the paths listed in a manifest file
+ *
+ * The manifest has one path per line, "-" reads it from stdin.\n
+ * Blank lines and lines starting with '#' are ignored. Each path is
+ * added with addMidiPath(), so directories may be listed too.
+ *
+ * @param list: The list to add to
+ * @param manifest: The manifest file
+ * @return 0 on success, -1 if the manifest can't be read or memory could not be allocated
+ */
+int addMidiManifest(struct MidiFileList *list, const char *manifest)
+{
+    FILE *f;
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    int ret = 0;
+
+    f = (strcmp(manifest, "-") == 0) ? stdin : fopen(manifest, "r");
+    if (f == NULL)
+        return -1;
+
+    while ((ret == 0) && ((len = getline(&line, &cap, f)) != -1))
+    {
+        while ((len > 0) && ((line[len - 1] == '\n') || (line[len - 1] == '\r')))
+            line[--len] = '\0';
+        if ((len == 0) || (line[0] == '#'))
+            continue;
+        ret = addMidiPath(list, line);
+    }
+
+    free(line);
+    if (f != stdin)
+        fclose(f);
+    return ret;
+}
+
+/** @fn void freeMidiFileList(struct MidiFileList *list)
+ *  @brief Release the paths held by a file list
+ *
+ * @param list: The list to release
+ */
+void freeMidiFileList(struct MidiFileList *list)
+{
+    size_t i;
+
+    for (i = 0; i < list->count; i++)
+        free(list->paths[i]);
+    free(list->paths);
+    list->paths = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+/** @fn int midiWorkerCount(void)
+ *  @brief Number of worker threads to use by default
+ *
+ * @return The number of online processors, at least 1
+ */
+int midiWorkerCount(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (n > 0) ? (int)n : 1;
+}
+
+/** @fn static void *batchWorker(void *p)
+ *  @brief Worker thread, processes files until the list is exhausted
+ */
+static void *batchWorker(void *p)
+{
+    struct BatchState *state = (struct BatchState *)p;
+    char *buffer = NULL;
+    size_t size = 0, i;
+    FILE *out;
+    int failures = 0;
+
+    out = open_memstream(&buffer, &size);
+    if (out == NULL)
+    {
+        perror("Unable to create worker output buffer");
+        pthread_mutex_lock(&state->nextLock);
+        state->failures++;
+        pthread_mutex_unlock(&state->nextLock);
+        return NULL;
+    }
+
+    for (;;)
+    {
+        pthread_mutex_lock(&state->nextLock);
+        i = state->next++;
+        pthread_mutex_unlock(&state->nextLock);
+        if (i >= state->list->count)
+            break;
+
+        if (state->job(state->list->paths[i], out, state->arg) != 0)
+            failures++;
+
+        // Hand the whole result for this file to the output at once
+        fflush(out);
+        pthread_mutex_lock(&state->outLock);
+        fwrite(buffer, 1, size, state->out);
+        pthread_mutex_unlock(&state->outLock);
+        rewind(out);
+    }
+
+    fclose(out);
+    free(buffer);
+
+    pthread_mutex_lock(&state->nextLock);
+    state->failures += failures;
+    pthread_mutex_unlock(&state->nextLock);
+    return NULL;
+}
+
+/** @fn int runMidiBatch(const struct MidiFileList *list, int numWorkers, int (*job)(const char *filename, FILE *out, void *arg), void *arg, FILE *out)
+ *  @brief Run a job over every file of a list on a pool of worker threads
+ *
+ * The job is called once per file with the worker's output buffer,
+ * it returns 0 on success and non-zero on failure. The job must be
+ * safe to call from several threads at once.\n
+ * Results appear on out one whole file at a time, in completion order.
+ *
+ * @param list: The files to process
+ * @param numWorkers: Number of worker threads, 0 or less for one per processor
+ * @param job: The function to run for each file
+ * @param arg: Passed to the job unchanged
+ * @param out: The stream the results are written to
+ * @return The number of files the job failed on, -1 if memory could not be allocated
+ */
+int runMidiBatch(const struct MidiFileList *list, int numWorkers,
+                 int (*job)(const char *filename, FILE *out, void *arg), void *arg, FILE *out)
+{
+    struct BatchState state;
+    pthread_t *threads;
+    int i, started = 0;
+
+    if (numWorkers <= 0)
+        numWorkers = midiWorkerCount();
+    if ((size_t)numWorkers > list->count)
+        numWorkers = list->count ? (int)list->count : 1;
+
+    threads = (pthread_t *)malloc(numWorkers * sizeof(pthread_t));
+    if (threads == NULL)
+        return -1;
+
+    state.list = list;
+    state.job = job;
+    state.arg = arg;
+    state.out = out;
+    state.next = 0;
+    state.failures = 0;
+    pthread_mutex_init(&state.nextLock, NULL);
+    pthread_mutex_init(&state.outLock, NULL);
+
+    for (i = 0; i < numWorkers; i++)
+    {
+        if (pthread_create(&threads[started], NULL, batchWorker, &state) == 0)
+            started++;
+    }
+    // Fall back to doing the work on this thread
+    if (started == 0)
+        batchWorker(&state);
+    for (i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    fflush(out);
+    pthread_mutex_destroy(&state.nextLock);
+    pthread_mutex_destroy(&state.outLock);
+    free(threads);
+    return state.failures;
+}
+
+/** @fn static void runParallelItems(struct ParallelState *state)
+ *  @brief Run items until there are none left
+ */
+static void runParallelItems(struct ParallelState *state)
+{
+    size_t i;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&state->nextLock);
+        i = state->next++;
+        pthread_mutex_unlock(&state->nextLock);
+        if (i >= state->count)
+            break;
+        state->fn(i, state->arg);
+    }
+}
+
+/** @fn static void *parallelWorker(void *p)
+ *  @brief Worker thread, runs items until there are none left
+ *
+ * The profile of a worker is flushed when it ends. The calling thread
+ * runs items without flushing, its counters belong to the file it is
+ * working on.
+ */
+static void *parallelWorker(void *p)
+{
+    runParallelItems((struct ParallelState *)p);
+#ifdef MIDI_PROFILE
+    flushMidiProfile();
+#endif
+    return NULL;
+}
+
+/** @fn int runMidiParallel(size_t count, int numWorkers, void (*fn)(size_t i, void *arg), void *arg)
+ *  @brief Call a function for items 0 to count-1 on a pool of worker threads
+ *
+ * Items are handed out in order, one at a time. With one worker, or
+ * a single item, everything runs on the calling thread.
+ *
+ * @param count: Number of items
+ * @param numWorkers: Number of worker threads, 0 or less for one per processor
+ * @param fn: Called once per item, must be safe to call from several threads at once
+ * @param arg: Passed to fn unchanged
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+int runMidiParallel(size_t count, int numWorkers, void (*fn)(size_t i, void *arg), void *arg)
+{
+    struct ParallelState state;
+    pthread_t *threads;
+    int i, started = 0;
+
+    if (numWorkers <= 0)
+        numWorkers = midiWorkerCount();
+    if ((size_t)numWorkers > count)
+        numWorkers = count ? (int)count : 1;
+
+    state.count = count;
+    state.fn = fn;
+    state.arg = arg;
+    state.next = 0;
+    pthread_mutex_init(&state.nextLock, NULL);
+
+    if (numWorkers == 1)
+    {
+        runParallelItems(&state);
+        pthread_mutex_destroy(&state.nextLock);
+        return 0;
+    }
+
+    threads = (pthread_t *)malloc((numWorkers - 1) * sizeof(pthread_t));
+    if (threads == NULL)
+    {
+        pthread_mutex_destroy(&state.nextLock);
+        return -1;
+    }
+    // The calling thread is one of the workers
+    for (i = 0; i < numWorkers - 1; i++)
+    {
+        if (pthread_create(&threads[started], NULL, parallelWorker, &state) == 0)
+            started++;
+    }
+    // Whatever the workers did not get to is done here
+    runParallelItems(&state);
+    for (i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    pthread_mutex_destroy(&state.nextLock);
+    free(threads);
+    return 0;
+}
@@ -0,0 +1,42 @@
+/** @file MidiBatch.h
+ *  @brief Running a job over many MIDI files on a pool of worker threads
+ *
+ *  This contains the data structures and functions needed to collect
+ *  MIDI files from paths, directories and manifest files, and to
+ *  process them in parallel with one output buffer per worker.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#ifndef MIDIINFO_H_
+#include "MidiInfo.h"
+#endif
+
+#ifndef MIDIBATCH_H_
+#define MIDIBATCH_H_
+
+// Data Structures
+/** @struct MidiFileList
+ *  @brief A growable list of file paths
+ */
+struct MidiFileList
+{
+	char **paths;
+	size_t count, capacity;
+};
+
+// Function Prototypes
+int addMidiFile(struct MidiFileList *list, const char *path);
+int addMidiPath(struct MidiFileList *list, const char *path);
+int addMidiManifest(struct MidiFileList *list, const char *manifest);
+void freeMidiFileList(struct MidiFileList *list);
+
+int midiWorkerCount(void);
+int runMidiParallel(size_t count, int numWorkers, void (*fn)(size_t i, void *arg), void *arg);
+int runMidiBatch(const struct MidiFileList *list, int numWorkers,
+				 int (*job)(const char *filename, FILE *out, void *arg), void *arg, FILE *out);
+
+#endif
@@ -0,0 +1,867 @@
+/** @file MidiBuffer.c
+ *  @brief In-memory MIDI file access through a bounds-checked byte cursor
+ *
+ *  This contains the functions needed to load a whole MIDI file into
+ *  memory and to decode it with a pointer/length cursor. Decoding
+ *  follows the same event rules as the FILE based functions in
+ *  MidiInfo.c and prints the same text.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef MIDIBUFFER_H_
+#include "MidiBuffer.h"
+#endif
+
+#ifndef MIDIVARLEN_H_
+#include "MidiVarLen.h"
+#endif
+
+#ifndef MIDIPROFILE_H_
+#include "MidiProfile.h"
+#endif
+
+/// @brief Initial allocation when reading a file of unknown size
+#ifndef MIDI_BUFFER_CHUNK
+#define MIDI_BUFFER_CHUNK 65536
+#endif
+
+/** @fn static int readWholeFile(int fd, struct MidiBuffer *buf)
+ *  @brief Read a file descriptor into a malloc()ed buffer
+ *
+ * Fallback used when the file cannot be mapped, the buffer grows
+ * until read() reports end of file.
+ *
+ * @param fd: The file descriptor to read from
+ * @param buf: The buffer to fill
+ * @return 0 on success, -1 on error
+ */
+static int readWholeFile(int fd, struct MidiBuffer *buf)
+{
+    size_t cap = MIDI_BUFFER_CHUNK, size = 0;
+    unsigned char *data, *tmp;
+    ssize_t n;
+
+    data = (unsigned char *)malloc(cap);
+    if (data == NULL)
+        return -1;
+
+    for (;;)
+    {
+        if (size == cap)
+        {
+            cap *= 2;
+            tmp = (unsigned char *)realloc(data, cap);
+            if (tmp == NULL)
+            {
+                free(data);
+                return -1;
+            }
+            data = tmp;
+        }
+        n = read(fd, data + size, cap - size);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            free(data);
+            return -1;
+        }
+        if (n == 0)
+            break;
+        size += n;
+    }
+
+    buf->data = data;
+    buf->size = size;
+    buf->mapped = 0;
+    return 0;
+}
+
+/** @fn int loadMidiBuffer(const char *filename, struct MidiBuffer *buf)
+ *  @brief Load a whole MIDI file into memory
+ *
+ * Regular files are mapped read-only with mmap(), anything that
+ * cannot be mapped is read into a malloc()ed buffer instead.\n
+ * The name "-" reads stdin to its end.
+ *
+ * @param filename: The file to load, - for stdin
+ * @param buf: Receives the file data, release with freeMidiBuffer()
+ * @return 0 on success, -1 on error with errno set
+ */
+int loadMidiBuffer(const char *filename, struct MidiBuffer *buf)
+{
+    struct stat st;
+    void *map;
+    int fd, ret;
+    MIDI_PROFILE_START(start);
+
+    buf->data = NULL;
+    buf->size = 0;
+    buf->mapped = 0;
+
+    if (strcmp(filename, "-") == 0)
+    {
+        ret = readWholeFile(STDIN_FILENO, buf);
+        MIDI_PROFILE_ADD(bytes, buf->size);
+        MIDI_PROFILE_STOP(start, MIDI_PROFILE_LOAD);
+        return ret;
+    }
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    if ((fstat(fd, &st) == 0) && S_ISREG(st.st_mode) && (st.st_size > 0))
+    {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            buf->data = (unsigned char *)map;
+            buf->size = st.st_size;
+            buf->mapped = 1;
+            close(fd);
+            MIDI_PROFILE_ADD(bytes, buf->size);
+            MIDI_PROFILE_STOP(start, MIDI_PROFILE_LOAD);
+            return 0;
+        }
+    }
+
+    ret = readWholeFile(fd, buf);
+    close(fd);
+    MIDI_PROFILE_ADD(bytes, buf->size);
+    MIDI_PROFILE_STOP(start, MIDI_PROFILE_LOAD);
+    return ret;
+}
+
+/** @fn void freeMidiBuffer(struct MidiBuffer *buf)
+ *  @brief Release a buffer filled by loadMidiBuffer()
+ *
+ * @param buf: The buffer to release
+ */
+void freeMidiBuffer(struct MidiBuffer *buf)
+{
+    if (buf->data != NULL)
+    {
+        if (buf->mapped)
+            munmap(buf->data, buf->size);
+        else
+            free(buf->data);
+    }
+    buf->data = NULL;
+    buf->size = 0;
+    buf->mapped = 0;
+}
+
+/** @fn void initCursor(struct MidiCursor *c, const unsigned char *data, size_t size)
+ *  @brief Set a cursor to the start of a block of memory
+ *
+ * @param c: The cursor to initialise
+ * @param data: Start of the memory block
+ * @param size: Size of the memory block in bytes
+ */
+void initCursor(struct MidiCursor *c, const unsigned char *data, size_t size)
+{
+    c->pos = data;
+    c->end = data + size;
+    c->error = 0;
+    c->runningStatus = 0;
+    c->sysExOpen = 0;
+}
+
+/** @fn size_t cursorRemaining(const struct MidiCursor *c)
+ *  @brief Number of bytes left to read
+ *
+ * @param c: The cursor to check
+ * @return Number of unread bytes
+ */
+size_t cursorRemaining(const struct MidiCursor *c)
+{
+    return c->end - c->pos;
+}
+
+/** @fn static inline int cursorNeed(struct MidiCursor *c, size_t n)
+ *  @brief Check that n bytes can be read, flag an error if not
+ */
+static inline int cursorNeed(struct MidiCursor *c, size_t n)
+{
+    if ((size_t)(c->end - c->pos) < n)
+    {
+        c->pos = c->end;
+        c->error = 1;
+        return 0;
+    }
+    return 1;
+}
+
+/** @fn static inline void cursorSkip(struct MidiCursor *c, size_t n)
+ *  @brief Step over n bytes, flag an error if there are not that many
+ */
+static inline void cursorSkip(struct MidiCursor *c, size_t n)
+{
+    if (cursorNeed(c, n))
+        c->pos += n;
+}
+
+/** @fn static inline unsigned char cursorByte(struct MidiCursor *c)
+ *  @brief Read a single byte, 0 if the cursor is exhausted
+ */
+static inline unsigned char cursorByte(struct MidiCursor *c)
+{
+    if (c->pos >= c->end)
+    {
+        c->error = 1;
+        return 0;
+    }
+    return *c->pos++;
+}
+
+/** @fn static inline uint32_t cursorUInt32(struct MidiCursor *c)
+ *  @brief Read a big-endian 32bit value
+ */
+static inline uint32_t cursorUInt32(struct MidiCursor *c)
+{
+    const unsigned char *p = c->pos;
+
+    if (!cursorNeed(c, 4))
+        return 0;
+    c->pos += 4;
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/** @fn static inline uint16_t cursorUInt16(struct MidiCursor *c)
+ *  @brief Read a big-endian 16bit value
+ */
+static inline uint16_t cursorUInt16(struct MidiCursor *c)
+{
+    const unsigned char *p = c->pos;
+
+    if (!cursorNeed(c, 2))
+        return 0;
+    c->pos += 2;
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+/** @fn static void cursorChunkType(struct MidiCursor *c, char *cChunkType)
+ *  @brief Read a 4 character chunk id and NULL terminate it
+ */
+static void cursorChunkType(struct MidiCursor *c, char *cChunkType)
+{
+    if (cursorNeed(c, 4))
+    {
+        memcpy(cChunkType, c->pos, 4);
+        c->pos += 4;
+    }
+    else
+    {
+        memset(cChunkType, 0, 4);
+    }
+    cChunkType[4] = '\0';
+}
+
+/** @fn unsigned long cursorReadVarLen(struct MidiCursor *c)
+ *  @brief Read a Variable-Length Quantity
+ *
+ * Same decoding as readVarLen(), see there for the format.\n
+ * While 4 bytes remain the common quantities of up to 4 bytes are
+ * decoded without branching on their bytes, see varLenDecode4().
+ *
+ * @param c: The cursor to read from
+ * @return Unsigned Long: Variable-Length Quantity value
+ */
+unsigned long cursorReadVarLen(struct MidiCursor *c)
+{
+    unsigned long val;
+    unsigned char ch;
+    int len;
+
+    if ((c->end - c->pos >= 4) && ((len = varLenDecode4(c->pos, &val)) != 0))
+    {
+        c->pos += len;
+        return val;
+    }
+
+    if ((val = cursorByte(c)) & 0x80)
+    {
+        val &= 0x7F;
+        do
+        {
+            val = (val << 7) + ((ch = cursorByte(c)) & 0x7F);
+        } while ((ch & 0x80) && !c->error);
+    }
+    return (val);
+}
+
+/** @fn struct MidiHeader cursorReadMidiChunk(struct MidiCursor *c)
+ *  @brief Read the MIDI file header
+ *
+ * Same as readMidiChunk(), see there for the format.
+ *
+ * @param c: The cursor to read from
+ * @return struct MidiHeader containing the header chunk data
+ */
+struct MidiHeader cursorReadMidiChunk(struct MidiCursor *c)
+{
+    struct MidiHeader midiHead;
+    MIDI_PROFILE_START(start);
+
+    cursorChunkType(c, midiHead.cChunkType);
+    midiHead.uLength = cursorUInt32(c);
+    midiHead.uFormat = cursorUInt16(c);
+    midiHead.uNumTracks = cursorUInt16(c);
+    midiHead.sTimeDiv = (short)cursorUInt16(c);
+    midiHead.trackHeaders = NULL;
+    MIDI_PROFILE_ADD(headerChunks, 1);
+    MIDI_PROFILE_ADD(headerBytes, midiHead.uLength);
+    MIDI_PROFILE_STOP(start, MIDI_PROFILE_HEADER);
+
+    return midiHead;
+}
+
+/** @fn struct TrackHeader cursorReadTrackChunk(struct MidiCursor *c)
+ *  @brief Read the header chunk for a track
+ *
+ * Same as readTrackChunk(), see there for the format.
+ *
+ * @param c: The cursor to read from
+ * @return struct TrackHeader containing the header chunk data
+ */
+struct TrackHeader cursorReadTrackChunk(struct MidiCursor *c)
+{
+    struct TrackHeader trackHead;
+
+    cursorChunkType(c, trackHead.cChunkType);
+    trackHead.uLength = cursorUInt32(c);
+    trackHead.events = NULL;
+    MIDI_PROFILE_ADD(trackChunks, 1);
+    MIDI_PROFILE_ADD(trackBytes, trackHead.uLength);
+
+    return trackHead;
+}
+
+/** @fn int cursorTrackEvents(struct MidiCursor *c, const struct TrackHeader *trackHead, struct MidiCursor *track)
+ *  @brief Split the event data of a track off the file cursor
+ *
+ * The track cursor covers exactly the uLength bytes of event data,
+ * and the file cursor is moved past them to the next chunk.
+ *
+ * @param c: The file cursor, positioned after the track header
+ * @param trackHead: The track header just read
+ * @param track: Receives a cursor over the track event data
+ * @return 1 if the whole track is present, 0 if it was truncated
+ */
+int cursorTrackEvents(struct MidiCursor *c, const struct TrackHeader *trackHead, struct MidiCursor *track)
+{
+    size_t len = trackHead->uLength;
+
+    if (len > cursorRemaining(c))
+    {
+        initCursor(track, c->pos, cursorRemaining(c));
+        c->pos = c->end;
+        c->error = 1;
+        return 0;
+    }
+    initCursor(track, c->pos, len);
+    c->pos += len;
+    return 1;
+}
+
+/** @fn int cursorIndexTracks(struct MidiCursor *c, struct MidiHeader *midiHead, struct MidiCursor *tracks)
+ *  @brief Locate every track of a file without decoding any events
+ *
+ * Reads each track header and splits off a cursor over its event
+ * data, so the tracks can then be decoded in any order or in parallel.\n
+ * Indexing stops at the first chunk that is not a track, its header
+ * is left in midiHead->trackHeaders at the returned index.
+ *
+ * @param c: The file cursor, positioned after the MIDI header chunk
+ * @param midiHead: The MIDI header, trackHeaders must have room for uNumTracks headers
+ * @param tracks: Receives a cursor per track, room for uNumTracks cursors
+ * @return The number of tracks indexed, less than uNumTracks on a bad track header
+ */
+int cursorIndexTracks(struct MidiCursor *c, struct MidiHeader *midiHead, struct MidiCursor *tracks)
+{
+    int i;
+
+    for (i = 0; i < midiHead->uNumTracks; i++)
+    {
+        midiHead->trackHeaders[i] = cursorReadTrackChunk(c);
+        if (strcmp(midiHead->trackHeaders[i].cChunkType, MIDI_TRACK_ID) != 0)
+            break;
+        cursorTrackEvents(c, &midiHead->trackHeaders[i], &tracks[i]);
+    }
+    return i;
+}
+
+/** @fn int cursorReadEvent(struct MidiCursor *c, struct MidiEvent *ev)
+ *  @brief Read the next event of a track
+ *
+ * Reads the delta time and the event that follows it, using
+ * midiStatusTable to find how many data bytes follow the status.\n
+ * A data byte where a status byte is expected means running status,
+ * the status of the previous MIDI event is reused. SysEx and System
+ * messages cancel running status, Meta events leave it alone.\n
+ * Meta and SysEx payloads are not copied, ev->data points into the
+ * memory the cursor is reading. SysEx packets of a divided message
+ * are returned one by one, see midiSysExKind().
+ *
+ * @param c: The track cursor to read from
+ * @param ev: Receives the decoded event
+ * @return 1 if an event was read, 0 at the end of the data or on a truncated event
+ */
+int cursorReadEvent(struct MidiCursor *c, struct MidiEvent *ev)
+{
+    const struct MidiStatus *status;
+
+    if (c->pos >= c->end)
+        return 0;
+
+    ev->deltaTime = cursorReadVarLen(c);
+    ev->status = cursorByte(c);
+    ev->data1 = 0;
+    ev->data2 = 0;
+    ev->data = NULL;
+    ev->length = 0;
+    if (c->error)
+        return 0;
+
+    status = &midiStatusTable[ev->status];
+    if ((status->kind == MIDI_STATUS_DATA) && (c->runningStatus != 0))
+    {
+        c->pos--;
+        ev->status = c->runningStatus;
+        status = &midiStatusTable[ev->status];
+    }
+
+    switch (status->kind)
+    {
+    case MIDI_STATUS_CHANNEL:
+        c->runningStatus = ev->status;
+        ev->data1 = cursorByte(c);
+        if (status->length == 2)
+            ev->data2 = cursorByte(c);
+        break;
+    case MIDI_STATUS_META:
+        ev->data1 = cursorByte(c);
+        ev->length = cursorReadVarLen(c);
+        ev->data = c->pos;
+        if (!cursorNeed(c, ev->length))
+            ev->length = 0;
+        c->pos += ev->length;
+        break;
+    case MIDI_STATUS_SYSEX:
+        c->runningStatus = 0;
+        ev->length = cursorReadVarLen(c);
+        ev->data = c->pos;
+        if (!cursorNeed(c, ev->length))
+            ev->length = 0;
+        c->pos += ev->length;
+        if (!c->error)
+            ev->data1 = midiSysExKind(ev->status, ev->data, ev->length, &c->sysExOpen);
+        break;
+    case MIDI_STATUS_SYSTEM:
+        c->runningStatus = 0;
+        if (status->length > 0)
+            ev->data1 = cursorByte(c);
+        if (status->length > 1)
+            ev->data2 = cursorByte(c);
+        break;
+    }
+    if (c->error)
+        return 0;
+    MIDI_PROFILE_EVENT(ev->status);
+    return 1;
+}
+
+/** @fn int cursorReadMetaEvent(struct MidiCursor *c, struct MidiEvent *ev)
+ *  @brief Read the next Meta event of a track, skipping everything else
+ *
+ * MIDI events are stepped over using their data length from
+ * midiStatusTable, without being decoded into an event. Running status
+ * is tracked the same way as cursorReadEvent() so the track stays in sync.\n
+ * The delta time of the returned event is the time since the previous
+ * Meta event (or the start of the track), so absolute ticks still add up.
+ *
+ * @param c: The track cursor to read from
+ * @param ev: Receives the Meta event
+ * @return 1 if a Meta event was read, 0 at the end of the data or on a truncated event
+ */
+int cursorReadMetaEvent(struct MidiCursor *c, struct MidiEvent *ev)
+{
+    const struct MidiStatus *status;
+    unsigned long deltaTime = 0;
+    unsigned char eventID;
+
+    while (c->pos < c->end)
+    {
+        deltaTime += cursorReadVarLen(c);
+        eventID = cursorByte(c);
+        if (c->error)
+            return 0;
+
+        status = &midiStatusTable[eventID];
+        switch (status->kind)
+        {
+        case MIDI_STATUS_CHANNEL:
+            c->runningStatus = eventID;
+            cursorSkip(c, status->length);
+            break;
+        case MIDI_STATUS_DATA:
+            // The byte just read is the first data byte of a running status event
+            if (c->runningStatus != 0)
+                cursorSkip(c, midiStatusTable[c->runningStatus].length - 1);
+            break;
+        case MIDI_STATUS_META:
+            ev->deltaTime = deltaTime;
+            ev->status = eventID;
+            ev->data1 = cursorByte(c);
+            ev->data2 = 0;
+            ev->length = cursorReadVarLen(c);
+            ev->data = c->pos;
+            if (!cursorNeed(c, ev->length))
+                ev->length = 0;
+            c->pos += ev->length;
+            if (c->error)
+                return 0;
+            MIDI_PROFILE_EVENT(0xFF);
+            return 1;
+        case MIDI_STATUS_SYSEX:
+            c->runningStatus = 0;
+            cursorSkip(c, cursorReadVarLen(c));
+            break;
+        case MIDI_STATUS_SYSTEM:
+            c->runningStatus = 0;
+            cursorSkip(c, status->length);
+            break;
+        }
+        if (c->error)
+            return 0;
+    }
+    return 0;
+}
+
+// Key signature names, indexed by number of sharps + 7, major then minor
+static const char *keySigNames[15][2] = {
+    {"C flat ", "G Sharp "}, {"G flat ", "E Flat "}, {"D flat ", "B Flat "}, {"A flat ", "F "}, {"E flat ", "C "},
+    {"B Flat ", "G "}, {"F ", "D "}, {"C ", "C "}, {"G ", "E "}, {"D ", "B "}, {"A ", "F Sharp "}, {"E ", "C Sharp "},
+    {"B ", "G Sharp "}, {"F Sharp ", "D Sharp "}, {"C Sharp ", "B Flat "}};
+
+/** @fn static unsigned char eventByte(const struct MidiEvent *ev, unsigned long i)
+ *  @brief Payload byte i of an event, 0 if the payload is shorter
+ */
+static unsigned char eventByte(const struct MidiEvent *ev, unsigned long i)
+{
+    return (i < ev->length) ? ev->data[i] : 0;
+}
+
+/** @fn static void outPayloadText(struct MidiOutput *out, const struct MidiEvent *ev)
+ *  @brief Append an event payload as text, up to the first NULL like printf("%.*s")
+ */
+static void outPayloadText(struct MidiOutput *out, const struct MidiEvent *ev)
+{
+    const unsigned char *nul;
+    size_t n = ev->length;
+
+    if (n == 0)
+        return;
+    nul = (const unsigned char *)memchr(ev->data, '\0', n);
+    if (nul != NULL)
+        n = nul - ev->data;
+    outBytes(out, (const char *)ev->data, n);
+}
+
+/** @fn void printMetaEvent(struct MidiOutput *out, const struct MidiEvent *ev)
+ *  @brief Print a Meta event in the same form as readMetaEvent()
+ *
+ * @param out: The output buffer to print to
+ * @param ev: The Meta event to print
+ */
+void printMetaEvent(struct MidiOutput *out, const struct MidiEvent *ev)
+{
+    static const char *textTypes[8] = {"", "Text Event. ", "Copyright Notice. ", "Sequence/Track Name. ",
+                                       "Instrument Name. ", "Lyric. ", "Marker. ", "Cue Point. "};
+    unsigned int mspqn, seqNum;
+    unsigned long k;
+    int i, j;
+
+    outReserve(out);
+    switch (ev->data1)
+    {
+    case 0x0:
+        for (seqNum = 0, k = 0; k < ev->length; k++)
+            seqNum = (seqNum << 8) + ev->data[k];
+        OUT_LIT(out, "Type is Sequence Number. Data is ");
+        outUInt(out, seqNum);
+        outChar(out, '\n');
+        break;
+    case 0x1:
+    case 0x2:
+    case 0x3:
+    case 0x4:
+    case 0x5:
+    case 0x6:
+    case 0x7:
+        OUT_LIT(out, "Type is ");
+        outStr(out, textTypes[ev->data1], strlen(textTypes[ev->data1]));
+        OUT_LIT(out, "Data is ");
+        outPayloadText(out, ev);
+        outChar(out, '\n');
+        break;
+    case 0x20:
+        OUT_LIT(out, "Type is Channel Prefix. Channel is ");
+        outUInt(out, eventByte(ev, 0));
+        outChar(out, '\n');
+        break;
+    case 0x21:
+        OUT_LIT(out, "Type is Port Prefix. Port is ");
+        outUInt(out, eventByte(ev, 0));
+        outChar(out, '\n');
+        break;
+    case 0x2f:
+        OUT_LIT(out, "End of track event\n");
+        break;
+    case 0x51:
+        mspqn = (eventByte(ev, 0) << 16) | (eventByte(ev, 1) << 8) | eventByte(ev, 2);
+        OUT_LIT(out, "Type is Set Tempo. Data is ");
+        outUInt(out, mspqn ? MS_PER_MIN / mspqn : 0);
+        OUT_LIT(out, " BPM\n");
+        break;
+    case 0x54:
+        OUT_LIT(out, " Type is SMPTE Offset. Data is ");
+        outPayloadText(out, ev);
+        outChar(out, '\n');
+        break;
+    case 0x58:
+        OUT_LIT(out, "Type is Time Signature. Signature is ");
+        outUInt(out, eventByte(ev, 0));
+        OUT_LIT(out, " / ");
+        outInt(out, intPow(2, eventByte(ev, 1)));
+        outChar(out, ' ');
+        outUInt(out, eventByte(ev, 2));
+        outChar(out, ' ');
+        outUInt(out, eventByte(ev, 3));
+        outChar(out, '\n');
+        break;
+    case 0x59:
+        i = (signed char)eventByte(ev, 0);
+        j = (signed char)eventByte(ev, 1);
+        OUT_LIT(out, "Type is Key Signature. Signature is ");
+        if ((i >= -7) && (i <= 7))
+            outStr(out, keySigNames[i + 7][j ? 1 : 0], strlen(keySigNames[i + 7][j ? 1 : 0]));
+        if (j)
+            OUT_LIT(out, "Minor\n");
+        else
+            OUT_LIT(out, "Major\n");
+        break;
+    case 0x7F:
+        OUT_LIT(out, "Type is Sequence Specific Meta Event. Data is ");
+        outPayloadText(out, ev);
+        outChar(out, '\n');
+        break;
+    default:
+        OUT_LIT(out, "Type is unknown, reading ");
+        outUInt(out, ev->length);
+        OUT_LIT(out, " byte(s)\n");
+        break;
+    }
+}
+
+/** @fn void printSysExEvent(struct MidiOutput *out, const struct MidiEvent *ev)
+ *  @brief Print a SysEx packet in the same form as readSysExEvent()
+ *
+ * @param out: The output buffer to print to
+ * @param ev: The SysEx event to print
+ */
+void printSysExEvent(struct MidiOutput *out, const struct MidiEvent *ev)
+{
+    const char *name;
+    unsigned long id;
+
+    outReserve(out);
+    OUT_LIT(out, "Type is ");
+    outStr(out, sysExKindNames[ev->data1], strlen(sysExKindNames[ev->data1]));
+    OUT_LIT(out, ". ");
+    if ((ev->status == 0xF0) && ((id = midiSysExManufacturer(ev->data, ev->length)) != 0))
+    {
+        OUT_LIT(out, "Manufacturer is ");
+        if ((name = midiManufacturerName(id)) != NULL)
+        {
+            outStr(out, name, strlen(name));
+            outChar(out, ' ');
+        }
+        OUT_LIT(out, "0x");
+        if (id & MIDI_MANUFACTURER_EXTENDED)
+            outHex(out, id & 0xFFFF, 6);
+        else
+            outHex(out, id, 2);
+        OUT_LIT(out, ", ");
+    }
+    outUInt(out, ev->length);
+    OUT_LIT(out, " byte(s)\n");
+}
+
+/** @fn void printMidiEvent(struct MidiOutput *out, const struct MidiEvent *ev)
+ *  @brief Print an event in the same form as readTrackEvents()
+ *
+ * @param out: The output buffer to print to
+ * @param ev: The event to print
+ */
+void printMidiEvent(struct MidiOutput *out, const struct MidiEvent *ev)
+{
+    unsigned char channel = ev->status & 0xf;
+    unsigned char cLSB, cMSB;
+    unsigned short uPitchBend;
+
+    outReserve(out);
+    OUT_LIT(out, "         Delta time: 0x");
+    outHex(out, ev->deltaTime, 2);
+    outChar(out, '\n');
+    switch (ev->status >> 4)
+    {
+    case 0x8:
+        OUT_LIT(out, "         MIDI Event detected - Note Off Event - Channel ");
+        outUInt(out, channel);
+        OUT_LIT(out, ", Note ");
+        outUInt(out, ev->data1);
+        OUT_LIT(out, ", Velocity ");
+        outUInt(out, ev->data2);
+        outChar(out, '\n');
+        break;
+    case 0x9:
+        OUT_LIT(out, "         MIDI Event detected - Note On Event - Channel ");
+        outUInt(out, channel);
+        OUT_LIT(out, ", Note ");
+        outUInt(out, ev->data1);
+        OUT_LIT(out, " Velocity ");
+        outUInt(out, ev->data2);
+        outChar(out, '\n');
+        break;
+    case 0xA:
+        OUT_LIT(out, "         MIDI Event detected - Note Aftertouch Event - Channel ");
+        outUInt(out, channel);
+        OUT_LIT(out, ", Note ");
+        outUInt(out, ev->data1);
+        OUT_LIT(out, ", Aftertouch Value ");
+        outUInt(out, ev->data2);
+        outChar(out, '\n');
+        break;
+    case 0xB:
+        OUT_LIT(out, "         MIDI Event detected - Controller Event - Channel ");
+        outUInt(out, channel);
+        OUT_LIT(out, ", Controller Number ");
+        outUInt(out, ev->data1);
+        OUT_LIT(out, ", Controller Value ");
+        outUInt(out, ev->data2);
+        outChar(out, '\n');
+        break;
+    case 0xC:
+        OUT_LIT(out, "         MIDI Event detected - Program Change Event - Channel ");
+        outUInt(out, channel);
+        OUT_LIT(out, ", Program Number ");
+        outUInt(out, ev->data1);
+        outChar(out, '\n');
+        break;
+    case 0xD:
+        OUT_LIT(out, "         MIDI Event detected - Channel Aftertouch Event - Channel ");
+        outUInt(out, channel);
+        OUT_LIT(out, ", Aftertouch Value ");
+        outUInt(out, ev->data1);
+        outChar(out, '\n');
+        break;
+    case 0xE:
+        cLSB = ev->data1 >> 1; // Only need 7 bits
+        cMSB = ev->data2 >> 1; // Only need 7 bits
+        uPitchBend = (cMSB << 8) + cLSB;
+        OUT_LIT(out, "         MIDI Event detected - Pitch Bend Event - Channel ");
+        outUInt(out, channel);
+        OUT_LIT(out, ", Pitch Value LSB 0x");
+        outHex(out, cLSB, 2);
+        OUT_LIT(out, ",  Pitch Value MSB 0x");
+        outHex(out, cMSB, 2);
+        OUT_LIT(out, ", Pitch Value 0x");
+        outHex(out, uPitchBend, 4);
+        OUT_LIT(out, " (");
+        outUInt(out, uPitchBend);
+        OUT_LIT(out, ")\n");
+        break;
+    case 0xF:
+        if (ev->status == 0xFF)
+        {
+            OUT_LIT(out, "         Meta Event detected - ");
+            printMetaEvent(out, ev);
+        }
+        else if (midiStatusTable[ev->status].kind == MIDI_STATUS_SYSTEM)
+        {
+            OUT_LIT(out, "         SysExEvent detected - System message 0x");
+            outHex(out, ev->status, 2);
+            OUT_LIT(out, ", skipping ");
+            outUInt(out, midiStatusTable[ev->status].length);
+            OUT_LIT(out, " byte(s)\n");
+        }
+        else
+        {
+            OUT_LIT(out, "         SysExEvent detected - ");
+            printSysExEvent(out, ev);
+        }
+        break;
+    default:
+        OUT_LIT(out, "         Data byte 0x");
+        outHex(out, ev->status, 2);
+        OUT_LIT(out, " without running status, skipping\n");
+        break;
+    }
+}
+
+/** @fn unsigned long cursorReadTrackEvents(struct MidiCursor *c, struct MidiOutput *out)
+ *  @brief Reads and prints the events of a track
+ *
+ * Cursor equivalent of readTrackEvents(), the cursor should cover
+ * the event data of a single track (see cursorTrackEvents()).
+ * Reading stops at the End of Track event or the end of the data.\n
+ * When out is NULL the events are decoded without any formatting,
+ * the loop then does nothing but decode.
+ *
+ * @param c: The track cursor to read from
+ * @param out: The output buffer to print to, NULL to only decode
+ * @return The number of events read
+ */
+unsigned long cursorReadTrackEvents(struct MidiCursor *c, struct MidiOutput *out)
+{
+    struct MidiEvent ev;
+    unsigned long events = 0;
+    MIDI_PROFILE_START(start);
+
+    if (out == NULL)
+    {
+        while (cursorReadEvent(c, &ev))
+        {
+            events++;
+            if ((ev.status == 0xFF) && (ev.data1 == 0x2f))
+                break;
+        }
+        MIDI_PROFILE_STOP(start, MIDI_PROFILE_DECODE);
+        return events;
+    }
+
+    outReserve(out);
+    OUT_LIT(out, "      Begin Processing Track Chunk\n");
+
+    while (cursorReadEvent(c, &ev))
+    {
+        events++;
+        printMidiEvent(out, &ev);
+        if ((ev.status == 0xFF) && (ev.data1 == 0x2f))
+            break;
+    }
+    MIDI_PROFILE_STOP(start, MIDI_PROFILE_DECODE);
+    return events;
+}
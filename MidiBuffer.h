@@ -0,0 +1,98 @@
+/** @file MidiBuffer.h
+ *  @brief In-memory MIDI file access through a bounds-checked byte cursor
+ *
+ *  This contains the data structures and functions needed to load a
+ *  whole MIDI file into memory (mmap, or read into a buffer when
+ *  mapping is not possible) and to decode it with a pointer/length
+ *  cursor instead of per-byte FILE reads.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#ifndef MIDIINFO_H_
+#include "MidiInfo.h"
+#endif
+
+#ifndef MIDIOUTPUT_H_
+#include "MidiOutput.h"
+#endif
+
+#ifndef MIDIBUFFER_H_
+#define MIDIBUFFER_H_
+
+// Data Structures
+/** @struct MidiBuffer
+ *  @brief A whole MIDI file held in memory
+ *
+ * Data is either a read-only mmap() of the file, or a malloc()ed
+ * copy when the file could not be mapped (pipes, empty files, ...).\n
+ */
+struct MidiBuffer
+{
+	unsigned char *data;
+	size_t size;
+	int mapped;
+};
+
+/** @struct MidiCursor
+ *  @brief Read position within a block of memory
+ *
+ * Every read is checked against end, a read that would run past it
+ * consumes nothing, returns zero and sets error.\n
+ * Running status holds the status of the last MIDI event read, 0 if none.\n
+ * SysEx open is non-zero while a divided SysEx message waits for more packets.\n
+ */
+struct MidiCursor
+{
+	const unsigned char *pos;
+	const unsigned char *end;
+	int error;
+	unsigned char runningStatus;
+	unsigned char sysExOpen;
+};
+
+/** @struct MidiEvent
+ *  @brief A single decoded track event
+ *
+ * Status is the full status byte, 0xFF for Meta events and 0xF0/0xF7 for SysEx.
+ * When running status was used it is the status of the earlier event.
+ * A status below 0x80 is a data byte that was found without any running status.\n
+ * For MIDI events data1 and data2 hold the data bytes.\n
+ * For Meta events data1 holds the Meta event type.\n
+ * For SysEx events data1 holds the packet kind, one of the MIDI_SYSEX_ values.\n
+ * Data and length describe the event payload, the bytes after the length
+ * of a Meta or SysEx event. It points into the buffer being decoded and
+ * is not a copy.\n
+ */
+struct MidiEvent
+{
+	unsigned long deltaTime;
+	unsigned char status, data1, data2;
+	const unsigned char *data;
+	unsigned long length;
+};
+
+// Function Prototypes
+int loadMidiBuffer(const char *filename, struct MidiBuffer *buf);
+void freeMidiBuffer(struct MidiBuffer *buf);
+
+void initCursor(struct MidiCursor *c, const unsigned char *data, size_t size);
+size_t cursorRemaining(const struct MidiCursor *c);
+unsigned long cursorReadVarLen(struct MidiCursor *c);
+
+struct MidiHeader cursorReadMidiChunk(struct MidiCursor *c);
+struct TrackHeader cursorReadTrackChunk(struct MidiCursor *c);
+int cursorTrackEvents(struct MidiCursor *c, const struct TrackHeader *trackHead, struct MidiCursor *track);
+int cursorIndexTracks(struct MidiCursor *c, struct MidiHeader *midiHead, struct MidiCursor *tracks);
+int cursorReadEvent(struct MidiCursor *c, struct MidiEvent *ev);
+int cursorReadMetaEvent(struct MidiCursor *c, struct MidiEvent *ev);
+unsigned long cursorReadTrackEvents(struct MidiCursor *c, struct MidiOutput *out);
+
+void printMidiEvent(struct MidiOutput *out, const struct MidiEvent *ev);
+void printMetaEvent(struct MidiOutput *out, const struct MidiEvent *ev);
+void printSysExEvent(struct MidiOutput *out, const struct MidiEvent *ev);
+
+#endif
@@ -0,0 +1,330 @@
+/** @file MidiCache.c
+ *  @brief Persistent on-disk cache of per-file results
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#ifndef MIDICACHE_H_
+#include "MidiCache.h"
+#endif
+
+#ifndef MIDIHASH_H_
+#include "MidiHash.h"
+#endif
+
+/** @fn int openMidiCache(struct MidiCache *c, const char *path, const char *mode, int verify)
+ *  @brief Map an existing cache file and get ready to collect new results
+ *
+ * A missing, damaged or out of date cache file (another version, byte
+ * order or mode) is not an error, the cache then starts empty.
+ *
+ * @param c: The cache to open
+ * @param path: The cache file
+ * @param mode: The job and options of this run, at most MIDI_CACHE_MODE - 1 characters
+ * @param verify: Non-zero to also compare content hashes on lookup
+ * @return 0 on success, -1 if the mode is too long
+ */
+int openMidiCache(struct MidiCache *c, const char *path, const char *mode, int verify)
+{
+    const struct MidiCacheHeader *head;
+    size_t entriesSize;
+
+    memset(c, 0, sizeof(struct MidiCache));
+    if (strlen(mode) >= MIDI_CACHE_MODE)
+        return -1;
+    strcpy(c->mode, mode);
+    c->verify = verify;
+    pthread_mutex_init(&c->lock, NULL);
+
+    if (loadMidiBuffer(path, &c->file) != 0)
+        return 0;
+    head = (const struct MidiCacheHeader *)c->file.data;
+    if ((c->file.size < sizeof(struct MidiCacheHeader)) || (head->magic != MIDI_CACHE_MAGIC) ||
+        (head->version != MIDI_CACHE_VERSION) || (strncmp(head->mode, mode, MIDI_CACHE_MODE) != 0))
+    {
+        freeMidiBuffer(&c->file);
+        return 0;
+    }
+    entriesSize = (size_t)head->count * sizeof(struct MidiCacheEntry);
+    if ((c->file.size - sizeof(struct MidiCacheHeader)) / sizeof(struct MidiCacheEntry) < head->count ||
+        (c->file.size - sizeof(struct MidiCacheHeader) - entriesSize != head->dataSize))
+    {
+        freeMidiBuffer(&c->file);
+        return 0;
+    }
+    c->entries = (const struct MidiCacheEntry *)(c->file.data + sizeof(struct MidiCacheHeader));
+    c->data = c->file.data + sizeof(struct MidiCacheHeader) + entriesSize;
+    c->count = head->count;
+    return 0;
+}
+
+/** @fn const struct MidiCacheEntry *midiCacheLookup(struct MidiCache *c, const char *filename, const struct stat *st, uint64_t contentHash, const char **result)
+ *  @brief Find the cached result of an unchanged file
+ *
+ * The file is unchanged if its size and modification time match, and
+ * with verify set if its content hash matches too.
+ *
+ * @param c: The cache
+ * @param filename: Path of the file, as given on the command line
+ * @param st: stat() of the file
+ * @param contentHash: Hash of the file from hashMidiFile(), only used with verify
+ * @param result: Receives the cached output, entry->resultLen bytes
+ * @return The entry, NULL if the file is not in the cache or has changed
+ */
+const struct MidiCacheEntry *midiCacheLookup(struct MidiCache *c, const char *filename, const struct stat *st,
+                                             uint64_t contentHash, const char **result)
+{
+    const struct MidiCacheEntry *e;
+    uint64_t pathHash = midiHash64(filename, strlen(filename), 0);
+    size_t len = strlen(filename), dataSize = c->file.size - ((const unsigned char *)c->data - c->file.data);
+    uint32_t lo = 0, hi = c->count, mid;
+
+    // First entry with this path hash
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (c->entries[mid].pathHash < pathHash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for (e = c->entries + lo; (e < c->entries + c->count) && (e->pathHash == pathHash); e++)
+    {
+        if ((e->pathLen != len) || (e->pathOffset > dataSize) || (dataSize - e->pathOffset < len) ||
+            (memcmp(c->data + e->pathOffset, filename, len) != 0))
+            continue;
+        if ((e->resultOffset > dataSize) || (dataSize - e->resultOffset < e->resultLen))
+            break;
+        if ((e->size != (uint64_t)st->st_size) || (e->mtimeSec != st->st_mtim.tv_sec) ||
+            (e->mtimeNsec != st->st_mtim.tv_nsec))
+            break;
+        if (c->verify && ((e->contentHash == 0) || (e->contentHash != contentHash)))
+            break;
+        *result = (const char *)c->data + e->resultOffset;
+        __atomic_add_fetch(&c->hits, 1, __ATOMIC_RELAXED);
+        return e;
+    }
+    __atomic_add_fetch(&c->misses, 1, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+/** @fn int midiCacheAdd(struct MidiCache *c, const char *filename, const struct stat *st, uint64_t contentHash, const char *result, size_t len, int status)
+ *  @brief Keep the result of a file for the new cache file
+ *
+ * Every file of the run is added, found in the cache or not. Safe to
+ * call from several threads.
+ *
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+int midiCacheAdd(struct MidiCache *c, const char *filename, const struct stat *st, uint64_t contentHash,
+                 const char *result, size_t len, int status)
+{
+    struct MidiCacheRecord r;
+    size_t capacity;
+    void *p;
+
+    if (len > UINT32_MAX)
+        return -1;
+    memset(&r, 0, sizeof(r));
+    r.entry.pathHash = midiHash64(filename, strlen(filename), 0);
+    r.entry.size = st->st_size;
+    r.entry.mtimeSec = st->st_mtim.tv_sec;
+    r.entry.mtimeNsec = st->st_mtim.tv_nsec;
+    r.entry.contentHash = contentHash;
+    r.entry.pathLen = strlen(filename);
+    r.entry.resultLen = len;
+    r.entry.status = status;
+    r.path = strdup(filename);
+    r.result = (char *)malloc(len ? len : 1);
+    if ((r.path == NULL) || (r.result == NULL))
+    {
+        free(r.path);
+        free(r.result);
+        return -1;
+    }
+    memcpy(r.result, result, len);
+
+    pthread_mutex_lock(&c->lock);
+    if (c->numRecords == c->capacity)
+    {
+        capacity = c->capacity ? c->capacity * 2 : 256;
+        if ((p = realloc(c->records, capacity * sizeof(struct MidiCacheRecord))) == NULL)
+        {
+            pthread_mutex_unlock(&c->lock);
+            free(r.path);
+            free(r.result);
+            return -1;
+        }
+        c->records = (struct MidiCacheRecord *)p;
+        c->capacity = capacity;
+    }
+    c->records[c->numRecords++] = r;
+    pthread_mutex_unlock(&c->lock);
+    return 0;
+}
+
+/** @fn static int compareRecords(const void *a, const void *b)
+ *  @brief qsort() order of the entries, path hash then path
+ */
+static int compareRecords(const void *a, const void *b)
+{
+    const struct MidiCacheRecord *x = (const struct MidiCacheRecord *)a, *y = (const struct MidiCacheRecord *)b;
+
+    if (x->entry.pathHash != y->entry.pathHash)
+        return (x->entry.pathHash < y->entry.pathHash) ? -1 : 1;
+    return strcmp(x->path, y->path);
+}
+
+/** @fn static int keepOldEntries(struct MidiCache *c)
+ *  @brief Add the entries of the old cache file for files not seen in this run
+ *
+ * A run over part of a collection then keeps the results of the rest.
+ *
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+static int keepOldEntries(struct MidiCache *c)
+{
+    const struct MidiCacheEntry *e;
+    struct MidiCacheRecord key, *seen;
+    size_t numSeen = c->numRecords, dataSize;
+    char *path;
+    struct stat st;
+    uint32_t i;
+
+    if (c->count == 0)
+        return 0;
+    dataSize = c->file.size - ((const unsigned char *)c->data - c->file.data);
+    qsort(c->records, numSeen, sizeof(struct MidiCacheRecord), compareRecords);
+    for (i = 0; i < c->count; i++)
+    {
+        e = &c->entries[i];
+        if ((e->pathOffset > dataSize) || (dataSize - e->pathOffset < e->pathLen) ||
+            (e->resultOffset > dataSize) || (dataSize - e->resultOffset < e->resultLen))
+            continue;
+        if ((path = strndup((const char *)c->data + e->pathOffset, e->pathLen)) == NULL)
+            return -1;
+        key.entry.pathHash = e->pathHash;
+        key.path = path;
+        seen = (struct MidiCacheRecord *)bsearch(&key, c->records, numSeen, sizeof(struct MidiCacheRecord), compareRecords);
+        if (seen == NULL)
+        {
+            memset(&st, 0, sizeof(st));
+            st.st_size = e->size;
+            st.st_mtim.tv_sec = e->mtimeSec;
+            st.st_mtim.tv_nsec = e->mtimeNsec;
+            if (midiCacheAdd(c, path, &st, e->contentHash, (const char *)c->data + e->resultOffset,
+                             e->resultLen, e->status) != 0)
+            {
+                free(path);
+                return -1;
+            }
+        }
+        free(path);
+    }
+    return 0;
+}
+
+/** @fn int writeMidiCache(struct MidiCache *c, const char *path)
+ *  @brief Write the results of this run as the new cache file
+ *
+ * The file is written next to the old one and renamed over it, so a
+ * failed write leaves the old cache in place.
+ *
+ * @param c: The cache
+ * @param path: The cache file
+ * @return 0 on success, -1 on error with errno set
+ */
+int writeMidiCache(struct MidiCache *c, const char *path)
+{
+    struct MidiCacheHeader head;
+    struct MidiCacheRecord *r;
+    uint64_t offset = 0;
+    char *tmp;
+    FILE *f;
+    size_t i;
+    int ret = 0;
+
+    if (keepOldEntries(c) != 0)
+        return -1;
+    qsort(c->records, c->numRecords, sizeof(struct MidiCacheRecord), compareRecords);
+    for (i = 0; i < c->numRecords; i++)
+    {
+        r = &c->records[i];
+        r->entry.pathOffset = offset;
+        offset += r->entry.pathLen;
+        r->entry.resultOffset = offset;
+        offset += r->entry.resultLen;
+    }
+    memset(&head, 0, sizeof(head));
+    head.magic = MIDI_CACHE_MAGIC;
+    head.version = MIDI_CACHE_VERSION;
+    head.count = c->numRecords;
+    head.dataSize = offset;
+    strcpy(head.mode, c->mode);
+
+    tmp = (char *)malloc(strlen(path) + 5);
+    if (tmp == NULL)
+        return -1;
+    sprintf(tmp, "%s.tmp", path);
+    if ((f = fopen(tmp, "wb")) == NULL)
+    {
+        free(tmp);
+        return -1;
+    }
+    fwrite(&head, sizeof(head), 1, f);
+    for (i = 0; i < c->numRecords; i++)
+        fwrite(&c->records[i].entry, sizeof(struct MidiCacheEntry), 1, f);
+    for (i = 0; i < c->numRecords; i++)
+    {
+        r = &c->records[i];
+        fwrite(r->path, 1, r->entry.pathLen, f);
+        fwrite(r->result, 1, r->entry.resultLen, f);
+    }
+    if (ferror(f) | fclose(f))
+        ret = -1;
+    if ((ret == 0) && (rename(tmp, path) != 0))
+        ret = -1;
+    if (ret != 0)
+        remove(tmp);
+    free(tmp);
+    return ret;
+}
+
+/** @fn void closeMidiCache(struct MidiCache *c)
+ *  @brief Unmap the old cache file and release the new results
+ */
+void closeMidiCache(struct MidiCache *c)
+{
+    size_t i;
+
+    for (i = 0; i < c->numRecords; i++)
+    {
+        free(c->records[i].path);
+        free(c->records[i].result);
+    }
+    free(c->records);
+    c->records = NULL;
+    c->numRecords = 0;
+    freeMidiBuffer(&c->file);
+    pthread_mutex_destroy(&c->lock);
+}
+
+/** @fn uint64_t hashMidiFile(const char *filename)
+ *  @brief The content hash of a file for the cache
+ *
+ * @return The XXH64 hash of the whole file, 0 if it could not be read
+ */
+uint64_t hashMidiFile(const char *filename)
+{
+    struct MidiBuffer buf;
+    uint64_t hash;
+
+    if (loadMidiBuffer(filename, &buf) != 0)
+        return 0;
+    hash = midiHash64(buf.data, buf.size, 0);
+    freeMidiBuffer(&buf);
+    // 0 marks a hash that was not computed
+    return hash ? hash : 1;
+}
@@ -0,0 +1,119 @@
+/** @file MidiCache.h
+ *  @brief Persistent on-disk cache of per-file results
+ *
+ *  This contains the data structures and functions needed to keep the
+ *  output of a job (the summary or the statistics of a file) between
+ *  runs, keyed by the path of the file, its size and modification time
+ *  and optionally a hash of its contents.
+ *
+ *  The cache file is read with mmap() and never parsed: a header, an
+ *  array of fixed size entries sorted by path hash for binary search,
+ *  then the paths and results. Lookups are read-only and can be made
+ *  from any number of threads. Results of the current run are collected
+ *  in memory and written to a new cache file at the end, together with
+ *  the old entries of files not seen in this run, and replace the old
+ *  file. Delete the cache file to drop entries of deleted files.
+ *
+ *  The file is in the byte order of the machine that wrote it, a cache
+ *  from another byte order fails the magic check and is ignored.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#include <pthread.h>
+#include <sys/stat.h>
+
+#ifndef MIDIBUFFER_H_
+#include "MidiBuffer.h"
+#endif
+
+#ifndef MIDICACHE_H_
+#define MIDICACHE_H_
+
+/// @brief Identifies a cache file, also catches a different byte order
+#define MIDI_CACHE_MAGIC 0x3148434143494d44ULL
+
+/// @brief Format version, caches of other versions are ignored
+#define MIDI_CACHE_VERSION 2
+
+/// @brief Longest mode string, the job and options the results belong to
+#define MIDI_CACHE_MODE 48
+
+// Data Structures
+/** @struct MidiCacheHeader
+ *  @brief Start of a cache file
+ *
+ * Mode names the job and options the results were produced with, a
+ * cache built with another mode is ignored.\n
+ * Count entries follow the header, then dataSize bytes of paths and results.\n
+ */
+struct MidiCacheHeader
+{
+	uint64_t magic;
+	uint32_t version, count;
+	uint64_t dataSize;
+	char mode[MIDI_CACHE_MODE];
+};
+
+/** @struct MidiCacheEntry
+ *  @brief One file in a cache file
+ *
+ * Offsets are from the start of the data that follows the entries.\n
+ * ContentHash is the XXH64 hash of the file, 0 if it was not computed.\n
+ * Status is the return value of the job.\n
+ */
+struct MidiCacheEntry
+{
+	uint64_t pathHash, size;
+	int64_t mtimeSec, mtimeNsec;
+	uint64_t contentHash;
+	uint64_t pathOffset, resultOffset;
+	uint32_t pathLen, resultLen;
+	int32_t status;
+	uint32_t reserved;
+};
+
+/** @struct MidiCacheRecord
+ *  @brief A result of the current run, held until writeMidiCache()
+ */
+struct MidiCacheRecord
+{
+	struct MidiCacheEntry entry;
+	char *path;
+	char *result;
+};
+
+/** @struct MidiCache
+ *  @brief An open cache, the old file mapped and the new results
+ *
+ * Verify makes lookups compare content hashes as well as size and mtime.\n
+ */
+struct MidiCache
+{
+	struct MidiBuffer file;
+	const struct MidiCacheEntry *entries;
+	const unsigned char *data;
+	uint32_t count;
+	char mode[MIDI_CACHE_MODE];
+	int verify;
+
+	pthread_mutex_t lock;
+	struct MidiCacheRecord *records;
+	size_t numRecords, capacity;
+	unsigned long hits, misses;
+};
+
+// Function Prototypes
+int openMidiCache(struct MidiCache *c, const char *path, const char *mode, int verify);
+const struct MidiCacheEntry *midiCacheLookup(struct MidiCache *c, const char *filename, const struct stat *st,
+											 uint64_t contentHash, const char **result);
+int midiCacheAdd(struct MidiCache *c, const char *filename, const struct stat *st, uint64_t contentHash,
+				 const char *result, size_t len, int status);
+int writeMidiCache(struct MidiCache *c, const char *path);
+void closeMidiCache(struct MidiCache *c);
+uint64_t hashMidiFile(const char *filename);
+
+#endif
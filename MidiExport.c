@@ -0,0 +1,322 @@
+/** @file MidiExport.c
+ *  @brief Machine readable export of decoded events
+ *
+ *  This contains the functions that write decoded events as NDJSON,
+ *  CSV or binary records, see MidiExport.h for the record layouts.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#ifndef MIDIEXPORT_H_
+#include "MidiExport.h"
+#endif
+
+#ifndef MIDIPROFILE_H_
+#include "MidiProfile.h"
+#endif
+
+/** @fn int midiExportFormat(const char *name)
+ *  @brief Look up an export format by name
+ *
+ * @param name: "ndjson", "json", "csv" or "binary"
+ * @return The enum MidiExportFormat value, MIDI_EXPORT_NONE if the name is not known
+ */
+int midiExportFormat(const char *name)
+{
+    if ((strcmp(name, "ndjson") == 0) || (strcmp(name, "json") == 0))
+        return MIDI_EXPORT_NDJSON;
+    if (strcmp(name, "csv") == 0)
+        return MIDI_EXPORT_CSV;
+    if ((strcmp(name, "binary") == 0) || (strcmp(name, "bin") == 0))
+        return MIDI_EXPORT_BINARY;
+    return MIDI_EXPORT_NONE;
+}
+
+/** @fn void exportHeader(struct MidiOutput *out, int format, int withFile)
+ *  @brief Write what goes once at the start of an export, the CSV header row
+ *
+ * @param out: The output buffer
+ * @param format: The export format
+ * @param withFile: Non-zero if the records carry a file field (batch mode)
+ */
+void exportHeader(struct MidiOutput *out, int format, int withFile)
+{
+    if (format != MIDI_EXPORT_CSV)
+        return;
+    outReserve(out);
+    if (withFile)
+        OUT_LIT(out, "file,");
+    OUT_LIT(out, "track,tick,us,status,channel,data\n");
+}
+
+/** @fn static char *quoteFileName(const char *filename, int format, size_t *length)
+ *  @brief Build the quoted file field written at the start of each record
+ *
+ * @return The field including its separator, NULL if memory could not be allocated
+ */
+static char *quoteFileName(const char *filename, int format, size_t *length)
+{
+    static const char digits[] = "0123456789abcdef";
+    const unsigned char *s;
+    char *field, *p;
+
+    // Worst case every character becomes a six character \u escape
+    field = (char *)malloc(strlen(filename) * 6 + 16);
+    if (field == NULL)
+        return NULL;
+    p = field;
+    if (format == MIDI_EXPORT_NDJSON)
+        p += sprintf(p, "\"file\":");
+    *p++ = '"';
+    for (s = (const unsigned char *)filename; *s != '\0'; s++)
+    {
+        if (format == MIDI_EXPORT_CSV)
+        {
+            if (*s == '"')
+                *p++ = '"';
+            *p++ = *s;
+        }
+        else if ((*s == '"') || (*s == '\\'))
+        {
+            *p++ = '\\';
+            *p++ = *s;
+        }
+        else if (*s < 0x20)
+        {
+            p += sprintf(p, "\\u00");
+            *p++ = digits[*s >> 4];
+            *p++ = digits[*s & 0xf];
+        }
+        else
+        {
+            *p++ = *s;
+        }
+    }
+    *p++ = '"';
+    *p++ = ',';
+    *length = p - field;
+    return field;
+}
+
+/** @fn int openMidiExport(struct MidiExport *x, struct MidiOutput *out, int format, const char *filename, const struct TempoMap *tempo)
+ *  @brief Start the export of one file
+ *
+ * When a file name is given every NDJSON and CSV record carries it,
+ * binary exports get a file record in front of the events instead.
+ *
+ * @param x: The export state to set up
+ * @param out: The output buffer records are written to
+ * @param format: The export format
+ * @param filename: The file being exported, NULL to leave out the file field
+ * @param tempo: Tempo map of the file (see buildTempoMap()), NULL for no times
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+int openMidiExport(struct MidiExport *x, struct MidiOutput *out, int format, const char *filename, const struct TempoMap *tempo)
+{
+    struct MidiEvent ev;
+
+    x->out = out;
+    x->tempo = tempo;
+    x->format = format;
+    x->prefix = NULL;
+    x->prefixLen = 0;
+    if (filename == NULL)
+        return 0;
+
+    if (format == MIDI_EXPORT_BINARY)
+    {
+        memset(&ev, 0, sizeof(ev));
+        ev.data = (const unsigned char *)filename;
+        ev.length = strlen(filename);
+        exportEvent(x, MIDI_EXPORT_FILE_TRACK, 0, 0, &ev);
+        return 0;
+    }
+    x->prefix = quoteFileName(filename, format, &x->prefixLen);
+    return (x->prefix == NULL) ? -1 : 0;
+}
+
+/** @fn void closeMidiExport(struct MidiExport *x)
+ *  @brief Release the export state, the output buffer is left open
+ */
+void closeMidiExport(struct MidiExport *x)
+{
+    free(x->prefix);
+    x->prefix = NULL;
+}
+
+/** @fn static void outHexBytes(struct MidiOutput *o, const unsigned char *data, unsigned long n)
+ *  @brief Append bytes as lower case hex, reserving room as it goes
+ */
+static void outHexBytes(struct MidiOutput *o, const unsigned char *data, unsigned long n)
+{
+    static const char digits[] = "0123456789abcdef";
+    unsigned long i;
+
+    for (i = 0; i < n; i++)
+    {
+        // 64 bytes of hex is half of what outReserve() guarantees
+        if ((i & 63) == 0)
+            outReserve(o);
+        o->buf[o->len++] = digits[data[i] >> 4];
+        o->buf[o->len++] = digits[data[i] & 0xf];
+    }
+}
+
+/** @fn static void outLE(struct MidiOutput *o, unsigned long val, int bytes)
+ *  @brief Append an integer as little endian bytes
+ */
+static void outLE(struct MidiOutput *o, unsigned long val, int bytes)
+{
+    while (bytes--)
+    {
+        o->buf[o->len++] = (char)(val & 0xff);
+        val >>= 8;
+    }
+}
+
+/** @fn static int eventDataBytes(const struct MidiEvent *ev, unsigned char *lead)
+ *  @brief The data bytes of an event that are held in data1/data2
+ *
+ * @param ev: The event
+ * @param lead: Receives the data bytes that come before the payload
+ * @return Number of bytes stored in lead, 0 to 2
+ */
+static int eventDataBytes(const struct MidiEvent *ev, unsigned char *lead)
+{
+    const struct MidiStatus *status = &midiStatusTable[ev->status];
+
+    lead[0] = ev->data1;
+    lead[1] = ev->data2;
+    switch (status->kind)
+    {
+    case MIDI_STATUS_CHANNEL:
+    case MIDI_STATUS_SYSTEM:
+        return status->length;
+    case MIDI_STATUS_META:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/** @fn void exportEvent(struct MidiExport *x, int track, unsigned long tick, double micros, const struct MidiEvent *ev)
+ *  @brief Write the record of one event
+ *
+ * @param x: The export state
+ * @param track: Track number of the event
+ * @param tick: Absolute tick of the event
+ * @param micros: Absolute time of the event in microseconds, rounded to a whole microsecond
+ * @param ev: The event
+ */
+void exportEvent(struct MidiExport *x, int track, unsigned long tick, double micros, const struct MidiEvent *ev)
+{
+    struct MidiOutput *o = x->out;
+    unsigned long long us = (unsigned long long)(micros + 0.5);
+    unsigned char lead[2];
+    int numLead, channel = -1;
+
+    numLead = eventDataBytes(ev, lead);
+    if (midiStatusTable[ev->status].kind == MIDI_STATUS_CHANNEL)
+        channel = ev->status & 0xf;
+
+    if (x->format == MIDI_EXPORT_BINARY)
+    {
+        outReserve(o);
+        outLE(o, tick, 4);
+        outLE(o, track, 2);
+        outLE(o, ev->status, 1);
+        outLE(o, (channel < 0) ? MIDI_EXPORT_NO_CHANNEL : channel, 1);
+        outLE(o, (numLead > 0) ? lead[0] : 0, 1);
+        outLE(o, (numLead > 1) ? lead[1] : 0, 1);
+        outLE(o, 0, 2);
+        outLE(o, ev->length, 4);
+        outLE(o, us & 0xffffffffUL, 4);
+        outLE(o, us >> 32, 4);
+        if (ev->length > 0)
+            outBytes(o, (const char *)ev->data, ev->length);
+        return;
+    }
+
+    // outBytes() leaves a line's worth of room behind the file field
+    outReserve(o);
+    if (x->format == MIDI_EXPORT_NDJSON)
+        outChar(o, '{');
+    if (x->prefixLen > 0)
+        outBytes(o, x->prefix, x->prefixLen);
+    if (x->format == MIDI_EXPORT_NDJSON)
+    {
+        OUT_LIT(o, "\"track\":");
+        outUInt(o, track);
+        OUT_LIT(o, ",\"tick\":");
+        outUInt(o, tick);
+        OUT_LIT(o, ",\"us\":");
+        outUInt(o, us);
+        OUT_LIT(o, ",\"status\":");
+        outUInt(o, ev->status);
+        OUT_LIT(o, ",\"channel\":");
+        if (channel < 0)
+            OUT_LIT(o, "null");
+        else
+            outUInt(o, channel);
+        OUT_LIT(o, ",\"data\":\"");
+        outHexBytes(o, lead, numLead);
+        outHexBytes(o, ev->data, ev->length);
+        OUT_LIT(o, "\"}\n");
+    }
+    else
+    {
+        outUInt(o, track);
+        outChar(o, ',');
+        outUInt(o, tick);
+        outChar(o, ',');
+        outUInt(o, us);
+        outChar(o, ',');
+        outUInt(o, ev->status);
+        outChar(o, ',');
+        if (channel >= 0)
+            outUInt(o, channel);
+        outChar(o, ',');
+        outHexBytes(o, lead, numLead);
+        outHexBytes(o, ev->data, ev->length);
+        outChar(o, '\n');
+    }
+}
+
+/** @fn unsigned long exportTrackEvents(struct MidiExport *x, struct MidiCursor *c, int track)
+ *  @brief Decode the events of a track, writing a record for each one
+ *
+ * Reading stops at the End of Track event, which is exported, or at
+ * the end of the data. Ticks only increase within a track, so the
+ * tempo segment of each event is found by stepping forward from the
+ * segment of the previous one.
+ *
+ * @param x: The export state
+ * @param c: A cursor over the event data of one track (see cursorTrackEvents())
+ * @param track: Track number written to the records
+ * @return The number of events exported
+ */
+unsigned long exportTrackEvents(struct MidiExport *x, struct MidiCursor *c, int track)
+{
+    struct MidiEvent ev;
+    unsigned long tick = 0, events = 0, seg = 0;
+    double micros = 0;
+    MIDI_PROFILE_START(start);
+
+    while (cursorReadEvent(c, &ev))
+    {
+        tick += ev.deltaTime;
+        if (x->tempo != NULL)
+        {
+            seg = tempoSegment(x->tempo, seg, tick);
+            micros = tempoSegmentMicros(x->tempo, seg, tick);
+        }
+        exportEvent(x, track, tick, micros, &ev);
+        events++;
+        if ((ev.status == 0xFF) && (ev.data1 == 0x2f))
+            break;
+    }
+    MIDI_PROFILE_STOP(start, MIDI_PROFILE_DECODE);
+    return events;
+}
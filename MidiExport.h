@@ -0,0 +1,90 @@
+/** @file MidiExport.h
+ *  @brief Machine readable export of decoded events
+ *
+ *  This contains the data structures and functions used to write
+ *  decoded track events as NDJSON, CSV or a stream of little endian
+ *  binary records. Records are written as the events are decoded, so
+ *  memory use does not grow with the size of the file.
+ *
+ *  Every record carries the track, absolute tick, absolute time in
+ *  microseconds (see MidiTempo.h), status byte, channel and data bytes
+ *  of one event. The data bytes are the bytes that follow the status
+ *  byte in the file, less any length field: the data bytes of MIDI and
+ *  System events, the type and payload of Meta events and the payload
+ *  of SysEx events.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#ifndef MIDITEMPO_H_
+#include "MidiTempo.h"
+#endif
+
+#ifndef MIDIEXPORT_H_
+#define MIDIEXPORT_H_
+
+/// @brief Size of a binary record, not counting the payload that follows it
+#define MIDI_EXPORT_RECORD_SIZE 24
+
+/// @brief Track number of the binary record that starts each file in batch mode, its payload is the path
+#define MIDI_EXPORT_FILE_TRACK 0xFFFF
+
+/// @brief Channel of events that are not channel messages, in binary records
+#define MIDI_EXPORT_NO_CHANNEL 0xFF
+
+/** @enum MidiExportFormat
+ *  @brief Formats understood by the export functions
+ *
+ * NDJSON: one object per line,
+ * {"track":0,"tick":480,"us":500000,"status":144,"channel":0,"data":"3c64"}.
+ * Us is the time of the event in whole microseconds, data is hex and
+ * channel is null for events without one.\n
+ * CSV: a track,tick,us,status,channel,data header row followed by one row
+ * per event, same fields as NDJSON with an empty channel for events
+ * without one.\n
+ * In batch mode both gain a leading file field.\n
+ * Binary: one 24 byte little endian record per event,
+ * uint32 tick, uint16 track, uint8 status, uint8 channel (0xFF if none),
+ * uint8 data1, uint8 data2, uint16 reserved (0), uint32 payload length,
+ * uint64 time in microseconds, followed by the payload. data1/data2 are
+ * the first two data bytes of MIDI and System events and the type of Meta
+ * events, the payload is the rest of a Meta or SysEx event. In batch mode each file starts with a
+ * record for track 0xFFFF whose payload is the path.
+ */
+enum MidiExportFormat
+{
+	MIDI_EXPORT_NONE = 0,
+	MIDI_EXPORT_NDJSON,
+	MIDI_EXPORT_CSV,
+	MIDI_EXPORT_BINARY
+};
+
+// Data Structures
+/** @struct MidiExport
+ *  @brief Export state of one file
+ *
+ * Prefix is the already quoted file field written at the start of each
+ * NDJSON or CSV record, empty unless a file name was given.\n
+ * Tempo converts ticks to time, when NULL every event is at time 0.\n
+ */
+struct MidiExport
+{
+	struct MidiOutput *out;
+	const struct TempoMap *tempo;
+	int format;
+	char *prefix;
+	size_t prefixLen;
+};
+
+// Function Prototypes
+int midiExportFormat(const char *name);
+void exportHeader(struct MidiOutput *out, int format, int withFile);
+int openMidiExport(struct MidiExport *x, struct MidiOutput *out, int format, const char *filename, const struct TempoMap *tempo);
+void closeMidiExport(struct MidiExport *x);
+void exportEvent(struct MidiExport *x, int track, unsigned long tick, double micros, const struct MidiEvent *ev);
+unsigned long exportTrackEvents(struct MidiExport *x, struct MidiCursor *c, int track);
+
+#endif
@@ -0,0 +1,175 @@
+/** @file MidiFingerprint.c
+ *  @brief Normalized fingerprints for finding copies of the same song
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#ifndef MIDIFINGERPRINT_H_
+#include "MidiFingerprint.h"
+#endif
+
+#ifndef MIDIHASH_H_
+#include "MidiHash.h"
+#endif
+
+#ifndef MIDIPROFILE_H_
+#include "MidiProfile.h"
+#endif
+
+/// @brief Longest record hashed before a payload: tick, 0xFF, Meta type and payload length
+#define FINGERPRINT_RECORD (8 + 2 + 8)
+
+/** @fn static inline size_t putU64(unsigned char *p, uint64_t val)
+ *  @brief Store a value as 8 little-endian bytes, the same on every machine
+ */
+static inline size_t putU64(unsigned char *p, uint64_t val)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+        p[i] = val >> (8 * i);
+    return 8;
+}
+
+/** @fn uint64_t fingerprintTrack(struct MidiCursor *c, unsigned long *events)
+ *  @brief Hash the normalized events of one track
+ *
+ * Each event is hashed as its absolute tick followed by its status and
+ * data bytes, or for Meta and SysEx events the type, length and payload.
+ *
+ * @param c: A cursor over the event data of the track
+ * @param events: Receives the number of events hashed
+ * @return The hash of the track
+ */
+uint64_t fingerprintTrack(struct MidiCursor *c, unsigned long *events)
+{
+    struct MidiHash h;
+    struct MidiEvent ev;
+    unsigned long tick = 0, n = 0;
+    unsigned char rec[FINGERPRINT_RECORD];
+    size_t len;
+    MIDI_PROFILE_START(start);
+
+    initMidiHash(&h, 0);
+    while (cursorReadEvent(c, &ev))
+    {
+        tick += ev.deltaTime;
+        len = putU64(rec, tick);
+        if (ev.status == 0xFF)
+        {
+            if (ev.data1 == 0x2f)
+                break;
+            if ((ev.data1 >= 0x01) && (ev.data1 <= 0x07))
+                continue;
+            rec[len++] = 0xFF;
+            rec[len++] = ev.data1;
+            len += putU64(rec + len, ev.length);
+            updateMidiHash(&h, rec, len);
+            if (ev.length > 0)
+                updateMidiHash(&h, ev.data, ev.length);
+        }
+        else if (ev.status >= 0xF0)
+        {
+            rec[len++] = ev.status;
+            len += putU64(rec + len, ev.length);
+            updateMidiHash(&h, rec, len);
+            if (ev.length > 0)
+                updateMidiHash(&h, ev.data, ev.length);
+        }
+        else
+        {
+            // Note-on velocity 0 and note-off are the same
+            if (((ev.status & 0xf0) == 0x80) || (((ev.status & 0xf0) == 0x90) && (ev.data2 == 0)))
+            {
+                rec[len++] = 0x80 | (ev.status & 0x0f);
+                rec[len++] = ev.data1;
+                rec[len++] = 0;
+            }
+            else
+            {
+                rec[len++] = ev.status;
+                rec[len++] = ev.data1;
+                rec[len++] = ev.data2;
+            }
+            updateMidiHash(&h, rec, len);
+        }
+        n++;
+    }
+    *events = n;
+    MIDI_PROFILE_STOP(start, MIDI_PROFILE_DECODE);
+    return digestMidiHash(&h);
+}
+
+/** @fn static int compareHashes(const void *a, const void *b)
+ *  @brief qsort() order of track hashes
+ */
+static int compareHashes(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+/** @fn int midiFingerprint(const unsigned char *data, size_t size, uint64_t *fingerprint)
+ *  @brief Fingerprint a whole file held in memory
+ *
+ * Every track the header announces must be there, a damaged or
+ * truncated copy is an error rather than the fingerprint of part of it.
+ *
+ * @param data: The file
+ * @param size: Size of the file in bytes
+ * @param fingerprint: Receives the fingerprint
+ * @return 0 on success, 1 if the header is not valid, 2 if a track chunk is missing
+ *         or has a bad id, -1 if memory could not be allocated
+ */
+int midiFingerprint(const unsigned char *data, size_t size, uint64_t *fingerprint)
+{
+    struct MidiCursor c, track;
+    struct MidiHeader midiHead;
+    struct TrackHeader trackHead;
+    struct MidiHash h;
+    uint64_t *hashes;
+    unsigned long events;
+    unsigned char div[2];
+    int i, n = 0;
+
+    initCursor(&c, data, size);
+    midiHead = cursorReadMidiChunk(&c);
+    if (strcmp(midiHead.cChunkType, MIDI_HEADER_ID) != 0)
+        return 1;
+    hashes = (uint64_t *)malloc((midiHead.uNumTracks ? midiHead.uNumTracks : 1) * sizeof(uint64_t));
+    if (hashes == NULL)
+        return -1;
+
+    for (i = 0; i < midiHead.uNumTracks; i++)
+    {
+        trackHead = cursorReadTrackChunk(&c);
+        if (strcmp(trackHead.cChunkType, MIDI_TRACK_ID) != 0)
+        {
+            free(hashes);
+            return 2;
+        }
+        cursorTrackEvents(&c, &trackHead, &track);
+        hashes[n] = fingerprintTrack(&track, &events);
+        if (events > 0)
+            n++;
+    }
+    qsort(hashes, n, sizeof(uint64_t), compareHashes);
+
+    initMidiHash(&h, 0);
+    div[0] = (uint16_t)midiHead.sTimeDiv >> 8;
+    div[1] = midiHead.sTimeDiv & 0xff;
+    updateMidiHash(&h, div, 2);
+    for (i = 0; i < n; i++)
+    {
+        unsigned char rec[8];
+
+        putU64(rec, hashes[i]);
+        updateMidiHash(&h, rec, 8);
+    }
+    *fingerprint = digestMidiHash(&h);
+    free(hashes);
+    return 0;
+}
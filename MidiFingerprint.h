@@ -0,0 +1,35 @@
+/** @file MidiFingerprint.h
+ *  @brief Normalized fingerprints for finding copies of the same song
+ *
+ *  This contains the function that hashes what a file plays rather
+ *  than its bytes, so copies that were re-saved by another program
+ *  get the same fingerprint. The event stream is normalized first:
+ *  - text Meta events (0x01-0x07) and End of Track are left out
+ *  - events are hashed decoded, running status or not
+ *  - delta times become absolute ticks, so dropped events shift nothing
+ *  - a note-on with velocity 0 and a note-off are the same event, the
+ *    note-off velocity is left out
+ *  - each track is hashed on its own and the track hashes are sorted,
+ *    so the order of the tracks does not matter, and tracks left empty
+ *    are ignored
+ *
+ *  The time division is part of the fingerprint, the format is not.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#ifndef MIDIBUFFER_H_
+#include "MidiBuffer.h"
+#endif
+
+#ifndef MIDIFINGERPRINT_H_
+#define MIDIFINGERPRINT_H_
+
+// Function Prototypes
+uint64_t fingerprintTrack(struct MidiCursor *c, unsigned long *events);
+int midiFingerprint(const unsigned char *data, size_t size, uint64_t *fingerprint);
+
+#endif
@@ -0,0 +1,183 @@
+/** @file MidiHash.c
+ *  @brief Fast non-cryptographic 64 bit hashing (XXH64)
+ *
+ *  The input is consumed in 32 byte stripes by four independent lanes,
+ *  the lanes are then merged and the tail mixed in, see the XXH64
+ *  specification. Results match the reference implementation.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#ifndef MIDIHASH_H_
+#include "MidiHash.h"
+#endif
+
+// XXH64 primes
+#define PRIME1 0x9E3779B185EBCA87ULL
+#define PRIME2 0xC2B2AE3D27D4EB4FULL
+#define PRIME3 0x165667B19E3779F9ULL
+#define PRIME4 0x85EBCA77C2B2AE63ULL
+#define PRIME5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char *p)
+{
+    return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+           ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+static inline uint32_t read32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t hashRound(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME1;
+}
+
+static inline uint64_t mergeRound(uint64_t acc, uint64_t val)
+{
+    acc ^= hashRound(0, val);
+    return acc * PRIME1 + PRIME4;
+}
+
+/** @fn static const unsigned char *stripes(uint64_t *acc, const unsigned char *p, const unsigned char *end)
+ *  @brief Consume whole 32 byte stripes
+ *
+ * @return The first byte not consumed
+ */
+static const unsigned char *stripes(uint64_t *acc, const unsigned char *p, const unsigned char *end)
+{
+    while (end - p >= 32)
+    {
+        acc[0] = hashRound(acc[0], read64(p));
+        acc[1] = hashRound(acc[1], read64(p + 8));
+        acc[2] = hashRound(acc[2], read64(p + 16));
+        acc[3] = hashRound(acc[3], read64(p + 24));
+        p += 32;
+    }
+    return p;
+}
+
+/** @fn static uint64_t finish(const uint64_t *acc, uint64_t seed, uint64_t total, const unsigned char *p, size_t len)
+ *  @brief Merge the lanes and mix in the tail of fewer than 32 bytes
+ */
+static uint64_t finish(const uint64_t *acc, uint64_t seed, uint64_t total, const unsigned char *p, size_t len)
+{
+    const unsigned char *end = p + len;
+    uint64_t h;
+
+    if (total >= 32)
+    {
+        h = rotl64(acc[0], 1) + rotl64(acc[1], 7) + rotl64(acc[2], 12) + rotl64(acc[3], 18);
+        h = mergeRound(h, acc[0]);
+        h = mergeRound(h, acc[1]);
+        h = mergeRound(h, acc[2]);
+        h = mergeRound(h, acc[3]);
+    }
+    else
+        h = seed + PRIME5;
+    h += total;
+
+    while (end - p >= 8)
+    {
+        h ^= hashRound(0, read64(p));
+        h = rotl64(h, 27) * PRIME1 + PRIME4;
+        p += 8;
+    }
+    if (end - p >= 4)
+    {
+        h ^= (uint64_t)read32(p) * PRIME1;
+        h = rotl64(h, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    while (p < end)
+    {
+        h ^= *p++ * PRIME5;
+        h = rotl64(h, 11) * PRIME1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+/** @fn void initMidiHash(struct MidiHash *h, uint64_t seed)
+ *  @brief Start an incremental hash
+ */
+void initMidiHash(struct MidiHash *h, uint64_t seed)
+{
+    h->acc[0] = seed + PRIME1 + PRIME2;
+    h->acc[1] = seed + PRIME2;
+    h->acc[2] = seed;
+    h->acc[3] = seed - PRIME1;
+    h->seed = seed;
+    h->total = 0;
+    h->bufLen = 0;
+}
+
+/** @fn void updateMidiHash(struct MidiHash *h, const void *data, size_t len)
+ *  @brief Add bytes to an incremental hash
+ */
+void updateMidiHash(struct MidiHash *h, const void *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)data, *end = p + len;
+    size_t n;
+
+    h->total += len;
+    if (h->bufLen + len < 32)
+    {
+        memcpy(h->buf + h->bufLen, p, len);
+        h->bufLen += len;
+        return;
+    }
+    if (h->bufLen > 0)
+    {
+        n = 32 - h->bufLen;
+        memcpy(h->buf + h->bufLen, p, n);
+        stripes(h->acc, h->buf, h->buf + 32);
+        p += n;
+        h->bufLen = 0;
+    }
+    p = stripes(h->acc, p, end);
+    h->bufLen = end - p;
+    memcpy(h->buf, p, h->bufLen);
+}
+
+/** @fn uint64_t digestMidiHash(const struct MidiHash *h)
+ *  @brief The hash of everything added so far, more can still be added
+ */
+uint64_t digestMidiHash(const struct MidiHash *h)
+{
+    return finish(h->acc, h->seed, h->total, h->buf, h->bufLen);
+}
+
+/** @fn uint64_t midiHash64(const void *data, size_t len, uint64_t seed)
+ *  @brief Hash a block of memory in one call
+ *
+ * @param data: The bytes to hash
+ * @param len: Number of bytes
+ * @param seed: Seed, 0 unless different hashes of the same data are wanted
+ * @return The XXH64 hash
+ */
+uint64_t midiHash64(const void *data, size_t len, uint64_t seed)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t acc[4] = {seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1};
+    const unsigned char *tail;
+
+    tail = stripes(acc, p, p + len);
+    return finish(acc, seed, len, tail, p + len - tail);
+}
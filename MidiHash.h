@@ -0,0 +1,42 @@
+/** @file MidiHash.h
+ *  @brief Fast non-cryptographic 64 bit hashing (XXH64)
+ *
+ *  This contains a self-contained implementation of the XXH64 hash, in
+ *  one call for a block of memory or incrementally for data that is
+ *  produced a piece at a time. It is used to identify file contents and
+ *  event streams, not for security.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#ifndef MIDIINFO_H_
+#include "MidiInfo.h"
+#endif
+
+#ifndef MIDIHASH_H_
+#define MIDIHASH_H_
+
+// Data Structures
+/** @struct MidiHash
+ *  @brief State of an incremental hash
+ *
+ * Acc holds the four lanes, buf the bytes not yet making up a 32 byte stripe.\n
+ */
+struct MidiHash
+{
+	uint64_t acc[4];
+	uint64_t seed, total;
+	unsigned char buf[32];
+	size_t bufLen;
+};
+
+// Function Prototypes
+uint64_t midiHash64(const void *data, size_t len, uint64_t seed);
+void initMidiHash(struct MidiHash *h, uint64_t seed);
+void updateMidiHash(struct MidiHash *h, const void *data, size_t len);
+uint64_t digestMidiHash(const struct MidiHash *h);
+
+#endif
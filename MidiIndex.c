@@ -0,0 +1,594 @@
+/** @file MidiIndex.c
+ *  @brief On-disk inverted index over the text Meta events of a collection
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#ifndef MIDIINDEX_H_
+#include "MidiIndex.h"
+#endif
+
+/// @brief Names of Meta types 0x01-0x07, also the field names of a query
+static const char *typeNames[8] = {NULL, "text", "copyright", "name", "instrument", "lyric", "marker", "cue"};
+
+/** @struct TermRef
+ *  @brief A word of one file, while the words of all files are sorted together
+ */
+struct TermRef
+{
+    const struct MidiTerm *term;
+    uint32_t file;
+};
+
+/** @fn static inline int isTermByte(unsigned char b)
+ *  @brief Check whether a byte is part of a word: a letter, a digit or 0x80 and above
+ */
+static inline int isTermByte(unsigned char b)
+{
+    return ((b >= '0') && (b <= '9')) || ((b >= 'a') && (b <= 'z')) || ((b >= 'A') && (b <= 'Z')) || (b >= 0x80);
+}
+
+/** @fn static size_t nextTerm(const unsigned char *text, size_t len, size_t *pos, char *term)
+ *  @brief Find the next word of a text, lowercased and cut to MIDI_INDEX_TERM_MAX - 1 bytes
+ *
+ * @param text: The text
+ * @param len: Length of the text
+ * @param pos: Where to start looking, updated to the end of the word
+ * @param term: Receives the word, NUL terminated
+ * @return Length of the word, 0 if there are no more words
+ */
+static size_t nextTerm(const unsigned char *text, size_t len, size_t *pos, char *term)
+{
+    size_t i = *pos, n = 0;
+
+    while ((i < len) && !isTermByte(text[i]))
+        i++;
+    for (; (i < len) && isTermByte(text[i]); i++)
+    {
+        if (n < MIDI_INDEX_TERM_MAX - 1)
+            term[n++] = ((text[i] >= 'A') && (text[i] <= 'Z')) ? text[i] + ('a' - 'A') : text[i];
+    }
+    term[n] = '\0';
+    *pos = i;
+    return n;
+}
+
+/** @fn static int compareTerms(const void *a, const void *b)
+ *  @brief qsort() order of words, byte by byte with a shorter prefix first
+ */
+static int compareTerms(const void *a, const void *b)
+{
+    return strcmp(((const struct MidiTerm *)a)->text, ((const struct MidiTerm *)b)->text);
+}
+
+/** @fn static void mergeTerms(struct MidiTermList *l)
+ *  @brief Sort the words of a list and merge duplicates, combining their types
+ */
+static void mergeTerms(struct MidiTermList *l)
+{
+    size_t i, n = 0;
+
+    if (l->count == 0)
+        return;
+    qsort(l->terms, l->count, sizeof(struct MidiTerm), compareTerms);
+    for (i = 1; i < l->count; i++)
+    {
+        if (strcmp(l->terms[i].text, l->terms[n].text) == 0)
+            l->terms[n].types |= l->terms[i].types;
+        else
+            l->terms[++n] = l->terms[i];
+    }
+    l->count = n + 1;
+}
+
+/** @fn void initMidiTermList(struct MidiTermList *l)
+ *  @brief Start an empty list of words
+ */
+void initMidiTermList(struct MidiTermList *l)
+{
+    l->terms = NULL;
+    l->count = 0;
+    l->capacity = 0;
+}
+
+/** @fn int addMidiTerms(struct MidiTermList *l, const unsigned char *text, size_t len, int type)
+ *  @brief Add the words of a text to a list
+ *
+ * When the list is full its duplicates are merged before it grows, so
+ * a file repeating the same lyrics many times stays small.
+ *
+ * @param l: The list
+ * @param text: The text, need not be NUL terminated
+ * @param len: Length of the text
+ * @param type: The Meta type the text came from, 0x01-0x07
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+int addMidiTerms(struct MidiTermList *l, const unsigned char *text, size_t len, int type)
+{
+    struct MidiTerm *t;
+    size_t pos = 0, capacity;
+    void *p;
+
+    for (;;)
+    {
+        if (l->count == l->capacity)
+        {
+            mergeTerms(l);
+            if (l->count >= l->capacity / 2)
+            {
+                capacity = l->capacity ? l->capacity * 2 : 256;
+                if ((p = realloc(l->terms, capacity * sizeof(struct MidiTerm))) == NULL)
+                    return -1;
+                l->terms = (struct MidiTerm *)p;
+                l->capacity = capacity;
+            }
+        }
+        t = &l->terms[l->count];
+        if ((t->len = nextTerm(text, len, &pos, t->text)) == 0)
+            return 0;
+        t->types = MIDI_INDEX_TYPE(type);
+        l->count++;
+    }
+}
+
+/** @fn int collectMidiTerms(struct MidiTermList *l, const unsigned char *data, size_t size)
+ *  @brief Add the words of the text Meta events of a file to a list
+ *
+ * Only Meta events are decoded, see cursorReadMetaEvent(). Tracks are
+ * read up to the first chunk that is not a track. The list is sorted
+ * and without duplicates afterwards.
+ *
+ * @param l: The list
+ * @param data: The file
+ * @param size: Size of the file in bytes
+ * @return 0 on success, 1 if the header is not valid, -1 if memory could not be allocated
+ */
+int collectMidiTerms(struct MidiTermList *l, const unsigned char *data, size_t size)
+{
+    struct MidiCursor c, track;
+    struct MidiHeader midiHead;
+    struct TrackHeader trackHead;
+    struct MidiEvent ev;
+    int i;
+
+    initCursor(&c, data, size);
+    midiHead = cursorReadMidiChunk(&c);
+    if (strcmp(midiHead.cChunkType, MIDI_HEADER_ID) != 0)
+        return 1;
+    for (i = 0; i < midiHead.uNumTracks; i++)
+    {
+        trackHead = cursorReadTrackChunk(&c);
+        if (strcmp(trackHead.cChunkType, MIDI_TRACK_ID) != 0)
+            break;
+        cursorTrackEvents(&c, &trackHead, &track);
+        while (cursorReadMetaEvent(&track, &ev))
+        {
+            if ((ev.data1 >= 0x01) && (ev.data1 <= 0x07) &&
+                (addMidiTerms(l, ev.data, ev.length, ev.data1) != 0))
+                return -1;
+        }
+    }
+    mergeTerms(l);
+    return 0;
+}
+
+/** @fn void freeMidiTermList(struct MidiTermList *l)
+ *  @brief Release the words of a list
+ */
+void freeMidiTermList(struct MidiTermList *l)
+{
+    free(l->terms);
+    initMidiTermList(l);
+}
+
+/** @fn static int compareRefs(const void *a, const void *b)
+ *  @brief qsort() order of the words of all files, word then file
+ */
+static int compareRefs(const void *a, const void *b)
+{
+    const struct TermRef *x = (const struct TermRef *)a, *y = (const struct TermRef *)b;
+    int ret = strcmp(x->term->text, y->term->text);
+
+    if (ret != 0)
+        return ret;
+    return (x->file < y->file) ? -1 : (x->file > y->file);
+}
+
+/** @fn int writeMidiIndex(const char *path, char *const *paths, const struct MidiTermList *lists, size_t numFiles)
+ *  @brief Write an index of the words of a collection
+ *
+ * The file is written next to path and renamed over it, so a failed
+ * write leaves an older index in place.
+ *
+ * @param path: The index file
+ * @param paths: Path of each file, its file ID is its index
+ * @param lists: Words of each file from collectMidiTerms(), empty for files that could not be read
+ * @param numFiles: Number of files
+ * @return 0 on success, -1 on error with errno set
+ */
+int writeMidiIndex(const char *path, char *const *paths, const struct MidiTermList *lists, size_t numFiles)
+{
+    struct MidiIndexHeader head;
+    struct MidiIndexFile *files = NULL;
+    struct MidiIndexTerm *terms = NULL;
+    struct MidiIndexPosting *postings = NULL;
+    struct TermRef *refs = NULL;
+    size_t numRefs = 0, numTerms = 0, i, j;
+    uint64_t offset = 0;
+    char *tmp = NULL;
+    FILE *f = NULL;
+    int ret = -1;
+
+    if (numFiles > UINT32_MAX)
+        return -1;
+    for (i = 0; i < numFiles; i++)
+        numRefs += lists[i].count;
+    files = (struct MidiIndexFile *)calloc(numFiles ? numFiles : 1, sizeof(struct MidiIndexFile));
+    refs = (struct TermRef *)malloc((numRefs ? numRefs : 1) * sizeof(struct TermRef));
+    postings = (struct MidiIndexPosting *)malloc((numRefs ? numRefs : 1) * sizeof(struct MidiIndexPosting));
+    terms = (struct MidiIndexTerm *)malloc((numRefs ? numRefs : 1) * sizeof(struct MidiIndexTerm));
+    tmp = (char *)malloc(strlen(path) + 5);
+    if ((files == NULL) || (refs == NULL) || (postings == NULL) || (terms == NULL) || (tmp == NULL))
+        goto done;
+
+    for (i = 0; i < numFiles; i++)
+    {
+        files[i].pathOffset = offset;
+        files[i].pathLen = strlen(paths[i]);
+        offset += files[i].pathLen;
+    }
+    for (i = 0, numRefs = 0; i < numFiles; i++)
+    {
+        for (j = 0; j < lists[i].count; j++)
+        {
+            refs[numRefs].term = &lists[i].terms[j];
+            refs[numRefs++].file = i;
+        }
+    }
+    qsort(refs, numRefs, sizeof(struct TermRef), compareRefs);
+
+    // One term per run of equal words, one posting per file of the run
+    for (i = 0; i < numRefs; i++)
+    {
+        if ((i == 0) || (strcmp(refs[i].term->text, refs[i - 1].term->text) != 0))
+        {
+            terms[numTerms].textOffset = offset;
+            terms[numTerms].textLen = refs[i].term->len;
+            terms[numTerms].firstPosting = i;
+            terms[numTerms].numPostings = 0;
+            offset += refs[i].term->len;
+            numTerms++;
+        }
+        terms[numTerms - 1].numPostings++;
+        postings[i].file = refs[i].file;
+        postings[i].types = refs[i].term->types;
+    }
+
+    memset(&head, 0, sizeof(head));
+    head.magic = MIDI_INDEX_MAGIC;
+    head.version = MIDI_INDEX_VERSION;
+    head.numFiles = numFiles;
+    head.numTerms = numTerms;
+    head.numPostings = numRefs;
+    head.dataSize = offset;
+
+    sprintf(tmp, "%s.tmp", path);
+    if ((f = fopen(tmp, "wb")) == NULL)
+        goto done;
+    fwrite(&head, sizeof(head), 1, f);
+    fwrite(files, sizeof(struct MidiIndexFile), numFiles, f);
+    fwrite(terms, sizeof(struct MidiIndexTerm), numTerms, f);
+    fwrite(postings, sizeof(struct MidiIndexPosting), numRefs, f);
+    for (i = 0; i < numFiles; i++)
+        fwrite(paths[i], 1, files[i].pathLen, f);
+    for (i = 0; i < numTerms; i++)
+        fwrite(refs[terms[i].firstPosting].term->text, 1, terms[i].textLen, f);
+    ret = (ferror(f) | fclose(f)) ? -1 : 0;
+    if ((ret == 0) && (rename(tmp, path) != 0))
+        ret = -1;
+    if (ret != 0)
+        remove(tmp);
+
+done:
+    free(files);
+    free(refs);
+    free(postings);
+    free(terms);
+    free(tmp);
+    return ret;
+}
+
+/** @fn int openMidiIndex(struct MidiIndex *idx, const char *path)
+ *  @brief Map an index file for searching
+ *
+ * @param idx: The index to open
+ * @param path: The index file
+ * @return 0 on success, -1 if the file could not be read, 1 if it is not an index of this version
+ */
+int openMidiIndex(struct MidiIndex *idx, const char *path)
+{
+    const struct MidiIndexHeader *head;
+    size_t left;
+
+    memset(idx, 0, sizeof(struct MidiIndex));
+    if (loadMidiBuffer(path, &idx->file) != 0)
+        return -1;
+    head = (const struct MidiIndexHeader *)idx->file.data;
+    if ((idx->file.size < sizeof(struct MidiIndexHeader)) || (head->magic != MIDI_INDEX_MAGIC) ||
+        (head->version != MIDI_INDEX_VERSION))
+        goto bad;
+
+    // Each table must fit in what is left of the file
+    left = idx->file.size - sizeof(struct MidiIndexHeader);
+    if (left / sizeof(struct MidiIndexFile) < head->numFiles)
+        goto bad;
+    left -= (size_t)head->numFiles * sizeof(struct MidiIndexFile);
+    if (left / sizeof(struct MidiIndexTerm) < head->numTerms)
+        goto bad;
+    left -= head->numTerms * sizeof(struct MidiIndexTerm);
+    if (left / sizeof(struct MidiIndexPosting) < head->numPostings)
+        goto bad;
+    left -= head->numPostings * sizeof(struct MidiIndexPosting);
+    if (left != head->dataSize)
+        goto bad;
+
+    idx->files = (const struct MidiIndexFile *)(idx->file.data + sizeof(struct MidiIndexHeader));
+    idx->terms = (const struct MidiIndexTerm *)(idx->files + head->numFiles);
+    idx->postings = (const struct MidiIndexPosting *)(idx->terms + head->numTerms);
+    idx->data = (const unsigned char *)(idx->postings + head->numPostings);
+    idx->numFiles = head->numFiles;
+    idx->numTerms = head->numTerms;
+    idx->numPostings = head->numPostings;
+    idx->dataSize = head->dataSize;
+    return 0;
+
+bad:
+    freeMidiBuffer(&idx->file);
+    return 1;
+}
+
+/** @fn static int compareIndexTerm(const struct MidiIndex *idx, const struct MidiIndexTerm *t, const char *term, size_t len, int prefix)
+ *  @brief Compare a term of the index with a word, in the order of the term table
+ *
+ * @param prefix: Non-zero if every term starting with the word compares equal
+ * @return Less than, equal to or greater than 0 as the term sorts before, with or after the word
+ */
+static int compareIndexTerm(const struct MidiIndex *idx, const struct MidiIndexTerm *t, const char *term, size_t len, int prefix)
+{
+    size_t tlen = t->textLen;
+    int ret;
+
+    // A damaged term sorts first and never matches
+    if ((t->textOffset > idx->dataSize) || (idx->dataSize - t->textOffset < tlen))
+        return -1;
+    ret = memcmp(idx->data + t->textOffset, term, (tlen < len) ? tlen : len);
+    if (ret != 0)
+        return ret;
+    if (tlen < len)
+        return -1;
+    return (prefix || (tlen == len)) ? 0 : 1;
+}
+
+/** @fn static int comparePostings(const void *a, const void *b)
+ *  @brief qsort() order of postings, by file
+ */
+static int comparePostings(const void *a, const void *b)
+{
+    uint32_t x = ((const struct MidiIndexPosting *)a)->file, y = ((const struct MidiIndexPosting *)b)->file;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+/** @fn static struct MidiIndexPosting *findPostings(const struct MidiIndex *idx, const char *term, size_t len, int prefix, uint32_t types, size_t *count)
+ *  @brief Get the files containing a word, or any word starting with it
+ *
+ * The terms matching the word are found with two binary searches, the
+ * postings of several terms are combined into one per file.
+ *
+ * @param types: Type bits to keep, postings with none of them are left out
+ * @param count: Receives the number of postings
+ * @return The postings sorted by file, to be freed, NULL if memory could not be allocated
+ */
+static struct MidiIndexPosting *findPostings(const struct MidiIndex *idx, const char *term, size_t len, int prefix,
+                                             uint32_t types, size_t *count)
+{
+    const struct MidiIndexTerm *t;
+    struct MidiIndexPosting *list;
+    uint64_t lo = 0, hi = idx->numTerms, mid, first, last, i, j;
+    size_t n = 0, total = 0;
+
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (compareIndexTerm(idx, &idx->terms[mid], term, len, prefix) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    first = lo;
+    hi = idx->numTerms;
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (compareIndexTerm(idx, &idx->terms[mid], term, len, prefix) <= 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    last = lo;
+
+    for (i = first; i < last; i++)
+    {
+        t = &idx->terms[i];
+        if ((t->firstPosting <= idx->numPostings) && (idx->numPostings - t->firstPosting >= t->numPostings))
+            total += t->numPostings;
+    }
+    if ((list = (struct MidiIndexPosting *)malloc((total ? total : 1) * sizeof(struct MidiIndexPosting))) == NULL)
+        return NULL;
+    for (i = first; i < last; i++)
+    {
+        t = &idx->terms[i];
+        if ((t->firstPosting > idx->numPostings) || (idx->numPostings - t->firstPosting < t->numPostings))
+            continue;
+        for (j = 0; j < t->numPostings; j++)
+        {
+            list[n] = idx->postings[t->firstPosting + j];
+            list[n].types &= types;
+            if (list[n].types != 0)
+                n++;
+        }
+    }
+    if (last - first > 1)
+    {
+        qsort(list, n, sizeof(struct MidiIndexPosting), comparePostings);
+        for (i = 1, j = 0; i < n; i++)
+        {
+            if (list[i].file == list[j].file)
+                list[j].types |= list[i].types;
+            else
+                list[++j] = list[i];
+        }
+        n = (n > 0) ? j + 1 : 0;
+    }
+    *count = n;
+    return list;
+}
+
+/** @fn static size_t intersectPostings(struct MidiIndexPosting *a, size_t na, const struct MidiIndexPosting *b, size_t nb)
+ *  @brief Keep the files of a that are also in b, with the types of both
+ *
+ * @return The number of postings left in a
+ */
+static size_t intersectPostings(struct MidiIndexPosting *a, size_t na, const struct MidiIndexPosting *b, size_t nb)
+{
+    size_t i = 0, j = 0, n = 0;
+
+    while ((i < na) && (j < nb))
+    {
+        if (a[i].file < b[j].file)
+            i++;
+        else if (a[i].file > b[j].file)
+            j++;
+        else
+        {
+            a[n].file = a[i].file;
+            a[n++].types = a[i++].types | b[j++].types;
+        }
+    }
+    return n;
+}
+
+/** @fn int searchMidiIndex(const struct MidiIndex *idx, char *const *words, int numWords, struct MidiIndexPosting **results, size_t *count)
+ *  @brief Find the files containing all of the words of a query
+ *
+ * Each query word is split into words like the text it is matched
+ * against, all of them must be found in a file. A word may start with
+ * a field, one of the names of midiIndexTypeName() and a colon, to only
+ * match that Meta type, as in lyric:love, and may end with * to match
+ * any word starting with it.
+ *
+ * @param idx: The open index
+ * @param words: The query words
+ * @param numWords: Number of query words
+ * @param results: Receives the matching files sorted by file ID, with the
+ *        types the words were found in, to be freed
+ * @param count: Receives the number of matching files
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+int searchMidiIndex(const struct MidiIndex *idx, char *const *words, int numWords,
+                    struct MidiIndexPosting **results, size_t *count)
+{
+    struct MidiIndexPosting *found = NULL, *list;
+    const unsigned char *word;
+    char term[MIDI_INDEX_TERM_MAX];
+    const char *colon;
+    size_t len, pos, n, numFound = 0;
+    uint32_t types;
+    int i, t, prefix, started = 0;
+
+    for (i = 0; i < numWords; i++)
+    {
+        word = (const unsigned char *)words[i];
+        types = MIDI_INDEX_ALL_TYPES;
+        if ((colon = strchr(words[i], ':')) != NULL)
+        {
+            for (t = 0x01; t <= 0x07; t++)
+            {
+                if ((strlen(typeNames[t]) == (size_t)(colon - words[i])) &&
+                    (strncmp(words[i], typeNames[t], colon - words[i]) == 0))
+                {
+                    types = MIDI_INDEX_TYPE(t);
+                    word = (const unsigned char *)colon + 1;
+                }
+            }
+        }
+        len = strlen((const char *)word);
+        prefix = (len > 0) && (word[len - 1] == '*');
+
+        pos = 0;
+        while (nextTerm(word, len, &pos, term) > 0)
+        {
+            // Only the last word of a prefix query is a prefix
+            list = findPostings(idx, term, strlen(term), prefix && (pos >= len - 1), types, &n);
+            if (list == NULL)
+            {
+                free(found);
+                return -1;
+            }
+            if (!started)
+            {
+                found = list;
+                numFound = n;
+                started = 1;
+            }
+            else
+            {
+                numFound = intersectPostings(found, numFound, list, n);
+                free(list);
+            }
+        }
+    }
+    *results = found;
+    *count = numFound;
+    return 0;
+}
+
+/** @fn const char *midiIndexPath(const struct MidiIndex *idx, uint32_t file, uint32_t *len)
+ *  @brief Get the path of a file of the index
+ *
+ * @param len: Receives the length of the path, which is not NUL terminated
+ * @return The path, NULL if the file ID or the entry is not valid
+ */
+const char *midiIndexPath(const struct MidiIndex *idx, uint32_t file, uint32_t *len)
+{
+    const struct MidiIndexFile *f;
+
+    if (file >= idx->numFiles)
+        return NULL;
+    f = &idx->files[file];
+    if ((f->pathOffset > idx->dataSize) || (idx->dataSize - f->pathOffset < f->pathLen))
+        return NULL;
+    *len = f->pathLen;
+    return (const char *)idx->data + f->pathOffset;
+}
+
+/** @fn const char *midiIndexTypeName(int type)
+ *  @brief Short name of a text Meta type, as printed and as a query field
+ *
+ * @return The name, NULL if type is not 0x01-0x07
+ */
+const char *midiIndexTypeName(int type)
+{
+    return ((type >= 0x01) && (type <= 0x07)) ? typeNames[type] : NULL;
+}
+
+/** @fn void closeMidiIndex(struct MidiIndex *idx)
+ *  @brief Unmap an index file
+ */
+void closeMidiIndex(struct MidiIndex *idx)
+{
+    freeMidiBuffer(&idx->file);
+    memset(idx, 0, sizeof(struct MidiIndex));
+}
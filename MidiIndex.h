@@ -0,0 +1,137 @@
+/** @file MidiIndex.h
+ *  @brief On-disk inverted index over the text Meta events of a collection
+ *
+ *  This contains the data structures and functions needed to build an
+ *  index of the words in the text Meta events (0x01-0x07: text,
+ *  copyright, track name, instrument, lyric, marker and cue point) of
+ *  many files, and to look words up in it without reading the files.
+ *
+ *  Words are runs of letters, digits and bytes 0x80 and above (so UTF-8
+ *  and Latin-1 words stay whole), lowercased, and cut to
+ *  MIDI_INDEX_TERM_MAX - 1 bytes. Queries are split the same way.
+ *
+ *  The index file is read with mmap() and never parsed: a header, the
+ *  file table, the term table sorted by term for binary search, the
+ *  postings of every term sorted by file, then the paths and terms.
+ *  Each posting holds a file ID, its index in the file table, and a bit
+ *  per Meta type the word was found in. Like the result cache, the file
+ *  is in the byte order of the machine that wrote it.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#ifndef MIDIBUFFER_H_
+#include "MidiBuffer.h"
+#endif
+
+#ifndef MIDIINDEX_H_
+#define MIDIINDEX_H_
+
+/// @brief Identifies an index file, also catches a different byte order
+#define MIDI_INDEX_MAGIC 0x3158444e49494d44ULL
+
+/// @brief Format version, indexes of other versions are rejected
+#define MIDI_INDEX_VERSION 1
+
+/// @brief Size of a term including its terminating NUL, longer words are cut
+#define MIDI_INDEX_TERM_MAX 32
+
+/// @brief Posting type bit of Meta type t (0x01-0x07)
+#define MIDI_INDEX_TYPE(t) (1u << (t))
+
+/// @brief Every type bit, for queries not restricted to one Meta type
+#define MIDI_INDEX_ALL_TYPES 0xfeu
+
+// Data Structures
+/** @struct MidiIndexHeader
+ *  @brief Start of an index file
+ *
+ * The file table, term table and postings follow the header, then
+ * dataSize bytes of paths and terms.\n
+ */
+struct MidiIndexHeader
+{
+	uint64_t magic;
+	uint32_t version, numFiles;
+	uint64_t numTerms, numPostings;
+	uint64_t dataSize;
+};
+
+/** @struct MidiIndexFile
+ *  @brief One file of the index, its path is pathLen bytes at pathOffset in the data
+ */
+struct MidiIndexFile
+{
+	uint64_t pathOffset;
+	uint32_t pathLen, reserved;
+};
+
+/** @struct MidiIndexTerm
+ *  @brief One word of the index
+ *
+ * Its postings are numPostings entries from index firstPosting.\n
+ */
+struct MidiIndexTerm
+{
+	uint64_t textOffset, firstPosting;
+	uint32_t textLen, numPostings;
+};
+
+/** @struct MidiIndexPosting
+ *  @brief A file containing a word, types has MIDI_INDEX_TYPE() bits set
+ */
+struct MidiIndexPosting
+{
+	uint32_t file, types;
+};
+
+/** @struct MidiTerm
+ *  @brief A word found in one file while building an index
+ */
+struct MidiTerm
+{
+	char text[MIDI_INDEX_TERM_MAX];
+	uint32_t len, types;
+};
+
+/** @struct MidiTermList
+ *  @brief The words of one file, sorted and without duplicates after collectMidiTerms()
+ */
+struct MidiTermList
+{
+	struct MidiTerm *terms;
+	size_t count, capacity;
+};
+
+/** @struct MidiIndex
+ *  @brief An open, mapped index file
+ */
+struct MidiIndex
+{
+	struct MidiBuffer file;
+	const struct MidiIndexFile *files;
+	const struct MidiIndexTerm *terms;
+	const struct MidiIndexPosting *postings;
+	const unsigned char *data;
+	uint32_t numFiles;
+	uint64_t numTerms, numPostings, dataSize;
+};
+
+// Function Prototypes
+void initMidiTermList(struct MidiTermList *l);
+int addMidiTerms(struct MidiTermList *l, const unsigned char *text, size_t len, int type);
+int collectMidiTerms(struct MidiTermList *l, const unsigned char *data, size_t size);
+void freeMidiTermList(struct MidiTermList *l);
+int writeMidiIndex(const char *path, char *const *paths, const struct MidiTermList *lists, size_t numFiles);
+
+int openMidiIndex(struct MidiIndex *idx, const char *path);
+int searchMidiIndex(const struct MidiIndex *idx, char *const *words, int numWords,
+					struct MidiIndexPosting **results, size_t *count);
+const char *midiIndexPath(const struct MidiIndex *idx, uint32_t file, uint32_t *len);
+const char *midiIndexTypeName(int type);
+void closeMidiIndex(struct MidiIndex *idx);
+
+#endif
@@ -14,8 +14,12 @@
 #include "MidiInfo.h"
 #endif
 
-#ifndef MIDI_INSTRUMENTS
-#define MIDI_INSTRUMENTS 128
+#ifndef MIDIARENA_H_
+#include "MidiArena.h"
+#endif
+
+#ifndef MIDIPROFILE_H_
+#include "MidiProfile.h"
 #endif
 
 // Standard MIDI instrument names
@@ -38,6 +42,104 @@ char *instrTable[MIDI_INSTRUMENTS] = {
     "Synth Drum", "Reverse Cymbal", "Guitar Fret Noise", "Breath Noise", "Seashore", "Bird Tweet", "Telephone Ring",
     "Helicopter", "Applause", "Gunshot"};
 
+// SysEx packet kinds
+const char *sysExKindNames[MIDI_SYSEX_KINDS] = {"System Exclusive", "Divided System Exclusive, first packet",
+                                                "Divided System Exclusive, continued", "Divided System Exclusive, last packet",
+                                                "SysEx Escape"};
+
+// Manufacturer IDs, the most common in MIDI files
+static const struct
+{
+    unsigned long id;
+    const char *name;
+} manufacturerNames[] = {
+    {0x01, "Sequential"}, {0x04, "Moog"}, {0x06, "Lexicon"}, {0x07, "Kurzweil"}, {0x0F, "Ensoniq"},
+    {0x10, "Oberheim"}, {0x18, "E-mu"}, {0x40, "Kawai"}, {0x41, "Roland"}, {0x42, "Korg"}, {0x43, "Yamaha"},
+    {0x44, "Casio"}, {0x47, "Akai"}, {0x7D, "Non-Commercial"}, {0x7E, "Universal Non-Real Time"},
+    {0x7F, "Universal Real Time"}, {MIDI_MANUFACTURER_EXTENDED | 0x000E, "Alesis"},
+    {MIDI_MANUFACTURER_EXTENDED | 0x2029, "Novation"}, {MIDI_MANUFACTURER_EXTENDED | 0x206B, "Arturia"}};
+
+// Payloads of the events being read, reset by readTrackEvents()
+static __thread struct MidiArena payloadArena;
+
+// Non-zero while a divided SysEx message is open in the track being read
+static __thread unsigned char sysExOpen;
+
+/** @fn static void skipPayload(FILE *f, unsigned long len)
+ *  @brief Skip the bytes of a payload, stopping at the end of the file
+ */
+static void skipPayload(FILE *f, unsigned long len)
+{
+    unsigned char buffer[256];
+    size_t n;
+
+    while ((len > 0) && ((n = fread(buffer, 1, (len < sizeof(buffer)) ? len : sizeof(buffer), f)) > 0))
+        len -= n;
+}
+
+/** @fn static unsigned long payloadSize(FILE *f, unsigned long len)
+ *  @brief Cap a payload length to the bytes left in the file
+ *
+ * A corrupt length can be anything, lengths over an arena
+ * block are checked against the end of the file when it can be found,
+ * so the arena never holds more than the file.
+ */
+static unsigned long payloadSize(FILE *f, unsigned long len)
+{
+    long pos, end;
+
+    if ((len <= MIDI_ARENA_BLOCK) || ((pos = ftell(f)) < 0) || (fseek(f, 0, SEEK_END) != 0))
+        return len;
+    end = ftell(f);
+    fseek(f, pos, SEEK_SET);
+    if ((end >= pos) && ((unsigned long)(end - pos) < len))
+        return end - pos;
+    return len;
+}
+
+/** @fn static struct MidiView readPayload(FILE *f, unsigned long len, const char *what)
+ *  @brief Read an event payload into the payload arena
+ *
+ * If memory runs out the payload is skipped and an empty view returned,
+ * either way the file is left after the payload.
+ *
+ * @param f: The file to read from
+ * @param len: Length of the payload
+ * @param what: Name of the payload for the error message
+ * @return A view of the bytes read, shorter than len at the end of the file
+ */
+static struct MidiView readPayload(FILE *f, unsigned long len, const char *what)
+{
+    struct MidiView view = {(const unsigned char *)"", 0};
+    unsigned char *buffer;
+
+    if (len == 0)
+        return view;
+    len = payloadSize(f, len);
+    buffer = (unsigned char *)midiArenaAlloc(&payloadArena, len);
+    if (buffer == NULL)
+    {
+        fprintf(stderr, "Error allocating memory to read %s\n", what);
+        skipPayload(f, len);
+        return view;
+    }
+    view.data = buffer;
+    view.len = fread(buffer, 1, len, f);
+    return view;
+}
+
+/** @fn void freeMidiPayloads(void)
+ *  @brief Release the payload arena of the calling thread
+ *
+ * readTrackEvents() reuses the arena from track to track, call this
+ * when a thread is done reading files.
+ */
+void freeMidiPayloads(void)
+{
+    freeMidiArena(&payloadArena);
+    payloadArena.peak = 0;
+}
+
 /** @fn int intPow(int base, int exp)
  * @brief Integer Power of function
  *
@@ -162,7 +264,7 @@ unsigned long readVarLen(FILE *f)
         do
         {
             val = (val << 7) + ((c = getc(f)) & 0x7F);
-        } while (c & 0x80);
+        } while ((c & 0x80) && !feof(f));
     }
     return (val);
 }
@@ -193,11 +295,12 @@ unsigned long readVarLen(FILE *f)
  */
 struct MidiHeader readMidiChunk(FILE *f)
 {
-    char cChunkType[5];
+    char cChunkType[5] = "";
     unsigned int uLength = 0;
     unsigned short uFormat = 0, uNumTracks = 0;
     short sTimeDiv = 0;
     struct MidiHeader midiHead;
+    MIDI_PROFILE_START(start);
 
     fread(&cChunkType, sizeof(char[4]), 1, f);
     cChunkType[4] = '\0';
@@ -213,6 +316,10 @@ struct MidiHeader readMidiChunk(FILE *f)
     midiHead.uFormat = swapUInt16(uFormat);
     midiHead.uNumTracks = swapUInt16(uNumTracks);
     midiHead.sTimeDiv = swapUInt16(sTimeDiv);
+    midiHead.trackHeaders = NULL;
+    MIDI_PROFILE_ADD(headerChunks, 1);
+    MIDI_PROFILE_ADD(headerBytes, midiHead.uLength);
+    MIDI_PROFILE_STOP(start, MIDI_PROFILE_HEADER);
 
     return midiHead;
 }
@@ -231,7 +338,7 @@ struct MidiHeader readMidiChunk(FILE *f)
 struct TrackHeader readTrackChunk(FILE *f)
 {
     struct TrackHeader trackHead;
-    char cChunkType[5];
+    char cChunkType[5] = "";
     unsigned int uLength = 0;
 
     fread(&cChunkType, sizeof(char[4]), 1, f);
@@ -240,10 +347,41 @@ struct TrackHeader readTrackChunk(FILE *f)
 
     strcpy(trackHead.cChunkType, cChunkType);
     trackHead.uLength = swapUInt32(uLength);
+    trackHead.events = NULL;
+    MIDI_PROFILE_ADD(trackChunks, 1);
+    MIDI_PROFILE_ADD(trackBytes, trackHead.uLength);
 
     return trackHead;
 }
 
+/** @fn int scanTrackChunks(FILE *f, struct MidiHeader *midiHead)
+ *  @brief Read every track header, seeking over the track events
+ *
+ *  This function reads the header chunk of each track from the given
+ *  file and uses fseek() to jump over the uLength bytes of event data,
+ *  so no events are read or decoded.\n
+ *  Scanning stops at the first chunk that is not a track, its header
+ *  is left in midiHead->trackHeaders at the returned index.
+ *
+ *  @param f: The file to read from, positioned after the MIDI header chunk
+ *  @param midiHead: The MIDI header, trackHeaders must have room for uNumTracks headers
+ *  @return The number of tracks found, less than uNumTracks on a bad or missing track header
+ */
+int scanTrackChunks(FILE *f, struct MidiHeader *midiHead)
+{
+    int i;
+
+    for (i = 0; i < midiHead->uNumTracks; i++)
+    {
+        midiHead->trackHeaders[i] = readTrackChunk(f);
+        if (feof(f) || (strcmp(midiHead->trackHeaders[i].cChunkType, MIDI_TRACK_ID) != 0))
+            break;
+        if (fseek(f, midiHead->trackHeaders[i].uLength, SEEK_CUR) != 0)
+            break;
+    }
+    return i;
+}
+
 void noteOff(FILE *f, unsigned char channel)
 {
     unsigned char cNote, cVelocity;
@@ -286,20 +424,18 @@ void controller(FILE *f, unsigned char channel)
 
 void programChange(FILE *f, unsigned char channel)
 {
-    unsigned char cProgNum, cTemp;
+    unsigned char cProgNum;
 
     fread(&cProgNum, 1, 1, f);
-    fread(&cTemp, 1, 1, f);
     printf("Program Change Event - Channel %d, Program Number %d\n", channel, cProgNum);
     return;
 }
 
 void channelAftertouch(FILE *f, unsigned char channel)
 {
-    unsigned char cATVal, cTemp;
+    unsigned char cATVal;
 
     fread(&cATVal, 1, 1, f);
-    fread(&cTemp, 1, 1, f);
     printf("Channel Aftertouch Event - Channel %d, Aftertouch Value %d\n", channel, cATVal);
     return;
 }
@@ -363,29 +499,22 @@ void readMidiEvent(FILE *f, unsigned char eType, unsigned char channel)
     }
 }
 
-void seqNumEvent(FILE *f, int len)
+void seqNumEvent(FILE *f, unsigned long len)
 {
-    unsigned char buffer[5];
+    unsigned int seqNum = 0;
+    unsigned char c;
+    unsigned long i;
 
-    fread(buffer, sizeof(char[4]), 1, f);
-    buffer[4] = '\0';
-    printf("Type is Sequence Number. Data is %s\n", buffer);
+    for (i = 0; (i < len) && (fread(&c, 1, 1, f) == 1); i++)
+        seqNum = (seqNum << 8) + c;
+    printf("Type is Sequence Number. Data is %u\n", seqNum);
     return;
 }
 
-void textEvent(FILE *f, unsigned short type, int len)
+void textEvent(FILE *f, unsigned short type, unsigned long len)
 {
-    unsigned char *buffer;
+    struct MidiView text = readPayload(f, len, "Text");
 
-    buffer = (unsigned char *)malloc(len + 1);
-    if (buffer == NULL)
-    {
-        perror("Error allocating memory to read Text\n");
-        fclose(f);
-        exit(1);
-    }
-    fread(buffer, len, 1, f);
-    buffer[len] = '\0';
     printf("Type is ");
     switch (type)
     {
@@ -411,8 +540,7 @@ void textEvent(FILE *f, unsigned short type, int len)
         printf("Cue Point. ");
         break;
     }
-    printf("Data is %s\n", buffer);
-    free(buffer);
+    printf("Data is %.*s\n", (int)text.len, (const char *)text.data);
     return;
 }
 
@@ -454,21 +582,11 @@ void tempoEvent(FILE *f)
     return;
 }
 
-void SMPTEOffsetEvent(FILE *f, int len)
+void SMPTEOffsetEvent(FILE *f, unsigned long len)
 {
-    unsigned char *buffer;
+    struct MidiView offset = readPayload(f, len, "SMPTE Offset data");
 
-    buffer = (unsigned char *)malloc(len + 1);
-    if (buffer == NULL)
-    {
-        perror("Error allocating memory to read SMPTE Offset data\n");
-        fclose(f);
-        exit(1);
-    }
-    fread(buffer, len, 1, f);
-    buffer[len] = '\0';
-    printf(" Type is SMPTE Offset. Data is %s\n", buffer);
-    free(buffer);
+    printf(" Type is SMPTE Offset. Data is %.*s\n", (int)offset.len, (const char *)offset.data);
     return;
 }
 
@@ -540,40 +658,23 @@ void keySigEvent(FILE *f)
         j ? printf("B Flat ") : printf("C Sharp ");
         break;
     } // End switch (i)
-    j ? printf("Minor") : printf("Major\n");
+    j ? printf("Minor\n") : printf("Major\n");
 
     return;
 }
 
-void SSMEvent(FILE *f, int len)
+void SSMEvent(FILE *f, unsigned long len)
 {
-    unsigned char *buffer;
+    struct MidiView data = readPayload(f, len, "Sequence Specific data");
 
-    buffer = (unsigned char *)malloc(len + 1);
-    if (buffer == NULL)
-    {
-        perror("Error allocating memory to read Time Signature data\n");
-        fclose(f);
-        exit(1);
-    }
-    fread(buffer, sizeof(char) * len, 1, f);
-    buffer[len] = '\0';
-    printf("Type is Sequence Specific Meta Event. Data is %s\n", buffer);
-
-    free(buffer);
+    printf("Type is Sequence Specific Meta Event. Data is %.*s\n", (int)data.len, (const char *)data.data);
     return;
 }
 
-void unknownEvent(FILE *f, int len)
+void unknownEvent(FILE *f, unsigned long len)
 {
-    int i;
-    unsigned char c;
-
-    printf("Type is unknown, reading %d byte(s)\n", len);
-    for (i = 0; i < len; i++)
-    {
-        fread(&c, 1, 1, f);
-    }
+    printf("Type is unknown, reading %lu byte(s)\n", len);
+    skipPayload(f, len);
     return;
 }
 
@@ -605,8 +706,8 @@ void unknownEvent(FILE *f, int len)
  */
 void readMetaEvent(FILE *f, unsigned short eType)
 {
-    int len = 0;
-    fread(&len, 1, 1, f);
+    unsigned long len = readVarLen(f);
+
     switch (eType)
     {
     case 0x0:
@@ -652,18 +753,169 @@ void readMetaEvent(FILE *f, unsigned short eType)
     return;
 }
 
-/** @fn void readSysExEvent(FILE * f)
+/** @fn int midiSysExKind(unsigned char status, const unsigned char *data, unsigned long length, unsigned char *open)
+ *  @brief Which part of a SysEx message a packet is
+ *
+ * A message sent in one piece is 0xF0, its length and bytes ending in
+ * 0xF7. A divided message starts with an 0xF0 packet without the 0xF7,
+ * then 0xF7 packets carry the rest, the last one ending in 0xF7. An
+ * 0xF7 packet outside a divided message is an escape, bytes sent as
+ * they are.
+ *
+ * @param status: 0xF0 or 0xF7
+ * @param data: The bytes after the length
+ * @param length: Number of bytes
+ * @param open: Non-zero while a divided message is open, updated
+ * @return One of the MIDI_SYSEX_ values
+ */
+int midiSysExKind(unsigned char status, const unsigned char *data, unsigned long length, unsigned char *open)
+{
+    int ends = (length > 0) && (data[length - 1] == 0xF7);
+
+    if (status == 0xF0)
+    {
+        *open = !ends;
+        return ends ? MIDI_SYSEX_COMPLETE : MIDI_SYSEX_FIRST;
+    }
+    if (!*open)
+        return MIDI_SYSEX_ESCAPE;
+    if (!ends)
+        return MIDI_SYSEX_NEXT;
+    *open = 0;
+    return MIDI_SYSEX_LAST;
+}
+
+/** @fn unsigned long midiSysExManufacturer(const unsigned char *data, unsigned long length)
+ *  @brief Manufacturer ID at the start of an 0xF0 packet
+ *
+ * One byte, or 0x00 and two more bytes, returned with
+ * MIDI_MANUFACTURER_EXTENDED set.
+ *
+ * @param data: The bytes after the length
+ * @param length: Number of bytes
+ * @return The manufacturer ID, 0 if there is none
+ */
+unsigned long midiSysExManufacturer(const unsigned char *data, unsigned long length)
+{
+    if ((length == 0) || (data[0] & 0x80))
+        return 0;
+    if (data[0] != 0x00)
+        return data[0];
+    if ((length < 3) || ((data[1] | data[2]) & 0x80))
+        return 0;
+    return MIDI_MANUFACTURER_EXTENDED | (data[1] << 8) | data[2];
+}
+
+/** @fn const char *midiManufacturerName(unsigned long id)
+ *  @brief Name of a manufacturer, see midiSysExManufacturer()
+ *
+ * @return The name, NULL if the ID is not a well known one
+ */
+const char *midiManufacturerName(unsigned long id)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(manufacturerNames) / sizeof(manufacturerNames[0]); i++)
+    {
+        if (manufacturerNames[i].id == id)
+            return manufacturerNames[i].name;
+    }
+    return NULL;
+}
+
+/** @fn void readSysExEvent(FILE *f, unsigned char eType)
  *  @brief Reads a System Exclusive type event
  * 
- *  This function reads a System Exclusive Event from teh given file\n
+ *  This function reads a System Exclusive Event from the given file\n
  *   Valid event types are:
  *  - 0xF0 Normal SysEx Event
- *  - 0xF7 Divided SysEx Event
+ *  - 0xF7 Divided SysEx Event, or SysEx Escape
+ *
+ *  The length is read and the bytes into the payload arena, so the
+ *  rest of the track stays in sync whatever the SysEx holds.
  * 
  *  @param f: The file to read from
- * @return No data is reurned from this function currently
+ *  @param eType: The status byte, 0xF0 or 0xF7
+ *  @return No data is returned from this function currently
+ */
+void readSysExEvent(FILE *f, unsigned char eType)
+{
+    unsigned long len = readVarLen(f), id;
+    struct MidiView data = readPayload(f, len, "SysEx data");
+    int kind = midiSysExKind(eType, data.data, data.len, &sysExOpen);
+    const char *name;
+
+    printf("Type is %s. ", sysExKindNames[kind]);
+    if ((eType == 0xF0) && ((id = midiSysExManufacturer(data.data, data.len)) != 0))
+    {
+        name = midiManufacturerName(id);
+        if (id & MIDI_MANUFACTURER_EXTENDED)
+            printf("Manufacturer is %s%s0x%06lx, ", name ? name : "", name ? " " : "", id & 0xFFFF);
+        else
+            printf("Manufacturer is %s%s0x%02lx, ", name ? name : "", name ? " " : "", id);
+    }
+    printf("%lu byte(s)\n", len);
+}
+
+/** @fn static void sysExHandler(FILE *f, unsigned char type)
+ *  @brief midiStatusTable handler for 0xF0 and 0xF7
  */
-void readSysExEvent(FILE *f) {}
+static void sysExHandler(FILE *f, unsigned char type)
+{
+    readSysExEvent(f, 0xF0 | type);
+}
+
+/** @fn static void systemHandler(FILE *f, unsigned char type)
+ *  @brief midiStatusTable handler for System Common/Real-Time messages
+ *
+ * These are not valid in a MIDI file, skip their data bytes to stay in sync.
+ */
+static void systemHandler(FILE *f, unsigned char type)
+{
+    int i;
+    unsigned char c;
+
+    printf("System message 0x%02x, skipping %d byte(s)\n", 0xF0 | type, midiStatusTable[0xF0 | type].length);
+    for (i = 0; i < midiStatusTable[0xF0 | type].length; i++)
+    {
+        fread(&c, 1, 1, f);
+    }
+}
+
+// Status byte table rows
+#define STATUS_ROW(e) e, e, e, e, e, e, e, e, e, e, e, e, e, e, e, e
+#define STATUS_DATA {MIDI_STATUS_DATA, 0, NULL}
+#define STATUS_CHANNEL(len, fn) {MIDI_STATUS_CHANNEL, len, fn}
+#define STATUS_SYSTEM(len) {MIDI_STATUS_SYSTEM, len, systemHandler}
+
+/// @brief Status byte lookup table, built at compile time
+const struct MidiStatus midiStatusTable[256] = {
+    STATUS_ROW(STATUS_DATA), STATUS_ROW(STATUS_DATA), STATUS_ROW(STATUS_DATA), STATUS_ROW(STATUS_DATA),
+    STATUS_ROW(STATUS_DATA), STATUS_ROW(STATUS_DATA), STATUS_ROW(STATUS_DATA), STATUS_ROW(STATUS_DATA),
+    STATUS_ROW(STATUS_CHANNEL(2, noteOff)),
+    STATUS_ROW(STATUS_CHANNEL(2, noteOn)),
+    STATUS_ROW(STATUS_CHANNEL(2, noteAftertouch)),
+    STATUS_ROW(STATUS_CHANNEL(2, controller)),
+    STATUS_ROW(STATUS_CHANNEL(1, programChange)),
+    STATUS_ROW(STATUS_CHANNEL(1, channelAftertouch)),
+    STATUS_ROW(STATUS_CHANNEL(2, pitchBend)),
+    {MIDI_STATUS_SYSEX, 0, sysExHandler}, // 0xF0 SysEx
+    STATUS_SYSTEM(1),                     // 0xF1 MIDI Time Code Quarter Frame
+    STATUS_SYSTEM(2),                     // 0xF2 Song Position Pointer
+    STATUS_SYSTEM(1),                     // 0xF3 Song Select
+    STATUS_SYSTEM(0),                     // 0xF4 Undefined
+    STATUS_SYSTEM(0),                     // 0xF5 Undefined
+    STATUS_SYSTEM(0),                     // 0xF6 Tune Request
+    {MIDI_STATUS_SYSEX, 0, sysExHandler}, // 0xF7 Divided SysEx
+    STATUS_SYSTEM(0),                     // 0xF8 Timing Clock
+    STATUS_SYSTEM(0),                     // 0xF9 Undefined
+    STATUS_SYSTEM(0),                     // 0xFA Start
+    STATUS_SYSTEM(0),                     // 0xFB Continue
+    STATUS_SYSTEM(0),                     // 0xFC Stop
+    STATUS_SYSTEM(0),                     // 0xFD Undefined
+    STATUS_SYSTEM(0),                     // 0xFE Active Sensing
+    {MIDI_STATUS_META, 0, NULL},          // 0xFF Meta
+};
 
 /** @fn void readTrackEvents(FILE *f)
  *  @brief Reads  events for the current track
@@ -673,6 +925,13 @@ void readSysExEvent(FILE *f) {}
  *  - MIDI Events
  *  - Meta Events
  *  - System Exclusive Events
+ *
+ *  Each status byte is looked up in midiStatusTable, which gives the
+ *  handler to call. A data byte where a status byte is expected means
+ *  running status, the status of the previous MIDI event is reused.
+ *  SysEx events cancel running status, Meta events leave it alone.
+ *  Text and other payloads are read into a bump arena that is reset
+ *  here, so no memory is allocated per event.
  * 
  *  @param f: The file to read from
  *  @return No data is returned from this function currently
@@ -680,43 +939,52 @@ void readSysExEvent(FILE *f) {}
 void readTrackEvents(FILE *f)
 {
     unsigned long deltaTime;
-    unsigned short eventID = 0, eventType = 0;
-    unsigned char cUpperByte, cLowerByte;
+    unsigned char eventID, eventType = 0, runningStatus = 0;
+    const struct MidiStatus *status;
+    MIDI_PROFILE_START(start);
 
     printf("      Begin Processing Track Chunk\n");
+    resetMidiArena(&payloadArena);
+    sysExOpen = 0;
 
-    while (eventType != 0x2f)
+    while ((eventType != 0x2f) && !feof(f))
     {
         deltaTime = readVarLen(f);
-        fread(&eventID, 1, 1, f);
-        cUpperByte = eventID >> 4;
-        cLowerByte = eventID & 0xf;
+        if (fread(&eventID, 1, 1, f) != 1)
+            break;
         printf("         Delta time: 0x%02lx\n", deltaTime);
-        switch (cUpperByte)
+        status = &midiStatusTable[eventID];
+        if (status->kind == MIDI_STATUS_DATA)
         {
-        case 0x8:
-        case 0x9:
-        case 0xA:
-        case 0xB:
-        case 0xC:
-        case 0xD:
-        case 0xE:
-            printf("         MIDI Event detected - ");
-            readMidiEvent(f, cUpperByte, cLowerByte);
-            break;
-        case 0xF:
-            if (cLowerByte == 0xF)
+            if (runningStatus == 0)
             {
-                printf("         Meta Event detected - ");
-                fread(&eventType, 1, 1, f);
-                readMetaEvent(f, eventType);
-            }
-            else
-            {
-                printf("         SysExEvent detected - ");
-                readSysExEvent(f);
+                printf("         Data byte 0x%02x without running status, skipping\n", eventID);
+                MIDI_PROFILE_EVENT(eventID);
+                continue;
             }
+            ungetc(eventID, f);
+            eventID = runningStatus;
+            status = &midiStatusTable[eventID];
+        }
+        MIDI_PROFILE_EVENT(eventID);
+
+        switch (status->kind)
+        {
+        case MIDI_STATUS_CHANNEL:
+            runningStatus = eventID;
+            printf("         MIDI Event detected - ");
+            break;
+        case MIDI_STATUS_META:
+            printf("         Meta Event detected - ");
+            fread(&eventType, 1, 1, f);
+            readMetaEvent(f, eventType);
+            continue;
+        default:
+            runningStatus = 0;
+            printf("         SysExEvent detected - ");
             break;
         } // End Switch
-    }     // End While
-}
\ No newline at end of file
+        status->handler(f, eventID & 0xf);
+    } // End While
+    MIDI_PROFILE_STOP(start, MIDI_PROFILE_DECODE);
+}
@@ -39,6 +39,29 @@
 #define MS_PER_MIN 60000000
 #endif
 
+/// @brief Number of General MIDI instruments, see instrTable
+#ifndef MIDI_INSTRUMENTS
+#define MIDI_INSTRUMENTS 128
+#endif
+
+/// @brief Status byte kinds, see struct MidiStatus
+#define MIDI_STATUS_DATA 0	 ///< 0x00-0x7F, a data byte, running status applies
+#define MIDI_STATUS_CHANNEL 1 ///< 0x80-0xEF, MIDI channel event
+#define MIDI_STATUS_SYSEX 2	 ///< 0xF0 and 0xF7, System Exclusive event
+#define MIDI_STATUS_SYSTEM 3  ///< Other 0xF1-0xFE, System Common/Real-Time message
+#define MIDI_STATUS_META 4	 ///< 0xFF, Meta event
+
+/// @brief SysEx packet kinds, see midiSysExKind()
+#define MIDI_SYSEX_COMPLETE 0 ///< 0xF0 packet ending in 0xF7, a whole message
+#define MIDI_SYSEX_FIRST 1	  ///< 0xF0 packet without 0xF7, more packets follow
+#define MIDI_SYSEX_NEXT 2	  ///< 0xF7 packet continuing a divided message
+#define MIDI_SYSEX_LAST 3	  ///< 0xF7 packet ending a divided message
+#define MIDI_SYSEX_ESCAPE 4	  ///< 0xF7 packet outside a message, bytes sent as they are
+#define MIDI_SYSEX_KINDS 5
+
+/// @brief Set in a manufacturer ID read from three bytes, 0x00 then two more
+#define MIDI_MANUFACTURER_EXTENDED 0x10000
+
 // Data Structures
 /** @struct MidiHeader
  *  @brief MIDI File Header structure
@@ -64,19 +87,51 @@ struct MidiHeader
 	struct TrackHeader *trackHeaders;
 };
 
+// Decoded track events, see MidiStore.h
+struct TrackEvents;
+
 /** @struct TrackHeader
  * @brief Track Header Structure
  *
  * Header ID is 5 bytes, "MTrk" + NULL terminator '\0'.\n
  * the NULL terminator is needed for strcmp() and printf()\n
  * Track chunk size is the total number of bytes in the track\n
+ * Events holds the decoded track events when the track has been
+ * decoded into memory (see MidiStore.h), NULL otherwise.\n
  */
 struct TrackHeader
 {
 	char cChunkType[5];
 	unsigned int uLength;
+
+	struct TrackEvents *events;
 };
 
+/** @struct MidiStatus
+ * @brief What follows a status byte
+ *
+ * Kind is one of the MIDI_STATUS_ values.\n
+ * Length is the number of data bytes following the status byte,
+ * Meta and SysEx events carry their own length instead.\n
+ * Handler reads and prints the event from a file, it is passed the
+ * low nibble of the status byte (the channel for MIDI events).\n
+ */
+struct MidiStatus
+{
+	unsigned char kind;
+	unsigned char length;
+	void (*handler)(FILE *f, unsigned char channel);
+};
+
+/// @brief Status byte lookup table, indexed by the status byte
+extern const struct MidiStatus midiStatusTable[256];
+
+/// @brief General MIDI instrument names, indexed by program number
+extern char *instrTable[MIDI_INSTRUMENTS];
+
+/// @brief SysEx packet kind names, indexed by MIDI_SYSEX_ value
+extern const char *sysExKindNames[MIDI_SYSEX_KINDS];
+
 // Function Prototypes
 int intPow(int base, int exp);
 uint16_t swapUInt16(uint16_t val);
@@ -88,7 +143,9 @@ unsigned long readVarLen(FILE *f);
 
 struct MidiHeader readMidiChunk(FILE *f);
 struct TrackHeader readTrackChunk(FILE *f);
+int scanTrackChunks(FILE *f, struct MidiHeader *midiHead);
 void readTrackEvents(FILE *f);
+void freeMidiPayloads(void);
 
 // MIDI Events
 void readMidiEvent(FILE *f, unsigned char eType, unsigned char channel);
@@ -102,18 +159,21 @@ void pitchBend(FILE *f, unsigned char channel);
 
 // Neta Events
 void readMetaEvent(FILE *f, unsigned short eType);
-void seqNumEvent(FILE *f, int len);
-void textEvent(FILE *f, unsigned short type, int len);
+void seqNumEvent(FILE *f, unsigned long len);
+void textEvent(FILE *f, unsigned short type, unsigned long len);
 void channelPrefixEvent(FILE *f);
 void portPrefixEvent(FILE *f);
 void tempoEvent(FILE *f);
-void SMPTEOffsetEvent(FILE *f, int len);
+void SMPTEOffsetEvent(FILE *f, unsigned long len);
 void timeSigEvent(FILE *f);
 void keySigEvent(FILE *f);
-void SSMEvent(FILE *f, int len);
-void unknownEvent(FILE *f, int len);
+void SSMEvent(FILE *f, unsigned long len);
+void unknownEvent(FILE *f, unsigned long len);
 
 // System Events
-void readSysExEvent(FILE *f);
+void readSysExEvent(FILE *f, unsigned char eType);
+int midiSysExKind(unsigned char status, const unsigned char *data, unsigned long length, unsigned char *open);
+unsigned long midiSysExManufacturer(const unsigned char *data, unsigned long length);
+const char *midiManufacturerName(unsigned long id);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,141 @@
+/** @file MidiMerge.c
+ *  @brief One time ordered stream of events from all tracks
+ *
+ *  This contains the functions that set up a k-way merge over the
+ *  tracks of a file, take events from it in tick order and release it.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#ifndef MIDIMERGE_H_
+#include "MidiMerge.h"
+#endif
+
+/** @fn static int mergeBefore(const struct MidiMerge *m, int a, int b)
+ *  @brief Heap order, by tick of the pending event and then by track index
+ */
+static int mergeBefore(const struct MidiMerge *m, int a, int b)
+{
+    if (m->tracks[a].tick != m->tracks[b].tick)
+        return m->tracks[a].tick < m->tracks[b].tick;
+    return a < b;
+}
+
+/** @fn static void siftDown(struct MidiMerge *m, int i)
+ *  @brief Move heap entry i down until both children come after it
+ */
+static void siftDown(struct MidiMerge *m, int i)
+{
+    int child, tmp;
+
+    while ((child = 2 * i + 1) < m->heapSize)
+    {
+        if ((child + 1 < m->heapSize) && mergeBefore(m, m->heap[child + 1], m->heap[child]))
+            child++;
+        if (!mergeBefore(m, m->heap[child], m->heap[i]))
+            break;
+        tmp = m->heap[i];
+        m->heap[i] = m->heap[child];
+        m->heap[child] = tmp;
+        i = child;
+    }
+}
+
+/** @fn static int advanceTrack(struct MergeTrack *t)
+ *  @brief Read the next event of a track into its pending slot
+ *
+ * A track is finished after its End of Track event or at the end of its data.
+ *
+ * @return 1 if the track has a pending event, 0 if it is finished
+ */
+static int advanceTrack(struct MergeTrack *t)
+{
+    if ((t->ev.status == 0xFF) && (t->ev.data1 == 0x2f))
+        return 0;
+    if (!cursorReadEvent(&t->c, &t->ev))
+        return 0;
+    t->tick += t->ev.deltaTime;
+    return 1;
+}
+
+/** @fn int openMidiMerge(struct MidiMerge *m, const struct MidiCursor *tracks, int numTracks)
+ *  @brief Start merging the tracks of a file
+ *
+ * The first event of every track is decoded and the heap is built.
+ *
+ * @param m: The merge state to set up, release with closeMidiMerge()
+ * @param tracks: A cursor per track (see cursorIndexTracks()), copied, not moved
+ * @param numTracks: Number of tracks
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+int openMidiMerge(struct MidiMerge *m, const struct MidiCursor *tracks, int numTracks)
+{
+    int i;
+
+    m->heapSize = 0;
+    m->tracks = (struct MergeTrack *)calloc(numTracks ? numTracks : 1, sizeof(struct MergeTrack));
+    m->heap = (int *)malloc((numTracks ? numTracks : 1) * sizeof(int));
+    if ((m->tracks == NULL) || (m->heap == NULL))
+    {
+        closeMidiMerge(m);
+        return -1;
+    }
+
+    for (i = 0; i < numTracks; i++)
+    {
+        m->tracks[i].c = tracks[i];
+        if (advanceTrack(&m->tracks[i]))
+            m->heap[m->heapSize++] = i;
+    }
+    for (i = m->heapSize / 2 - 1; i >= 0; i--)
+        siftDown(m, i);
+    return 0;
+}
+
+/** @fn int midiMergeNext(struct MidiMerge *m, struct MidiEvent *ev, int *track, unsigned long *tick)
+ *  @brief Take the next event in global tick order
+ *
+ * Events at the same tick come out in track order, events of one track
+ * in file order. The End of Track event of every track is included.\n
+ * The delta time of the event is still relative to the previous event
+ * of its own track, use tick for the position in the merged stream.
+ *
+ * @param m: The merge state
+ * @param ev: Receives the event, its payload points into the file buffer
+ * @param track: Receives the index of the track the event belongs to
+ * @param tick: Receives the absolute tick of the event
+ * @return 1 if an event was returned, 0 once every track is finished
+ */
+int midiMergeNext(struct MidiMerge *m, struct MidiEvent *ev, int *track, unsigned long *tick)
+{
+    struct MergeTrack *t;
+    int i;
+
+    if (m->heapSize == 0)
+        return 0;
+    i = m->heap[0];
+    t = &m->tracks[i];
+    *ev = t->ev;
+    *track = i;
+    *tick = t->tick;
+
+    // Refill the root from the same track, or drop the track once it is finished
+    if (!advanceTrack(t))
+        m->heap[0] = m->heap[--m->heapSize];
+    siftDown(m, 0);
+    return 1;
+}
+
+/** @fn void closeMidiMerge(struct MidiMerge *m)
+ *  @brief Release the merge state filled by openMidiMerge()
+ */
+void closeMidiMerge(struct MidiMerge *m)
+{
+    free(m->tracks);
+    free(m->heap);
+    m->tracks = NULL;
+    m->heap = NULL;
+    m->heapSize = 0;
+}
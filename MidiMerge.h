@@ -0,0 +1,56 @@
+/** @file MidiMerge.h
+ *  @brief One time ordered stream of events from all tracks
+ *
+ *  This contains the data structures and functions needed to read the
+ *  events of every track of a file merged into global tick order, as
+ *  a player or a format 0 conversion would see them.
+ *
+ *  Each track keeps its own cursor and one pending event, a binary
+ *  min-heap on absolute tick picks the next event. Events are decoded
+ *  as they are taken, so memory use depends on the number of tracks
+ *  and not on the number of events.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#ifndef MIDIBUFFER_H_
+#include "MidiBuffer.h"
+#endif
+
+#ifndef MIDIMERGE_H_
+#define MIDIMERGE_H_
+
+// Data Structures
+/** @struct MergeTrack
+ *  @brief A track taking part in a merge and its next event
+ */
+struct MergeTrack
+{
+	struct MidiCursor c;
+	struct MidiEvent ev;
+	unsigned long tick;
+};
+
+/** @struct MidiMerge
+ *  @brief State of a k-way merge over the tracks of a file
+ *
+ * Heap holds the indices of the tracks that still have an event,
+ * ordered by the tick of that event and then by track index, so events
+ * at the same tick come out in track order.\n
+ */
+struct MidiMerge
+{
+	struct MergeTrack *tracks;
+	int *heap;
+	int heapSize;
+};
+
+// Function Prototypes
+int openMidiMerge(struct MidiMerge *m, const struct MidiCursor *tracks, int numTracks);
+int midiMergeNext(struct MidiMerge *m, struct MidiEvent *ev, int *track, unsigned long *tick);
+void closeMidiMerge(struct MidiMerge *m);
+
+#endif
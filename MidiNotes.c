@@ -0,0 +1,167 @@
+/** @file MidiNotes.c
+ *  @brief Pairs note-on and note-off events into notes with durations
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#ifndef MIDINOTES_H_
+#include "MidiNotes.h"
+#endif
+
+/** @fn void initNoteList(struct NoteList *list)
+ *  @brief Set up an empty note list
+ */
+void initNoteList(struct NoteList *list)
+{
+    list->notes = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+/** @fn void freeNoteList(struct NoteList *list)
+ *  @brief Release the notes of a list
+ */
+void freeNoteList(struct NoteList *list)
+{
+    free(list->notes);
+    initNoteList(list);
+}
+
+/** @fn void initNotePairer(struct NotePairer *p, struct NoteList *list)
+ *  @brief Start pairing the notes of a track
+ *
+ * @param p: The pairer, nothing is allocated
+ * @param list: Receives the notes, appended after any notes already in it
+ */
+void initNotePairer(struct NotePairer *p, struct NoteList *list)
+{
+    p->list = list;
+    memset(p->head, 0xff, sizeof(p->head));
+    memset(p->tail, 0xff, sizeof(p->tail));
+    p->openNotes = 0;
+    p->orphans = 0;
+}
+
+/** @fn static int noteOnEvent(struct NotePairer *p, unsigned long tick, unsigned char channel, unsigned char key, unsigned char velocity)
+ *  @brief Start a note and add it to the end of its slot
+ *
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+static int noteOnEvent(struct NotePairer *p, unsigned long tick, unsigned char channel, unsigned char key, unsigned char velocity)
+{
+    struct NoteList *list = p->list;
+    struct MidiNote *note;
+    size_t capacity;
+    uint32_t i;
+    void *n;
+
+    if (list->count == list->capacity)
+    {
+        capacity = list->capacity ? list->capacity * 2 : 1024;
+        if ((capacity > MIDI_NOTE_NONE) || ((n = realloc(list->notes, capacity * sizeof(struct MidiNote))) == NULL))
+            return -1;
+        list->notes = (struct MidiNote *)n;
+        list->capacity = capacity;
+    }
+    i = list->count++;
+    note = &list->notes[i];
+    note->start = tick;
+    note->duration = MIDI_NOTE_NONE;
+    note->channel = channel;
+    note->key = key;
+    note->velocity = velocity;
+    note->open = 0;
+
+    if (p->head[channel][key] == MIDI_NOTE_NONE)
+        p->head[channel][key] = i;
+    else
+        list->notes[p->tail[channel][key]].duration = i;
+    p->tail[channel][key] = i;
+    p->openNotes++;
+    return 0;
+}
+
+/** @fn static void noteOffEvent(struct NotePairer *p, unsigned long tick, unsigned char channel, unsigned char key)
+ *  @brief End the oldest note open on a channel and key
+ */
+static void noteOffEvent(struct NotePairer *p, unsigned long tick, unsigned char channel, unsigned char key)
+{
+    struct MidiNote *note;
+    uint32_t i = p->head[channel][key];
+
+    if (i == MIDI_NOTE_NONE)
+    {
+        p->orphans++;
+        return;
+    }
+    note = &p->list->notes[i];
+    p->head[channel][key] = note->duration;
+    note->duration = tick - note->start;
+    p->openNotes--;
+}
+
+/** @fn int pairNoteEvent(struct NotePairer *p, unsigned long tick, const struct MidiEvent *ev)
+ *  @brief Pass an event of the track to the pairer
+ *
+ * Events other than note-on and note-off are ignored.
+ *
+ * @param p: The pairer
+ * @param tick: Absolute tick of the event
+ * @param ev: The event
+ * @return 0 on success, -1 if memory for the note list could not be allocated
+ */
+int pairNoteEvent(struct NotePairer *p, unsigned long tick, const struct MidiEvent *ev)
+{
+    unsigned char channel = ev->status & 0x0f;
+
+    switch (ev->status & 0xf0)
+    {
+    case 0x90:
+        if (ev->data2 != 0)
+            return noteOnEvent(p, tick, channel, ev->data1 & 0x7f, ev->data2);
+        // Velocity 0 is a note-off
+        noteOffEvent(p, tick, channel, ev->data1 & 0x7f);
+        break;
+    case 0x80:
+        noteOffEvent(p, tick, channel, ev->data1 & 0x7f);
+        break;
+    }
+    return 0;
+}
+
+/** @fn size_t endNotePairer(struct NotePairer *p, unsigned long tick)
+ *  @brief End the track, flagging the notes still open
+ *
+ * Open notes get the duration to the end of the track. The pairer is
+ * then empty and can go on with the next track.
+ *
+ * @param p: The pairer
+ * @param tick: Absolute tick of the end of the track
+ * @return The number of notes that were still open
+ */
+size_t endNotePairer(struct NotePairer *p, unsigned long tick)
+{
+    struct MidiNote *note;
+    size_t open = p->openNotes;
+    uint32_t i, next;
+    int channel, key;
+
+    for (channel = 0; (channel < 16) && (p->openNotes > 0); channel++)
+    {
+        for (key = 0; key < 128; key++)
+        {
+            for (i = p->head[channel][key]; i != MIDI_NOTE_NONE; i = next)
+            {
+                note = &p->list->notes[i];
+                next = note->duration;
+                note->duration = tick - note->start;
+                note->open = 1;
+                p->openNotes--;
+            }
+            p->head[channel][key] = MIDI_NOTE_NONE;
+        }
+    }
+    return open;
+}
@@ -0,0 +1,77 @@
+/** @file MidiNotes.h
+ *  @brief Pairs note-on and note-off events into notes with durations
+ *
+ *  This contains the data structures and functions needed to turn the
+ *  events of a track into a list of notes (start, duration, channel,
+ *  key, velocity) in one pass.
+ *
+ *  Each (channel, key) pair has a FIFO slot of the notes sounding on
+ *  it, so overlapping notes of the same key are ended first in, first
+ *  out. A note-on with velocity 0 is a note-off. The slots are a fixed
+ *  16 x 128 table and the FIFOs are linked through the open notes
+ *  themselves, so each event costs O(1) and no memory is used beyond
+ *  the note list.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#ifndef MIDIBUFFER_H_
+#include "MidiBuffer.h"
+#endif
+
+#ifndef MIDINOTES_H_
+#define MIDINOTES_H_
+
+/// @brief Index of no note, an empty slot or the end of a FIFO
+#define MIDI_NOTE_NONE UINT32_MAX
+
+// Data Structures
+/** @struct MidiNote
+ *  @brief A note, start and duration are in ticks
+ *
+ * Open is set for a note still sounding at the end of its track, its
+ * duration then runs to the end of the track.\n
+ * While a note is being paired its duration holds the index of the
+ * next note open on the same channel and key.\n
+ */
+struct MidiNote
+{
+	unsigned long start, duration;
+	unsigned char channel, key, velocity, open;
+};
+
+/** @struct NoteList
+ *  @brief Notes in order of their note-on events
+ */
+struct NoteList
+{
+	struct MidiNote *notes;
+	size_t count, capacity;
+};
+
+/** @struct NotePairer
+ *  @brief Open notes of every channel and key
+ *
+ * Head and tail index the oldest and newest open note of each slot in
+ * the note list, MIDI_NOTE_NONE when nothing is sounding.\n
+ * Orphans counts note-offs with no note open on their channel and key.\n
+ */
+struct NotePairer
+{
+	struct NoteList *list;
+	uint32_t head[16][128], tail[16][128];
+	size_t openNotes;
+	unsigned long orphans;
+};
+
+// Function Prototypes
+void initNoteList(struct NoteList *list);
+void freeNoteList(struct NoteList *list);
+void initNotePairer(struct NotePairer *p, struct NoteList *list);
+int pairNoteEvent(struct NotePairer *p, unsigned long tick, const struct MidiEvent *ev);
+size_t endNotePairer(struct NotePairer *p, unsigned long tick);
+
+#endif
@@ -0,0 +1,175 @@
+/** @file MidiOutput.c
+ *  @brief Buffered, printf-free text output
+ *
+ *  This contains the functions that set up, flush and release a
+ *  struct MidiOutput, and the slower append functions that may need
+ *  to flush part way through.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#ifndef MIDIOUTPUT_H_
+#include "MidiOutput.h"
+#endif
+
+#ifndef MIDIPROFILE_H_
+#include "MidiProfile.h"
+#endif
+
+/** @fn int openMidiOutput(struct MidiOutput *o, FILE *f)
+ *  @brief Set up an output buffer in front of a stream
+ *
+ * @param o: The output buffer to set up
+ * @param f: The stream the text is written to
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+int openMidiOutput(struct MidiOutput *o, FILE *f)
+{
+    o->f = f;
+    o->len = 0;
+    o->error = 0;
+    o->cap = MIDI_OUTPUT_BUFFER;
+    o->buf = (char *)malloc(o->cap);
+    if (o->buf == NULL)
+    {
+        o->cap = 0;
+        return -1;
+    }
+    return 0;
+}
+
+/** @fn int flushMidiOutput(struct MidiOutput *o)
+ *  @brief Write the buffered text to the stream
+ *
+ * @param o: The output buffer
+ * @return 0 on success, -1 if the stream reported a write error
+ */
+int flushMidiOutput(struct MidiOutput *o)
+{
+    MIDI_PROFILE_START(start);
+
+    if ((o->len > 0) && (fwrite(o->buf, 1, o->len, o->f) != o->len))
+        o->error = 1;
+    o->len = 0;
+    MIDI_PROFILE_STOP(start, MIDI_PROFILE_FLUSH);
+    return o->error ? -1 : 0;
+}
+
+/** @fn int closeMidiOutput(struct MidiOutput *o)
+ *  @brief Flush and release an output buffer, the stream is left open
+ *
+ * @param o: The output buffer
+ * @return 0 on success, -1 if a write error occurred at any point
+ */
+int closeMidiOutput(struct MidiOutput *o)
+{
+    flushMidiOutput(o);
+    fflush(o->f);
+    free(o->buf);
+    o->buf = NULL;
+    o->cap = 0;
+    return o->error ? -1 : 0;
+}
+
+/** @fn void outBytes(struct MidiOutput *o, const char *s, size_t n)
+ *  @brief Append any number of characters
+ *
+ * Blocks larger than the buffer are written straight to the stream.
+ *
+ * @param o: The output buffer
+ * @param s: The characters to append
+ * @param n: Number of characters
+ */
+void outBytes(struct MidiOutput *o, const char *s, size_t n)
+{
+    if (o->cap - o->len < n + MIDI_OUTPUT_LINE)
+    {
+        flushMidiOutput(o);
+        if (n + MIDI_OUTPUT_LINE > o->cap)
+        {
+            MIDI_PROFILE_START(start);
+            if (fwrite(s, 1, n, o->f) != n)
+                o->error = 1;
+            MIDI_PROFILE_STOP(start, MIDI_PROFILE_FLUSH);
+            return;
+        }
+    }
+    memcpy(o->buf + o->len, s, n);
+    o->len += n;
+}
+
+/** @fn void outFormat(struct MidiOutput *o, const char *fmt, ...)
+ *  @brief Append printf formatted text
+ *
+ * For the occasional header or summary line, event lines use the
+ * inline append functions instead.
+ *
+ * @param o: The output buffer
+ * @param fmt: printf format string
+ */
+void outFormat(struct MidiOutput *o, const char *fmt, ...)
+{
+    va_list args;
+    char *tmp;
+    int n;
+
+    va_start(args, fmt);
+    n = vsnprintf(o->buf + o->len, o->cap - o->len, fmt, args);
+    va_end(args);
+    if (n < 0)
+        return;
+    if ((size_t)n < o->cap - o->len)
+    {
+        o->len += n;
+        outReserve(o);
+        return;
+    }
+
+    // Did not fit, format into a block of its own
+    tmp = (char *)malloc(n + 1);
+    if (tmp == NULL)
+    {
+        o->error = 1;
+        return;
+    }
+    va_start(args, fmt);
+    vsnprintf(tmp, n + 1, fmt, args);
+    va_end(args);
+    outBytes(o, tmp, n);
+    outReserve(o);
+    free(tmp);
+}
+
+/** @fn void outJsonString(struct MidiOutput *o, const char *s)
+ *  @brief Append a quoted JSON string, escaping quotes, backslashes and control characters
+ *
+ * @param o: The output buffer
+ * @param s: NUL terminated string
+ */
+void outJsonString(struct MidiOutput *o, const char *s)
+{
+    const unsigned char *p;
+
+    outReserve(o);
+    outChar(o, '"');
+    for (p = (const unsigned char *)s; *p != '\0'; p++)
+    {
+        outReserve(o);
+        if ((*p == '"') || (*p == '\\'))
+        {
+            outChar(o, '\\');
+            outChar(o, *p);
+        }
+        else if (*p < 0x20)
+        {
+            OUT_LIT(o, "\\u00");
+            outHex(o, *p, 2);
+        }
+        else
+            outChar(o, *p);
+    }
+    outReserve(o);
+    outChar(o, '"');
+}
@@ -0,0 +1,151 @@
+/** @file MidiOutput.h
+ *  @brief Buffered, printf-free text output
+ *
+ *  This contains the data structure and functions used to build text
+ *  output in a large memory buffer with hand-rolled integer and hex
+ *  formatting. The buffer is written to the underlying stream with
+ *  fwrite() in large blocks.
+ *
+ *  The small append functions are inline so the formatting of an
+ *  event line compiles down to a few stores.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#include <stdarg.h>
+
+#ifndef MIDIINFO_H_
+#include "MidiInfo.h"
+#endif
+
+#ifndef MIDIOUTPUT_H_
+#define MIDIOUTPUT_H_
+
+/// @brief Default size of the output buffer
+#ifndef MIDI_OUTPUT_BUFFER
+#define MIDI_OUTPUT_BUFFER 262144
+#endif
+
+/// @brief Space that is always free after outReserve(), enough for any fixed format event line
+#ifndef MIDI_OUTPUT_LINE
+#define MIDI_OUTPUT_LINE 256
+#endif
+
+// Data Structures
+/** @struct MidiOutput
+ *  @brief A text output buffer in front of a stream
+ *
+ * Text is appended at buf + len and written to f by flushMidiOutput(),
+ * which is called automatically when the buffer runs short.\n
+ */
+struct MidiOutput
+{
+	FILE *f;
+	char *buf;
+	size_t len, cap;
+	int error;
+};
+
+// Function Prototypes
+int openMidiOutput(struct MidiOutput *o, FILE *f);
+int flushMidiOutput(struct MidiOutput *o);
+int closeMidiOutput(struct MidiOutput *o);
+void outBytes(struct MidiOutput *o, const char *s, size_t n);
+void outFormat(struct MidiOutput *o, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void outJsonString(struct MidiOutput *o, const char *s);
+
+/** @fn static inline void outReserve(struct MidiOutput *o)
+ *  @brief Make sure there is room for one fixed format line
+ */
+static inline void outReserve(struct MidiOutput *o)
+{
+	if (o->cap - o->len < MIDI_OUTPUT_LINE)
+		flushMidiOutput(o);
+}
+
+/** @fn static inline void outStr(struct MidiOutput *o, const char *s, size_t n)
+ *  @brief Append n characters, after outReserve() for short constant strings
+ */
+static inline void outStr(struct MidiOutput *o, const char *s, size_t n)
+{
+	memcpy(o->buf + o->len, s, n);
+	o->len += n;
+}
+
+/// @brief Append a string literal, its length is known at compile time
+#define OUT_LIT(o, s) outStr((o), (s), sizeof(s) - 1)
+
+/** @fn static inline void outChar(struct MidiOutput *o, char ch)
+ *  @brief Append a single character
+ */
+static inline void outChar(struct MidiOutput *o, char ch)
+{
+	o->buf[o->len++] = ch;
+}
+
+/** @fn static inline void outUInt(struct MidiOutput *o, unsigned long val)
+ *  @brief Append an unsigned decimal number, same as printf("%lu")
+ */
+static inline void outUInt(struct MidiOutput *o, unsigned long val)
+{
+	char tmp[20];
+	int n = 0;
+
+	if (val < 10)
+	{
+		o->buf[o->len++] = '0' + val;
+		return;
+	}
+	if (val < 100)
+	{
+		o->buf[o->len++] = '0' + val / 10;
+		o->buf[o->len++] = '0' + val % 10;
+		return;
+	}
+	do
+	{
+		tmp[n++] = '0' + val % 10;
+		val /= 10;
+	} while (val);
+	while (n)
+		o->buf[o->len++] = tmp[--n];
+}
+
+/** @fn static inline void outInt(struct MidiOutput *o, long val)
+ *  @brief Append a signed decimal number, same as printf("%ld")
+ */
+static inline void outInt(struct MidiOutput *o, long val)
+{
+	if (val < 0)
+	{
+		o->buf[o->len++] = '-';
+		outUInt(o, -(unsigned long)val);
+		return;
+	}
+	outUInt(o, val);
+}
+
+/** @fn static inline void outHex(struct MidiOutput *o, unsigned long val, int width)
+ *  @brief Append lower case hex digits, zero padded to width, same as printf("%0*lx")
+ */
+static inline void outHex(struct MidiOutput *o, unsigned long val, int width)
+{
+	static const char digits[] = "0123456789abcdef";
+	char tmp[16];
+	int n = 0;
+
+	do
+	{
+		tmp[n++] = digits[val & 0xf];
+		val >>= 4;
+	} while (val);
+	while (n < width)
+		tmp[n++] = '0';
+	while (n)
+		o->buf[o->len++] = tmp[--n];
+}
+
+#endif
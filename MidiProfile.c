@@ -0,0 +1,186 @@
+/** @file MidiProfile.c
+ *  @brief Optional profiling counters and phase timers
+ *
+ *  Everything here is compiled only with MIDI_PROFILE defined.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#ifndef MIDIPROFILE_H_
+#include "MidiProfile.h"
+#endif
+
+#ifdef MIDI_PROFILE
+
+#include <pthread.h>
+
+/** @struct SlowFile
+ *  @brief One of the slowest files of the run
+ */
+struct SlowFile
+{
+    char *path;
+    uint64_t nanos;
+    unsigned long long bytes;
+};
+
+__thread struct MidiProfile midiProfile;
+
+// Process totals, guarded by profileLock
+static pthread_mutex_t profileLock = PTHREAD_MUTEX_INITIALIZER;
+static struct MidiProfile profileTotal;
+static unsigned long profileFiles, profileFailed;
+static unsigned long long profileBytes;
+static uint64_t profileNanos;
+static struct SlowFile slowest[MIDI_PROFILE_SLOWEST];
+static int numSlowest;
+
+// Event type and phase names, text report and JSON keys
+static const char *typeNames[MIDI_PROFILE_TYPES] = {
+    "Note Off", "Note On", "Note Aftertouch", "Controller", "Program Change", "Channel Aftertouch", "Pitch Bend",
+    "Meta", "SysEx", "System", "Stray data"};
+static const char *typeKeys[MIDI_PROFILE_TYPES] = {
+    "note_off", "note_on", "note_aftertouch", "controller", "program_change", "channel_aftertouch", "pitch_bend",
+    "meta", "sysex", "system", "data"};
+static const char *phaseKeys[MIDI_PROFILE_PHASES] = {"load", "header", "decode", "flush"};
+
+/** @fn void flushMidiProfile(void)
+ *  @brief Add the counters of the calling thread to the process totals and clear them
+ */
+void flushMidiProfile(void)
+{
+    int i;
+
+    pthread_mutex_lock(&profileLock);
+    for (i = 0; i < MIDI_PROFILE_TYPES; i++)
+        profileTotal.events[i] += midiProfile.events[i];
+    profileTotal.headerChunks += midiProfile.headerChunks;
+    profileTotal.headerBytes += midiProfile.headerBytes;
+    profileTotal.trackChunks += midiProfile.trackChunks;
+    profileTotal.trackBytes += midiProfile.trackBytes;
+    profileTotal.bytes += midiProfile.bytes;
+    for (i = 0; i < MIDI_PROFILE_PHASES; i++)
+        profileTotal.phaseNanos[i] += midiProfile.phaseNanos[i];
+    pthread_mutex_unlock(&profileLock);
+    memset(&midiProfile, 0, sizeof(struct MidiProfile));
+}
+
+/** @fn void addMidiProfileFile(const char *filename, uint64_t nanos, unsigned long long bytes, int status)
+ *  @brief Count a finished file and keep it if it is one of the slowest
+ *
+ * Safe to call from several threads.
+ *
+ * @param filename: The file
+ * @param nanos: Time spent on the file
+ * @param bytes: Size of the file
+ * @param status: Return value of the job, non-zero if it failed
+ */
+void addMidiProfileFile(const char *filename, uint64_t nanos, unsigned long long bytes, int status)
+{
+    char *path;
+    int i;
+
+    pthread_mutex_lock(&profileLock);
+    profileFiles++;
+    if (status != 0)
+        profileFailed++;
+    profileBytes += bytes;
+    profileNanos += nanos;
+    if (((numSlowest < MIDI_PROFILE_SLOWEST) || (nanos > slowest[numSlowest - 1].nanos)) &&
+        ((path = strdup(filename)) != NULL))
+    {
+        if (numSlowest == MIDI_PROFILE_SLOWEST)
+            free(slowest[numSlowest - 1].path);
+        else
+            numSlowest++;
+        // Insertion into the list, slowest first
+        for (i = numSlowest - 1; (i > 0) && (slowest[i - 1].nanos < nanos); i--)
+            slowest[i] = slowest[i - 1];
+        slowest[i].path = path;
+        slowest[i].nanos = nanos;
+        slowest[i].bytes = bytes;
+    }
+    pthread_mutex_unlock(&profileLock);
+}
+
+/** @fn void writeMidiProfile(struct MidiOutput *o, int json, uint64_t wallNanos)
+ *  @brief Print the totals of the run as text or as one JSON object
+ *
+ * Throughput is over the wall clock time of the run. Phase times are
+ * summed over all threads. Decode is timed per track loop, not per
+ * event, so it holds what a job does with each event as well; other is
+ * the time of the files not spent in any timed phase.
+ *
+ * @param o: The output buffer to print to
+ * @param json: Non-zero for JSON
+ * @param wallNanos: Wall clock time of the whole run
+ */
+void writeMidiProfile(struct MidiOutput *o, int json, uint64_t wallNanos)
+{
+    const struct MidiProfile *p = &profileTotal;
+    unsigned long long events = 0;
+    uint64_t phases = 0, other;
+    double wall = wallNanos / 1e9;
+    int i;
+
+    flushMidiProfile();
+    for (i = 0; i < MIDI_PROFILE_TYPES; i++)
+        events += p->events[i];
+    for (i = 0; i < MIDI_PROFILE_PHASES; i++)
+        phases += p->phaseNanos[i];
+    other = (profileNanos > phases) ? profileNanos - phases : 0;
+    if (wall <= 0)
+        wall = 1e-9;
+
+    if (json)
+    {
+        outFormat(o, "{\"files\":%lu,\"failed\":%lu,\"bytes\":%llu,\"seconds\":%.6f,\"mb_per_sec\":%.2f,"
+                     "\"events_per_sec\":%.0f,\"phases\":{",
+                  profileFiles, profileFailed, profileBytes, wall, profileBytes / wall / (1024.0 * 1024.0),
+                  events / wall);
+        for (i = 0; i < MIDI_PROFILE_PHASES; i++)
+            outFormat(o, "\"%s\":%.6f,", phaseKeys[i], p->phaseNanos[i] / 1e9);
+        outFormat(o, "\"other\":%.6f},\"chunks\":{\"header\":%llu,\"header_bytes\":%llu,\"track\":%llu,"
+                     "\"track_bytes\":%llu},\"events\":{\"total\":%llu",
+                  other / 1e9, p->headerChunks, p->headerBytes, p->trackChunks, p->trackBytes, events);
+        for (i = 0; i < MIDI_PROFILE_TYPES; i++)
+            outFormat(o, ",\"%s\":%llu", typeKeys[i], p->events[i]);
+        outFormat(o, "},\"slowest\":[");
+        for (i = 0; i < numSlowest; i++)
+        {
+            outFormat(o, "%s{\"file\":", (i > 0) ? "," : "");
+            outJsonString(o, slowest[i].path);
+            outFormat(o, ",\"seconds\":%.6f,\"bytes\":%llu}", slowest[i].nanos / 1e9, slowest[i].bytes);
+        }
+        outFormat(o, "]}\n");
+    }
+    else
+    {
+        outFormat(o, "Profile: %lu files, %lu failed, %llu bytes in %.3f s, %.2f MB/s, %.0f events/s\n",
+                  profileFiles, profileFailed, profileBytes, wall, profileBytes / wall / (1024.0 * 1024.0),
+                  events / wall);
+        outFormat(o, "Phases (s, all threads):");
+        for (i = 0; i < MIDI_PROFILE_PHASES; i++)
+            outFormat(o, " %s %.3f,", phaseKeys[i], p->phaseNanos[i] / 1e9);
+        outFormat(o, " other %.3f\n", other / 1e9);
+        outFormat(o, "Chunks: %llu header (%llu bytes), %llu track (%llu bytes, %.0f per track)\n",
+                  p->headerChunks, p->headerBytes, p->trackChunks, p->trackBytes,
+                  p->trackChunks ? (double)p->trackBytes / p->trackChunks : 0.0);
+        outFormat(o, "Events: %llu total", events);
+        for (i = 0; i < MIDI_PROFILE_TYPES; i++)
+            outFormat(o, ", %s %llu", typeNames[i], p->events[i]);
+        outFormat(o, "\n");
+        if (numSlowest > 0)
+            outFormat(o, "Slowest files:\n");
+        for (i = 0; i < numSlowest; i++)
+            outFormat(o, "   %.6f s  %llu bytes  %s\n", slowest[i].nanos / 1e9, slowest[i].bytes, slowest[i].path);
+    }
+
+    for (i = 0; i < numSlowest; i++)
+        free(slowest[i].path);
+    numSlowest = 0;
+}
+
+#endif
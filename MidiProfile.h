@@ -0,0 +1,133 @@
+/** @file MidiProfile.h
+ *  @brief Optional profiling counters and phase timers
+ *
+ *  This contains the counters and timers built in when the program is
+ *  compiled with MIDI_PROFILE defined (make PROFILE=1): events decoded
+ *  per type, header and track chunks and their bytes, and the time
+ *  spent loading files, reading headers, decoding tracks and flushing
+ *  output, measured with clock_gettime(CLOCK_MONOTONIC). A phase timed
+ *  within another, output flushed while a track is decoded, counts for
+ *  the inner one only, so the phases add up to the time measured.
+ *
+ *  Counting goes to a thread-local struct MidiProfile, so decoding
+ *  threads never share a cache line. flushMidiProfile() adds it to the
+ *  process totals, at the end of each file and of each worker thread.
+ *
+ *  Without MIDI_PROFILE the MIDI_PROFILE_* macros expand to nothing and
+ *  none of the functions exist, the decoder is the same code as before.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#include <time.h>
+
+#ifndef MIDIOUTPUT_H_
+#include "MidiOutput.h"
+#endif
+
+#ifndef MIDIPROFILE_H_
+#define MIDIPROFILE_H_
+
+/// @brief Phases timed, indexes of phaseNanos
+#define MIDI_PROFILE_LOAD 0	  ///< Mapping or reading the file
+#define MIDI_PROFILE_HEADER 1 ///< Reading the header chunk
+#define MIDI_PROFILE_DECODE 2 ///< Track event loops, with the per-event work of the job
+#define MIDI_PROFILE_FLUSH 3  ///< Writing buffered output to its stream
+#define MIDI_PROFILE_PHASES 4
+
+/// @brief Event types counted: 0-6 MIDI events 0x8n-0xEn, then Meta, SysEx, System and stray data bytes
+#define MIDI_PROFILE_TYPES 11
+
+/// @brief Number of slowest files kept for the report
+#ifndef MIDI_PROFILE_SLOWEST
+#define MIDI_PROFILE_SLOWEST 5
+#endif
+
+#ifdef MIDI_PROFILE
+
+// Data Structures
+/** @struct MidiProfile
+ *  @brief Counters and phase times of one thread, or of the whole process
+ *
+ * Bytes counts the bytes of the files loaded.\n
+ * Timed is the sum of phaseNanos, what inner phases take out of outer ones.\n
+ */
+struct MidiProfile
+{
+	unsigned long long events[MIDI_PROFILE_TYPES];
+	unsigned long long headerChunks, headerBytes;
+	unsigned long long trackChunks, trackBytes;
+	unsigned long long bytes;
+	uint64_t phaseNanos[MIDI_PROFILE_PHASES];
+	uint64_t timed;
+};
+
+/// @brief Counters of the calling thread
+extern __thread struct MidiProfile midiProfile;
+
+// Function Prototypes
+void flushMidiProfile(void);
+void addMidiProfileFile(const char *filename, uint64_t nanos, unsigned long long bytes, int status);
+void writeMidiProfile(struct MidiOutput *o, int json, uint64_t wallNanos);
+
+/** @fn static inline uint64_t midiProfileNow(void)
+ *  @brief Monotonic clock in nanoseconds
+ */
+static inline uint64_t midiProfileNow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/** @fn static inline void midiProfileStop(uint64_t start, int phase)
+ *  @brief Add the time since a timer was started to a phase, less the inner phases
+ */
+static inline void midiProfileStop(uint64_t start, int phase)
+{
+	uint64_t nanos = midiProfileNow() - midiProfile.timed - start;
+
+	midiProfile.phaseNanos[phase] += nanos;
+	midiProfile.timed += nanos;
+}
+
+/** @fn static inline int midiProfileType(unsigned char status)
+ *  @brief Counter index of an event from its status byte
+ */
+static inline int midiProfileType(unsigned char status)
+{
+	if (status == 0xFF)
+		return 7;
+	if ((status == 0xF0) || (status == 0xF7))
+		return 8;
+	if (status >= 0xF0)
+		return 9;
+	return (status >= 0x80) ? (status >> 4) - 8 : 10;
+}
+
+/// @brief Count a decoded event by its status byte
+#define MIDI_PROFILE_EVENT(status) (midiProfile.events[midiProfileType(status)]++)
+
+/// @brief Add n to a counter of the calling thread
+#define MIDI_PROFILE_ADD(field, n) (midiProfile.field += (n))
+
+/// @brief Declare a timer and start it
+#define MIDI_PROFILE_START(t) uint64_t t = midiProfileNow() - midiProfile.timed
+
+/// @brief Add the time since a timer was started to a phase
+#define MIDI_PROFILE_STOP(t, phase) midiProfileStop(t, phase)
+
+#else
+
+#define MIDI_PROFILE_EVENT(status) ((void)0)
+#define MIDI_PROFILE_ADD(field, n) ((void)0)
+#define MIDI_PROFILE_START(t)
+#define MIDI_PROFILE_STOP(t, phase) ((void)0)
+
+#endif
+
+#endif
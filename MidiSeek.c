@@ -0,0 +1,219 @@
+/** @file MidiSeek.c
+ *  @brief Checkpoint index for seeking to a tick or a time within a file
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#ifndef MIDISEEK_H_
+#include "MidiSeek.h"
+#endif
+
+#ifndef MIDIPROFILE_H_
+#include "MidiProfile.h"
+#endif
+
+/** @fn static int addCheckpoint(struct SeekTrack *t, size_t *capacity, const struct MidiCursor *c, unsigned long tick, const struct TempoMap *tempo, unsigned long *seg)
+ *  @brief Record the current place of a track cursor as a checkpoint
+ *
+ * @param t: The track
+ * @param capacity: Number of checkpoints allocated, updated
+ * @param c: The cursor, before the next event
+ * @param tick: Absolute tick of the last event read
+ * @param tempo: The tempo map
+ * @param seg: Tempo segment of the previous checkpoint, updated
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+static int addCheckpoint(struct SeekTrack *t, size_t *capacity, const struct MidiCursor *c, unsigned long tick,
+                         const struct TempoMap *tempo, unsigned long *seg)
+{
+    struct MidiCheckpoint *cp;
+    void *p;
+
+    if (t->count == *capacity)
+    {
+        *capacity = *capacity ? *capacity * 2 : 16;
+        if ((p = realloc(t->points, *capacity * sizeof(struct MidiCheckpoint))) == NULL)
+            return -1;
+        t->points = (struct MidiCheckpoint *)p;
+    }
+    *seg = tempoSegment(tempo, *seg, tick);
+    cp = &t->points[t->count++];
+    cp->offset = c->pos - t->data;
+    cp->tick = tick;
+    cp->tempo = tempo->segments[*seg].tempo;
+    cp->micros = tempoSegmentMicros(tempo, *seg, tick);
+    cp->runningStatus = c->runningStatus;
+    cp->sysExOpen = c->sysExOpen;
+    return 0;
+}
+
+/** @fn static int indexTrack(struct SeekTrack *t, const struct MidiCursor *track, const struct TempoMap *tempo, unsigned long everyEvents, unsigned long everyTicks)
+ *  @brief Decode a track once and record its checkpoints
+ *
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+static int indexTrack(struct SeekTrack *t, const struct MidiCursor *track, const struct TempoMap *tempo,
+                      unsigned long everyEvents, unsigned long everyTicks)
+{
+    struct MidiCursor c = *track;
+    struct MidiEvent ev;
+    unsigned long tick = 0, lastTick = 0, events = 0, seg = 0;
+    size_t capacity = 0;
+
+    t->data = c.pos;
+    t->size = c.end - c.pos;
+    t->points = NULL;
+    t->count = 0;
+    if (addCheckpoint(t, &capacity, &c, 0, tempo, &seg) != 0)
+        return -1;
+    while (cursorReadEvent(&c, &ev))
+    {
+        tick += ev.deltaTime;
+        events++;
+        if (((everyEvents > 0) && (events >= everyEvents)) || ((everyTicks > 0) && (tick - lastTick >= everyTicks)))
+        {
+            if (c.pos == c.end)
+                break;
+            if (addCheckpoint(t, &capacity, &c, tick, tempo, &seg) != 0)
+                return -1;
+            lastTick = tick;
+            events = 0;
+        }
+    }
+    return 0;
+}
+
+/** @fn int buildMidiSeekIndex(struct MidiSeekIndex *idx, short sTimeDiv, const struct MidiCursor *tracks, int numTracks, unsigned long everyEvents, unsigned long everyTicks)
+ *  @brief Build the tempo map and the checkpoints of every track of a file
+ *
+ * A checkpoint is recorded after every everyEvents events, or once
+ * everyTicks ticks have passed since the last one, whichever comes
+ * first. Fewer checkpoints use less memory, more make seeks shorter.
+ * The file data must stay in memory while the index is used.
+ *
+ * @param idx: The index to fill
+ * @param sTimeDiv: Time division from the MIDI header
+ * @param tracks: Cursors over the event data of each track, not moved
+ * @param numTracks: Number of tracks
+ * @param everyEvents: Events between checkpoints, 0 to use ticks only
+ * @param everyTicks: Ticks between checkpoints, 0 to use events only
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+int buildMidiSeekIndex(struct MidiSeekIndex *idx, short sTimeDiv, const struct MidiCursor *tracks, int numTracks,
+                       unsigned long everyEvents, unsigned long everyTicks)
+{
+    int i, ret;
+
+    idx->numTracks = 0;
+    if (buildTempoMap(&idx->tempo, sTimeDiv, tracks, numTracks) != 0)
+        return -1;
+    idx->tracks = (struct SeekTrack *)calloc(numTracks ? numTracks : 1, sizeof(struct SeekTrack));
+    if (idx->tracks == NULL)
+    {
+        freeTempoMap(&idx->tempo);
+        return -1;
+    }
+    idx->numTracks = numTracks;
+    for (i = 0; i < numTracks; i++)
+    {
+        MIDI_PROFILE_START(start);
+        ret = indexTrack(&idx->tracks[i], &tracks[i], &idx->tempo, everyEvents, everyTicks);
+        MIDI_PROFILE_STOP(start, MIDI_PROFILE_DECODE);
+        if (ret != 0)
+        {
+            freeMidiSeekIndex(idx);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/** @fn void freeMidiSeekIndex(struct MidiSeekIndex *idx)
+ *  @brief Release the checkpoints and tempo map of an index
+ */
+void freeMidiSeekIndex(struct MidiSeekIndex *idx)
+{
+    int i;
+
+    for (i = 0; i < idx->numTracks; i++)
+        free(idx->tracks[i].points);
+    free(idx->tracks);
+    idx->tracks = NULL;
+    idx->numTracks = 0;
+    freeTempoMap(&idx->tempo);
+}
+
+/** @fn int midiSeekTick(const struct MidiSeekIndex *idx, int track, unsigned long tick, struct MidiCursor *c, unsigned long *at)
+ *  @brief Position a cursor at the first event of a track at or after a tick
+ *
+ * Decoding starts from the last checkpoint before tick, so events at
+ * tick itself are never skipped, and the events up to tick are stepped
+ * over. The cursor then reads on with cursorReadEvent(), the delta time
+ * of its first event is relative to the tick returned in at.
+ *
+ * @param idx: The index
+ * @param track: Track number
+ * @param tick: Absolute tick to seek to
+ * @param c: Receives a cursor over the rest of the track
+ * @param at: Receives the absolute tick the next delta time is relative to
+ * @return 1 if there is an event at or after tick, 0 if the track ends before it or track is not valid
+ */
+int midiSeekTick(const struct MidiSeekIndex *idx, int track, unsigned long tick, struct MidiCursor *c, unsigned long *at)
+{
+    const struct SeekTrack *t;
+    const struct MidiCheckpoint *cp;
+    struct MidiCursor before;
+    struct MidiEvent ev;
+    size_t lo = 0, hi, mid;
+    unsigned long now;
+
+    if ((track < 0) || (track >= idx->numTracks))
+        return 0;
+    t = &idx->tracks[track];
+
+    // First checkpoint at or after tick, the one before it is the last before tick
+    hi = t->count;
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (t->points[mid].tick < tick)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    cp = &t->points[lo ? lo - 1 : 0];
+
+    initCursor(c, t->data + cp->offset, t->size - cp->offset);
+    c->runningStatus = cp->runningStatus;
+    c->sysExOpen = cp->sysExOpen;
+    now = cp->tick;
+    for (;;)
+    {
+        before = *c;
+        if (!cursorReadEvent(c, &ev))
+        {
+            *at = now;
+            return 0;
+        }
+        if (now + ev.deltaTime >= tick)
+        {
+            *c = before;
+            *at = now;
+            return 1;
+        }
+        now += ev.deltaTime;
+    }
+}
+
+/** @fn int midiSeekMicros(const struct MidiSeekIndex *idx, int track, double micros, struct MidiCursor *c, unsigned long *at)
+ *  @brief Position a cursor at the first event of a track at or after a time
+ *
+ * @param micros: Time from the start of the file in microseconds
+ * @return See midiSeekTick()
+ */
+int midiSeekMicros(const struct MidiSeekIndex *idx, int track, double micros, struct MidiCursor *c, unsigned long *at)
+{
+    return midiSeekTick(idx, track, tempoMicrosToTick(&idx->tempo, micros), c, at);
+}
@@ -0,0 +1,91 @@
+/** @file MidiSeek.h
+ *  @brief Checkpoint index for seeking to a tick or a time within a file
+ *
+ *  This contains the data structures and functions needed to start
+ *  decoding a track near a given tick or time instead of at its first
+ *  event, for previews and scrubbing.
+ *
+ *  Building the index decodes each track once and records a checkpoint
+ *  every few events or ticks: the offset of the next event, the
+ *  absolute tick and running status at that point, and the tempo and
+ *  time in effect there. A seek binary searches the checkpoints of the
+ *  track and decodes forward from the nearest one, so it reads at most
+ *  one interval of events however far into the file it goes. Building
+ *  costs a full decode, keep the index for as long as the file is being
+ *  seeked in.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#ifndef MIDITEMPO_H_
+#include "MidiTempo.h"
+#endif
+
+#ifndef MIDISEEK_H_
+#define MIDISEEK_H_
+
+/// @brief Default number of events between checkpoints
+#ifndef MIDI_SEEK_EVENTS
+#define MIDI_SEEK_EVENTS 1024
+#endif
+
+/// @brief Default number of ticks between checkpoints, 0 for events only
+#ifndef MIDI_SEEK_TICKS
+#define MIDI_SEEK_TICKS 0
+#endif
+
+// Data Structures
+/** @struct MidiCheckpoint
+ *  @brief A place in a track where decoding can start
+ *
+ * Offset is the position of the next event from the start of the track data.\n
+ * Tick is the absolute tick before that event, the tick of the event
+ * before it, and runningStatus and sysExOpen the running status and
+ * whether a divided SysEx message is open at that point.\n
+ * Tempo (microseconds per quarter note) and micros are the tempo and
+ * time at that tick.\n
+ */
+struct MidiCheckpoint
+{
+	size_t offset;
+	unsigned long tick;
+	unsigned long tempo;
+	double micros;
+	unsigned char runningStatus;
+	unsigned char sysExOpen;
+};
+
+/** @struct SeekTrack
+ *  @brief The event data and checkpoints of one track
+ *
+ * There is always a checkpoint at the start of the track.\n
+ */
+struct SeekTrack
+{
+	const unsigned char *data;
+	size_t size;
+	struct MidiCheckpoint *points;
+	size_t count;
+};
+
+/** @struct MidiSeekIndex
+ *  @brief Checkpoints of every track and the tempo map of the file
+ */
+struct MidiSeekIndex
+{
+	struct TempoMap tempo;
+	struct SeekTrack *tracks;
+	int numTracks;
+};
+
+// Function Prototypes
+int buildMidiSeekIndex(struct MidiSeekIndex *idx, short sTimeDiv, const struct MidiCursor *tracks, int numTracks,
+					   unsigned long everyEvents, unsigned long everyTicks);
+void freeMidiSeekIndex(struct MidiSeekIndex *idx);
+int midiSeekTick(const struct MidiSeekIndex *idx, int track, unsigned long tick, struct MidiCursor *c, unsigned long *at);
+int midiSeekMicros(const struct MidiSeekIndex *idx, int track, double micros, struct MidiCursor *c, unsigned long *at);
+
+#endif
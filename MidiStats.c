@@ -0,0 +1,370 @@
+/** @file MidiStats.c
+ *  @brief Musical statistics of a file gathered in one decode pass
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#include <limits.h>
+
+#ifndef MIDISTATS_H_
+#include "MidiStats.h"
+#endif
+
+// Event type names, text report and JSON keys
+static const char *typeNames[MIDI_STATS_TYPES] = {
+    "Note Off", "Note On", "Note Aftertouch", "Controller", "Program Change", "Channel Aftertouch", "Pitch Bend",
+    "Meta", "SysEx", "System", "Stray data"};
+static const char *typeKeys[MIDI_STATS_TYPES] = {
+    "note_off", "note_on", "note_aftertouch", "controller", "program_change", "channel_aftertouch", "pitch_bend",
+    "meta", "sysex", "system", "data"};
+
+/** @fn void initMidiStats(struct MidiStats *s, int tracks)
+ *  @brief Clear the counters before the first event of a file
+ *
+ * @param s: The counters
+ * @param tracks: Number of tracks of the file, for the report
+ */
+void initMidiStats(struct MidiStats *s, int tracks)
+{
+    memset(s, 0, sizeof(struct MidiStats));
+    s->tracks = tracks;
+    s->lowKey = 127;
+    memset(s->sysExOpen, -1, sizeof(s->sysExOpen));
+}
+
+/** @fn static void statsNoteOff(struct MidiStats *s, unsigned char channel, unsigned char key)
+ *  @brief A note stops sounding
+ */
+static void statsNoteOff(struct MidiStats *s, unsigned char channel, unsigned char key)
+{
+    if (s->sounding[channel][key] > 0)
+    {
+        s->sounding[channel][key]--;
+        s->polyphony--;
+    }
+}
+
+/** @fn static void statsSysEx(struct MidiStats *s, int track, const struct MidiEvent *ev)
+ *  @brief Count a SysEx packet for the manufacturer of its message
+ *
+ * The packets after the first of a divided message have no ID of their
+ * own, their bytes go to the manufacturer of the first packet of the same
+ * track. Escapes and packets without an ID are only counted as SysEx events.
+ */
+static void statsSysEx(struct MidiStats *s, int track, const struct MidiEvent *ev)
+{
+    signed char dummy = -1, *open = &dummy;
+    unsigned long id;
+    int i;
+
+    if ((track >= 0) && (track < MIDI_STATS_TRACKS))
+        open = &s->sysExOpen[track];
+    if ((ev->data1 == MIDI_SYSEX_NEXT) || (ev->data1 == MIDI_SYSEX_LAST))
+    {
+        if (*open >= 0)
+            s->sysEx[(int)*open].bytes += ev->length;
+        if (ev->data1 == MIDI_SYSEX_LAST)
+            *open = -1;
+        return;
+    }
+    *open = -1;
+    if ((ev->data1 == MIDI_SYSEX_ESCAPE) || ((id = midiSysExManufacturer(ev->data, ev->length)) == 0))
+        return;
+
+    for (i = 0; (i < s->numSysEx) && (s->sysEx[i].id != id); i++)
+        ;
+    if (i == s->numSysEx)
+    {
+        if (i == MIDI_STATS_MANUFACTURERS)
+        {
+            s->sysExOther++;
+            return;
+        }
+        s->sysEx[i].id = id;
+        s->numSysEx++;
+    }
+    s->sysEx[i].messages++;
+    s->sysEx[i].bytes += ev->length;
+    if (ev->data1 == MIDI_SYSEX_FIRST)
+        *open = i;
+}
+
+/** @fn void addMidiStatsEvent(struct MidiStats *s, int track, unsigned long tick, const struct MidiEvent *ev)
+ *  @brief Count one event
+ *
+ * @param s: The counters
+ * @param track: Index of the track of the event
+ * @param tick: Absolute tick of the event
+ * @param ev: The event
+ */
+void addMidiStatsEvent(struct MidiStats *s, int track, unsigned long tick, const struct MidiEvent *ev)
+{
+    unsigned char channel = ev->status & 0x0f, key = ev->data1 & 0x7f;
+    int type;
+
+    s->events++;
+    if (tick > s->ticks)
+        s->ticks = tick;
+
+    switch (midiStatusTable[ev->status].kind)
+    {
+    case MIDI_STATUS_META:
+        s->types[MIDI_STATS_META]++;
+        return;
+    case MIDI_STATUS_SYSEX:
+        s->types[MIDI_STATS_SYSEX]++;
+        statsSysEx(s, track, ev);
+        return;
+    case MIDI_STATUS_SYSTEM:
+        s->types[MIDI_STATS_SYSTEM]++;
+        return;
+    case MIDI_STATUS_DATA:
+        s->types[MIDI_STATS_DATA]++;
+        return;
+    }
+
+    type = (ev->status >> 4) - 8;
+    s->types[type]++;
+    s->channels[channel][type]++;
+    switch (ev->status & 0xf0)
+    {
+    case 0x80:
+        statsNoteOff(s, channel, key);
+        break;
+    case 0x90:
+        if (ev->data2 == 0)
+        {
+            statsNoteOff(s, channel, key);
+            break;
+        }
+        s->notes++;
+        s->velocities[ev->data2 & 0x7f]++;
+        if (key < s->lowKey)
+            s->lowKey = key;
+        if (key > s->highKey)
+            s->highKey = key;
+        if (s->sounding[channel][key] < USHRT_MAX)
+            s->sounding[channel][key]++;
+        if (++s->polyphony > s->peakPolyphony)
+        {
+            s->peakPolyphony = s->polyphony;
+            s->peakTick = tick;
+        }
+        break;
+    case 0xb0:
+        s->controllers[key]++;
+        break;
+    case 0xc0:
+        s->programs[channel][key >> 5] |= (uint32_t)1 << (key & 31);
+        break;
+    }
+}
+
+/** @fn static void outManufacturerId(struct MidiOutput *o, unsigned long id)
+ *  @brief Append a manufacturer ID as hex, two digits or six for a three byte ID
+ */
+static void outManufacturerId(struct MidiOutput *o, unsigned long id)
+{
+    if (id & MIDI_MANUFACTURER_EXTENDED)
+        outFormat(o, "%06lx", id & 0xFFFF);
+    else
+        outFormat(o, "%02lx", id);
+}
+
+/** @fn static void writeStatsText(struct MidiOutput *o, const struct MidiStats *s)
+ *  @brief The text report
+ */
+static void writeStatsText(struct MidiOutput *o, const struct MidiStats *s)
+{
+    const char *sep, *name;
+    int i, j;
+
+    outFormat(o, "Events: %lu in %d tracks, %lu ticks\n   ", s->events, s->tracks, s->ticks);
+    for (i = 0; i < MIDI_STATS_TYPES; i++)
+        outFormat(o, "%s %lu%s", typeNames[i], s->types[i], (i < MIDI_STATS_TYPES - 1) ? ", " : "\n");
+
+    for (i = 0; i < 16; i++)
+    {
+        sep = "";
+        for (j = 0; j < 7; j++)
+        {
+            if (s->channels[i][j] == 0)
+                continue;
+            if (*sep == '\0')
+                outFormat(o, "Channel %d: ", i);
+            outFormat(o, "%s%s %lu", sep, typeNames[j], s->channels[i][j]);
+            sep = ", ";
+        }
+        if (*sep != '\0')
+            outFormat(o, "\n");
+    }
+
+    if (s->notes == 0)
+        outFormat(o, "Pitch range: no notes\n");
+    else
+        outFormat(o, "Pitch range: %d to %d, %lu notes\n", s->lowKey, s->highKey, s->notes);
+
+    for (i = 0; i < MIDI_STATS_VELOCITY_BUCKETS; i++)
+    {
+        unsigned long n = 0;
+
+        for (j = 0; j < 128 / MIDI_STATS_VELOCITY_BUCKETS; j++)
+            n += s->velocities[i * (128 / MIDI_STATS_VELOCITY_BUCKETS) + j];
+        outFormat(o, "%s%d-%d %lu", i ? ", " : "Velocity: ", i * (128 / MIDI_STATS_VELOCITY_BUCKETS),
+                  (i + 1) * (128 / MIDI_STATS_VELOCITY_BUCKETS) - 1, n);
+    }
+    outFormat(o, "\n");
+
+    for (i = 0; i < 16; i++)
+    {
+        sep = "";
+        for (j = 0; j < MIDI_INSTRUMENTS; j++)
+        {
+            if (!(s->programs[i][j >> 5] & ((uint32_t)1 << (j & 31))))
+                continue;
+            if (*sep == '\0')
+                outFormat(o, "Programs on channel %d: ", i);
+            outFormat(o, "%s%d %s", sep, j, instrTable[j]);
+            sep = ", ";
+        }
+        if (*sep != '\0')
+            outFormat(o, "\n");
+    }
+
+    outFormat(o, "Peak polyphony: %lu at tick %lu\n", s->peakPolyphony, s->peakTick);
+
+    sep = "Controllers:";
+    for (i = 0; i < 128; i++)
+    {
+        if (s->controllers[i] == 0)
+            continue;
+        outFormat(o, "%s %d x%lu", sep, i, s->controllers[i]);
+        sep = ",";
+    }
+    if (sep[0] == ',')
+        outFormat(o, "\n");
+
+    sep = "SysEx:";
+    for (i = 0; i < s->numSysEx; i++)
+    {
+        name = midiManufacturerName(s->sysEx[i].id);
+        outFormat(o, "%s %s%s0x", sep, name ? name : "", name ? " " : "");
+        outManufacturerId(o, s->sysEx[i].id);
+        outFormat(o, " x%lu (%lu bytes)", s->sysEx[i].messages, s->sysEx[i].bytes);
+        sep = ",";
+    }
+    if (s->sysExOther > 0)
+    {
+        outFormat(o, "%s other x%lu", sep, s->sysExOther);
+        sep = ",";
+    }
+    if (sep[0] == ',')
+        outFormat(o, "\n");
+}
+
+/** @fn static void writeStatsJson(struct MidiOutput *o, const struct MidiStats *s, const char *filename)
+ *  @brief The JSON report, one line
+ */
+static void writeStatsJson(struct MidiOutput *o, const struct MidiStats *s, const char *filename)
+{
+    const char *sep, *name;
+    int i, j;
+
+    outFormat(o, "{\"file\":");
+    outJsonString(o, filename);
+    outFormat(o, ",\"tracks\":%d,\"ticks\":%lu,\"events\":%lu,\"types\":{", s->tracks, s->ticks, s->events);
+    for (i = 0; i < MIDI_STATS_TYPES; i++)
+        outFormat(o, "%s\"%s\":%lu", i ? "," : "", typeKeys[i], s->types[i]);
+
+    outFormat(o, "},\"channels\":[");
+    sep = "";
+    for (i = 0; i < 16; i++)
+    {
+        for (j = 0; (j < 7) && (s->channels[i][j] == 0); j++)
+            ;
+        if (j == 7)
+            continue;
+        outFormat(o, "%s{\"channel\":%d", sep, i);
+        for (j = 0; j < 7; j++)
+            outFormat(o, ",\"%s\":%lu", typeKeys[j], s->channels[i][j]);
+        outFormat(o, "}");
+        sep = ",";
+    }
+
+    outFormat(o, "],\"notes\":%lu,\"pitch\":", s->notes);
+    if (s->notes == 0)
+        outFormat(o, "null");
+    else
+        outFormat(o, "{\"low\":%d,\"high\":%d}", s->lowKey, s->highKey);
+
+    outFormat(o, ",\"velocity\":[");
+    for (i = 0; i < MIDI_STATS_VELOCITY_BUCKETS; i++)
+    {
+        unsigned long n = 0;
+
+        for (j = 0; j < 128 / MIDI_STATS_VELOCITY_BUCKETS; j++)
+            n += s->velocities[i * (128 / MIDI_STATS_VELOCITY_BUCKETS) + j];
+        outFormat(o, "%s%lu", i ? "," : "", n);
+    }
+
+    outFormat(o, "],\"programs\":[");
+    sep = "";
+    for (i = 0; i < 16; i++)
+    {
+        for (j = 0; j < MIDI_INSTRUMENTS; j++)
+        {
+            if (!(s->programs[i][j >> 5] & ((uint32_t)1 << (j & 31))))
+                continue;
+            outFormat(o, "%s{\"channel\":%d,\"program\":%d,\"name\":", sep, i, j);
+            outJsonString(o, instrTable[j]);
+            outFormat(o, "}");
+            sep = ",";
+        }
+    }
+
+    outFormat(o, "],\"polyphony\":{\"peak\":%lu,\"tick\":%lu},\"controllers\":{", s->peakPolyphony, s->peakTick);
+    sep = "";
+    for (i = 0; i < 128; i++)
+    {
+        if (s->controllers[i] == 0)
+            continue;
+        outFormat(o, "%s\"%d\":%lu", sep, i, s->controllers[i]);
+        sep = ",";
+    }
+
+    outFormat(o, "},\"sysex\":[");
+    for (i = 0; i < s->numSysEx; i++)
+    {
+        name = midiManufacturerName(s->sysEx[i].id);
+        outFormat(o, "%s{\"id\":\"", i ? "," : "");
+        outManufacturerId(o, s->sysEx[i].id);
+        outFormat(o, "\",\"name\":");
+        if (name != NULL)
+            outJsonString(o, name);
+        else
+            outFormat(o, "null");
+        outFormat(o, ",\"messages\":%lu,\"bytes\":%lu}", s->sysEx[i].messages, s->sysEx[i].bytes);
+    }
+    outFormat(o, "],\"sysex_other\":%lu}\n", s->sysExOther);
+}
+
+/** @fn void writeMidiStats(struct MidiOutput *o, const struct MidiStats *s, const char *filename, int json)
+ *  @brief Write the report for a file
+ *
+ * The text report is a few lines, only listing channels, programs and
+ * controllers that were used. The JSON report is one object per line.
+ *
+ * @param o: The output buffer
+ * @param s: The counters
+ * @param filename: Name of the file, only written in the JSON report
+ * @param json: Non-zero for JSON, text otherwise
+ */
+void writeMidiStats(struct MidiOutput *o, const struct MidiStats *s, const char *filename, int json)
+{
+    if (json)
+        writeStatsJson(o, s, filename);
+    else
+        writeStatsText(o, s);
+}
@@ -0,0 +1,96 @@
+/** @file MidiStats.h
+ *  @brief Musical statistics of a file gathered in one decode pass
+ *
+ *  This contains the counters filled in event by event and the report
+ *  written from them: events per type and channel, pitch range,
+ *  velocity histogram, programs, controllers, peak polyphony and SysEx
+ *  messages per manufacturer.
+ *
+ *  Every counter is a fixed size array, gathering statistics costs a
+ *  few increments per event and nothing is allocated or printed until
+ *  the report.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#ifndef MIDIBUFFER_H_
+#include "MidiBuffer.h"
+#endif
+
+#ifndef MIDISTATS_H_
+#define MIDISTATS_H_
+
+/// @brief Event types counted, the seven MIDI events by status nibble then these
+#define MIDI_STATS_META 7	///< Meta events
+#define MIDI_STATS_SYSEX 8	///< SysEx events, 0xF0 and 0xF7
+#define MIDI_STATS_SYSTEM 9 ///< Other System messages
+#define MIDI_STATS_DATA 10	///< Data bytes found without running status
+#define MIDI_STATS_TYPES 11
+
+/// @brief Buckets of the velocity histogram in the report
+#define MIDI_STATS_VELOCITY_BUCKETS 8
+
+/// @brief SysEx manufacturers counted apart, messages of any more count as other
+#ifndef MIDI_STATS_MANUFACTURERS
+#define MIDI_STATS_MANUFACTURERS 16
+#endif
+
+/// @brief Tracks whose divided SysEx messages are followed, later tracks only count their first packets
+#ifndef MIDI_STATS_TRACKS
+#define MIDI_STATS_TRACKS 256
+#endif
+
+// Data Structures
+/** @struct MidiStatsSysEx
+ *  @brief SysEx messages of one manufacturer
+ *
+ * Bytes counts the bytes of every packet of the messages.\n
+ */
+struct MidiStatsSysEx
+{
+	unsigned long id;
+	unsigned long messages, bytes;
+};
+
+/** @struct MidiStats
+ *  @brief Counters for one file
+ *
+ * Types counts events by type, channels the MIDI events of each channel
+ * by type (note off 0 to pitch bend 6).\n
+ * Velocities and keys are those of note-ons, velocity 0 excluded.\n
+ * Programs has a bit set for each program used on each channel.\n
+ * Sounding counts the notes open on each channel and key, polyphony
+ * is their total. The peak is only meaningful when events are added in
+ * time order, see MidiMerge.h.\n
+ * SysEx holds the manufacturers of the SysEx messages in the order
+ * they were first seen, sysExOpen for each track the one of the
+ * divided message being read, -1 if none. Tracks interleave in a merge,
+ * so each keeps its own.\n
+ */
+struct MidiStats
+{
+	int tracks;
+	unsigned long events, ticks;
+	unsigned long types[MIDI_STATS_TYPES];
+	unsigned long channels[16][7];
+	unsigned long notes, velocities[128];
+	unsigned char lowKey, highKey;
+	unsigned long controllers[128];
+	uint32_t programs[16][4];
+	unsigned short sounding[16][128];
+	unsigned long polyphony, peakPolyphony, peakTick;
+	struct MidiStatsSysEx sysEx[MIDI_STATS_MANUFACTURERS];
+	int numSysEx;
+	signed char sysExOpen[MIDI_STATS_TRACKS];
+	unsigned long sysExOther;
+};
+
+// Function Prototypes
+void initMidiStats(struct MidiStats *s, int tracks);
+void addMidiStatsEvent(struct MidiStats *s, int track, unsigned long tick, const struct MidiEvent *ev);
+void writeMidiStats(struct MidiOutput *o, const struct MidiStats *s, const char *filename, int json);
+
+#endif
@@ -0,0 +1,290 @@
+/** @file MidiStore.c
+ *  @brief In-memory, column oriented storage of decoded track events
+ *
+ *  This contains the functions needed to decode tracks into
+ *  struct TrackEvents and to release them again.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#ifndef MIDISTORE_H_
+#include "MidiStore.h"
+#endif
+
+#ifndef MIDIBATCH_H_
+#include "MidiBatch.h"
+#endif
+
+#ifndef MIDIPROFILE_H_
+#include "MidiProfile.h"
+#endif
+
+/// @brief Minimum number of events allocated for a track
+#ifndef MIDI_STORE_MIN_EVENTS
+#define MIDI_STORE_MIN_EVENTS 64
+#endif
+
+/** @fn static int growEvents(struct TrackEvents *te, unsigned long capacity)
+ *  @brief Resize the event columns of a track
+ *
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+static int growEvents(struct TrackEvents *te, unsigned long capacity)
+{
+    void *p;
+
+    if ((p = realloc(te->tick, capacity * sizeof(*te->tick))) == NULL)
+        return -1;
+    te->tick = (unsigned long *)p;
+    if ((p = realloc(te->status, capacity)) == NULL)
+        return -1;
+    te->status = (unsigned char *)p;
+    if ((p = realloc(te->data1, capacity)) == NULL)
+        return -1;
+    te->data1 = (unsigned char *)p;
+    if ((p = realloc(te->data2, capacity)) == NULL)
+        return -1;
+    te->data2 = (unsigned char *)p;
+
+    te->capacity = capacity;
+    return 0;
+}
+
+/** @fn static int addPayload(struct TrackEvents *te, const unsigned char *data, unsigned long length)
+ *  @brief Copy the payload of the most recently added event to the side table
+ *
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+static int addPayload(struct TrackEvents *te, const unsigned char *data, unsigned long length)
+{
+    size_t capacity;
+    void *p;
+
+    if (te->numPayloads == te->payloadCapacity)
+    {
+        capacity = te->payloadCapacity ? te->payloadCapacity * 2 : 16;
+        if ((p = realloc(te->payloads, capacity * sizeof(*te->payloads))) == NULL)
+            return -1;
+        te->payloads = (struct EventPayload *)p;
+        te->payloadCapacity = capacity;
+    }
+    if (te->payloadSize + length > te->payloadDataCapacity)
+    {
+        capacity = te->payloadDataCapacity ? te->payloadDataCapacity : 256;
+        while (capacity < te->payloadSize + length)
+            capacity *= 2;
+        if ((p = realloc(te->payloadData, capacity)) == NULL)
+            return -1;
+        te->payloadData = (unsigned char *)p;
+        te->payloadDataCapacity = capacity;
+    }
+
+    te->payloads[te->numPayloads].event = te->count - 1;
+    te->payloads[te->numPayloads].offset = te->payloadSize;
+    te->payloads[te->numPayloads].length = length;
+    te->numPayloads++;
+    memcpy(te->payloadData + te->payloadSize, data, length);
+    te->payloadSize += length;
+    return 0;
+}
+
+/** @fn struct TrackEvents *decodeTrackEvents(struct MidiCursor *c)
+ *  @brief Decode the events of a track into memory
+ *
+ * Events are read with cursorReadEvent() up to and including the
+ * End of Track event, or until the track data runs out.\n
+ * Delta times are accumulated into absolute ticks.
+ *
+ * @param c: A cursor over the event data of one track (see cursorTrackEvents())
+ * @return The decoded events, release with freeTrackEvents(), NULL if memory could not be allocated
+ */
+struct TrackEvents *decodeTrackEvents(struct MidiCursor *c)
+{
+    struct TrackEvents *te;
+    struct MidiEvent ev;
+    unsigned long tick = 0, i;
+
+    te = (struct TrackEvents *)calloc(1, sizeof(struct TrackEvents));
+    if (te == NULL)
+        return NULL;
+
+    // Most events take 3 bytes or more, running status ones 2, the columns grow if needed
+    if (growEvents(te, cursorRemaining(c) / 3 + MIDI_STORE_MIN_EVENTS) != 0)
+    {
+        freeTrackEvents(te);
+        return NULL;
+    }
+
+    while (cursorReadEvent(c, &ev))
+    {
+        if ((te->count == te->capacity) && (growEvents(te, te->capacity * 2) != 0))
+        {
+            freeTrackEvents(te);
+            return NULL;
+        }
+        tick += ev.deltaTime;
+        i = te->count++;
+        te->tick[i] = tick;
+        te->status[i] = ev.status;
+        te->data1[i] = ev.data1;
+        te->data2[i] = ev.data2;
+
+        if ((ev.data != NULL) && (addPayload(te, ev.data, ev.length) != 0))
+        {
+            freeTrackEvents(te);
+            return NULL;
+        }
+        if ((ev.status == 0xFF) && (ev.data1 == 0x2f))
+            break;
+    }
+    return te;
+}
+
+/** @fn void freeTrackEvents(struct TrackEvents *te)
+ *  @brief Release the events returned by decodeTrackEvents()
+ *
+ * @param te: The events to release, may be NULL
+ */
+void freeTrackEvents(struct TrackEvents *te)
+{
+    if (te == NULL)
+        return;
+    free(te->tick);
+    free(te->status);
+    free(te->data1);
+    free(te->data2);
+    free(te->payloads);
+    free(te->payloadData);
+    free(te);
+}
+
+/** @fn const unsigned char *trackEventPayload(const struct TrackEvents *te, unsigned long i, unsigned long *length)
+ *  @brief Find the payload of an event
+ *
+ * The side table is in event order, so this is a binary search.
+ *
+ * @param te: The track events
+ * @param i: Index of the event
+ * @param length: Receives the payload length, 0 if the event has none
+ * @return Pointer to the payload bytes, NULL if the event has no payload
+ */
+const unsigned char *trackEventPayload(const struct TrackEvents *te, unsigned long i, unsigned long *length)
+{
+    unsigned long lo = 0, hi = te->numPayloads, mid;
+
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (te->payloads[mid].event < i)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if ((lo < te->numPayloads) && (te->payloads[lo].event == i))
+    {
+        *length = te->payloads[lo].length;
+        return te->payloadData + te->payloads[lo].offset;
+    }
+    *length = 0;
+    return NULL;
+}
+
+/** @struct ParallelDecode
+ *  @brief Work shared by the threads of decodeMidiTracksParallel()
+ */
+struct ParallelDecode
+{
+    struct TrackHeader *trackHeaders;
+    struct MidiCursor *tracks;
+};
+
+/** @fn static void decodeTrack(size_t i, void *arg)
+ *  @brief runMidiParallel() item, decodes one indexed track
+ */
+static void decodeTrack(size_t i, void *arg)
+{
+    struct ParallelDecode *work = (struct ParallelDecode *)arg;
+    MIDI_PROFILE_START(start);
+
+    work->trackHeaders[i].events = decodeTrackEvents(&work->tracks[i]);
+    MIDI_PROFILE_STOP(start, MIDI_PROFILE_DECODE);
+}
+
+/** @fn int decodeMidiTracks(struct MidiCursor *c, struct MidiHeader *midiHead)
+ *  @brief Decode every track of a file into memory
+ *
+ * Allocates midiHead->trackHeaders and fills in the header and the
+ * decoded events of each track.
+ *
+ * @param c: The file cursor, positioned after the MIDI header chunk
+ * @param midiHead: The MIDI header already read from the file
+ * @return 0 on success, -1 on a bad track header or if memory could not be allocated.
+ *         Release with freeMidiTracks() either way.
+ */
+int decodeMidiTracks(struct MidiCursor *c, struct MidiHeader *midiHead)
+{
+    return decodeMidiTracksParallel(c, midiHead, 1);
+}
+
+/** @fn int decodeMidiTracksParallel(struct MidiCursor *c, struct MidiHeader *midiHead, int numWorkers)
+ *  @brief Decode every track of a file into memory, several tracks at once
+ *
+ * All track chunks are located first with cursorIndexTracks(), the
+ * tracks are then decoded concurrently on a pool of worker threads.
+ * Each track's events end up in its own entry of midiHead->trackHeaders,
+ * so the results are in track order whatever order they finished in.
+ *
+ * @param c: The file cursor, positioned after the MIDI header chunk
+ * @param midiHead: The MIDI header already read from the file
+ * @param numWorkers: Number of worker threads, 0 or less for one per processor
+ * @return 0 on success, -1 on a bad track header or if memory could not be allocated.
+ *         Release with freeMidiTracks() either way.
+ */
+int decodeMidiTracksParallel(struct MidiCursor *c, struct MidiHeader *midiHead, int numWorkers)
+{
+    struct ParallelDecode work;
+    int i, numTracks, ret = 0;
+
+    numTracks = midiHead->uNumTracks;
+    midiHead->trackHeaders = (struct TrackHeader *)calloc(numTracks ? numTracks : 1, sizeof(struct TrackHeader));
+    if (midiHead->trackHeaders == NULL)
+        return -1;
+    work.trackHeaders = midiHead->trackHeaders;
+    work.tracks = (struct MidiCursor *)malloc((numTracks ? numTracks : 1) * sizeof(struct MidiCursor));
+    if (work.tracks == NULL)
+        return -1;
+
+    numTracks = cursorIndexTracks(c, midiHead, work.tracks);
+    if (numTracks < midiHead->uNumTracks)
+        ret = -1;
+
+    if (runMidiParallel(numTracks, numWorkers, decodeTrack, &work) != 0)
+        ret = -1;
+    for (i = 0; i < numTracks; i++)
+    {
+        if (midiHead->trackHeaders[i].events == NULL)
+            ret = -1;
+    }
+
+    free(work.tracks);
+    return ret;
+}
+
+/** @fn void freeMidiTracks(struct MidiHeader *midiHead)
+ *  @brief Release the track headers and events filled by decodeMidiTracks()
+ *
+ * @param midiHead: The MIDI header owning the tracks
+ */
+void freeMidiTracks(struct MidiHeader *midiHead)
+{
+    int i;
+
+    if (midiHead->trackHeaders == NULL)
+        return;
+    for (i = 0; i < midiHead->uNumTracks; i++)
+        freeTrackEvents(midiHead->trackHeaders[i].events);
+    free(midiHead->trackHeaders);
+    midiHead->trackHeaders = NULL;
+}
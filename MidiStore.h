@@ -0,0 +1,73 @@
+/** @file MidiStore.h
+ *  @brief In-memory, column oriented storage of decoded track events
+ *
+ *  This contains the data structures and functions needed to decode
+ *  tracks once and keep their events in memory, so that later passes
+ *  over a file do not need to parse it again.
+ *
+ *  MIDI_Info itself decodes with cursors and does not use the store,
+ *  it is a library representation exercised by the benchmarks.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#ifndef MIDIBUFFER_H_
+#include "MidiBuffer.h"
+#endif
+
+#ifndef MIDISTORE_H_
+#define MIDISTORE_H_
+
+// Data Structures
+/** @struct EventPayload
+ *  @brief Location of the payload of one event
+ *
+ * Event is the index of the event the payload belongs to.\n
+ * Offset and length locate the payload bytes in TrackEvents.payloadData.\n
+ */
+struct EventPayload
+{
+	uint32_t event;
+	uint32_t offset;
+	uint32_t length;
+};
+
+/** @struct TrackEvents
+ *  @brief The decoded events of one track, stored as columns
+ *
+ * Each event i is described by tick[i], status[i], data1[i] and data2[i]:
+ * - Tick is the absolute time of the event in ticks from the start of the track.
+ * - Status is the full status byte, 0xFF for Meta events and 0xF0/0xF7 for SysEx.
+ * - For MIDI events data1 and data2 are the data bytes.
+ * - For Meta events data1 is the Meta event type.\n
+ *
+ * Text, SysEx, SMPTE and other payloads are copied to payloadData,
+ * payloads lists them in event order (see trackEventPayload()).\n
+ */
+struct TrackEvents
+{
+	unsigned long count, capacity;
+	unsigned long *tick;
+	unsigned char *status;
+	unsigned char *data1;
+	unsigned char *data2;
+
+	unsigned long numPayloads, payloadCapacity;
+	struct EventPayload *payloads;
+	unsigned char *payloadData;
+	size_t payloadSize, payloadDataCapacity;
+};
+
+// Function Prototypes
+struct TrackEvents *decodeTrackEvents(struct MidiCursor *c);
+void freeTrackEvents(struct TrackEvents *te);
+const unsigned char *trackEventPayload(const struct TrackEvents *te, unsigned long i, unsigned long *length);
+
+int decodeMidiTracks(struct MidiCursor *c, struct MidiHeader *midiHead);
+int decodeMidiTracksParallel(struct MidiCursor *c, struct MidiHeader *midiHead, int numWorkers);
+void freeMidiTracks(struct MidiHeader *midiHead);
+
+#endif
@@ -0,0 +1,422 @@
+/** @file MidiStream.c
+ *  @brief Incremental push parser for streamed or partial MIDI input
+ *
+ *  This contains the state machine that splits pushed blocks into the
+ *  header chunk, track chunk headers and track events. Whole events
+ *  inside a block are decoded in place with cursorReadEvent(), only an
+ *  event cut off at the end of a block goes through the carry buffer.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+
+#ifndef MIDISTREAM_H_
+#include "MidiStream.h"
+#endif
+
+#ifndef MIDIPROFILE_H_
+#include "MidiProfile.h"
+#endif
+
+/// @brief Size of the blocks readMidiStream() reads
+#ifndef MIDI_STREAM_BLOCK
+#define MIDI_STREAM_BLOCK 65536
+#endif
+
+/// @brief Bytes first added to a cut off event, most events complete within them
+#ifndef MIDI_STREAM_CARRY_STEP
+#define MIDI_STREAM_CARRY_STEP 64
+#endif
+
+// Parser states
+#define MIDI_STREAM_HEADER 0 ///< Collecting the MIDI header chunk
+#define MIDI_STREAM_CHUNK 1	 ///< Collecting a track chunk header
+#define MIDI_STREAM_EVENTS 2 ///< Decoding the events of a track
+#define MIDI_STREAM_SKIP 3	 ///< Skipping the rest of a track after End of Track
+#define MIDI_STREAM_DONE 4	 ///< All tracks read, stopped by a callback or a bad chunk
+
+// decodeEvents() results
+#define MIDI_STREAM_MORE 0 ///< Stopped at the end of the data or a cut off event
+#define MIDI_STREAM_EOT 1  ///< Stopped after the End of Track event
+#define MIDI_STREAM_STOP 2 ///< A callback asked to stop
+
+/** @fn void initMidiStream(struct MidiStream *s, const struct MidiVisitor *v)
+ *  @brief Set up a parser at the start of a file
+ *
+ * @param s: The parser to set up, release with freeMidiStream()
+ * @param v: The callbacks receiving the file, kept by pointer
+ */
+void initMidiStream(struct MidiStream *s, const struct MidiVisitor *v)
+{
+    memset(s, 0, sizeof(struct MidiStream));
+    s->visitor = v;
+    s->state = MIDI_STREAM_HEADER;
+}
+
+/** @fn void freeMidiStream(struct MidiStream *s)
+ *  @brief Release the carry buffer of a parser
+ */
+void freeMidiStream(struct MidiStream *s)
+{
+    free(s->carry);
+    s->carry = NULL;
+    s->carrySize = 0;
+    s->carryCapacity = 0;
+}
+
+/** @fn static void startHeader(struct MidiStream *s)
+ *  @brief Decode the collected header chunk and pass it on
+ */
+static void startHeader(struct MidiStream *s)
+{
+    const struct MidiVisitor *v = s->visitor;
+    struct MidiCursor c;
+
+    initCursor(&c, s->head, s->headSize);
+    s->midiHead = cursorReadMidiChunk(&c);
+    s->headSize = 0;
+    s->state = MIDI_STREAM_CHUNK;
+    if ((v->onHeader != NULL) && v->onHeader(v->ctx, &s->midiHead))
+        s->state = MIDI_STREAM_DONE;
+    else if (s->midiHead.uNumTracks == 0)
+        s->state = MIDI_STREAM_DONE;
+}
+
+/** @fn static void endTrack(struct MidiStream *s)
+ *  @brief Finish the current track and expect the next chunk
+ */
+static void endTrack(struct MidiStream *s)
+{
+    const struct MidiVisitor *v = s->visitor;
+
+    s->carrySize = 0;
+    s->headSize = 0;
+    s->state = (++s->track < s->midiHead.uNumTracks) ? MIDI_STREAM_CHUNK : MIDI_STREAM_DONE;
+    if ((v->onTrackEnd != NULL) && v->onTrackEnd(v->ctx, s->track - 1))
+        s->state = MIDI_STREAM_DONE;
+}
+
+/** @fn static void startTrack(struct MidiStream *s)
+ *  @brief Decode the collected track chunk header and pass it on
+ *
+ * Like cursorIndexTracks(), decoding stops at a chunk that is not a track.
+ */
+static void startTrack(struct MidiStream *s)
+{
+    const struct MidiVisitor *v = s->visitor;
+    struct TrackHeader trackHead;
+    struct MidiCursor c;
+
+    initCursor(&c, s->head, s->headSize);
+    trackHead = cursorReadTrackChunk(&c);
+    s->headSize = 0;
+    if ((v->onTrack != NULL) && v->onTrack(v->ctx, s->track, &trackHead))
+    {
+        s->state = MIDI_STREAM_DONE;
+        return;
+    }
+    if (strcmp(trackHead.cChunkType, MIDI_TRACK_ID) != 0)
+    {
+        s->state = MIDI_STREAM_DONE;
+        return;
+    }
+    s->remaining = trackHead.uLength;
+    s->tick = 0;
+    s->runningStatus = 0;
+    s->sysExOpen = 0;
+    s->state = MIDI_STREAM_EVENTS;
+    if (s->remaining == 0)
+        endTrack(s);
+}
+
+/** @fn static size_t collect(struct MidiStream *s, const unsigned char *data, size_t size, size_t want)
+ *  @brief Add bytes to the chunk header being collected
+ *
+ * @return The number of bytes taken from data
+ */
+static size_t collect(struct MidiStream *s, const unsigned char *data, size_t size, size_t want)
+{
+    size_t n = want - s->headSize;
+
+    if (n > size)
+        n = size;
+    memcpy(s->head + s->headSize, data, n);
+    s->headSize += n;
+    return n;
+}
+
+/** @fn static int decodeEvents(struct MidiStream *s, const unsigned char *p, size_t size, size_t *used)
+ *  @brief Decode and pass on the complete events at the start of a block
+ *
+ * A cut off event is left unread and the running status is put back
+ * to what it was before it. A SysEx packet that is cut off does not
+ * change the open divided message, see midiSysExKind().
+ *
+ * @param s: The parser
+ * @param p: Event data of the current track
+ * @param size: Bytes at p, no more than are left in the track
+ * @param used: Receives the number of bytes of complete events
+ * @return MIDI_STREAM_MORE, MIDI_STREAM_EOT or MIDI_STREAM_STOP
+ */
+static int decodeEvents(struct MidiStream *s, const unsigned char *p, size_t size, size_t *used)
+{
+    const unsigned char *start;
+    struct MidiCursor c;
+    struct MidiEvent ev;
+    unsigned char runningStatus;
+    int ret = MIDI_STREAM_MORE;
+
+    initCursor(&c, p, size);
+    c.runningStatus = s->runningStatus;
+    c.sysExOpen = s->sysExOpen;
+    while (c.pos < c.end)
+    {
+        start = c.pos;
+        runningStatus = c.runningStatus;
+        if (!cursorReadEvent(&c, &ev))
+        {
+            c.pos = start;
+            c.runningStatus = runningStatus;
+            break;
+        }
+        s->tick += ev.deltaTime;
+        if (visitEvent(s->visitor, s->track, s->tick, &ev))
+        {
+            ret = MIDI_STREAM_STOP;
+            break;
+        }
+        if ((ev.status == 0xFF) && (ev.data1 == 0x2f))
+        {
+            ret = MIDI_STREAM_EOT;
+            break;
+        }
+    }
+    s->runningStatus = c.runningStatus;
+    s->sysExOpen = c.sysExOpen;
+    *used = c.pos - p;
+    return ret;
+}
+
+/** @fn static int appendCarry(struct MidiStream *s, const unsigned char *data, size_t size)
+ *  @brief Add bytes to the cut off event
+ *
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+static int appendCarry(struct MidiStream *s, const unsigned char *data, size_t size)
+{
+    size_t capacity;
+    void *p;
+
+    if (s->carrySize + size > s->carryCapacity)
+    {
+        capacity = s->carryCapacity ? s->carryCapacity : 256;
+        while (capacity < s->carrySize + size)
+            capacity *= 2;
+        if ((p = realloc(s->carry, capacity)) == NULL)
+            return -1;
+        s->carry = (unsigned char *)p;
+        s->carryCapacity = capacity;
+    }
+    memcpy(s->carry + s->carrySize, data, size);
+    s->carrySize += size;
+    return 0;
+}
+
+/** @fn static long pushEvents(struct MidiStream *s, const unsigned char *data, size_t size)
+ *  @brief Decode track events from a block
+ *
+ * @return The number of bytes taken from data, -1 if memory could not be allocated
+ */
+static long pushEvents(struct MidiStream *s, const unsigned char *data, size_t size)
+{
+    size_t n, step, used, carried;
+    int ret;
+
+    n = (size < s->remaining) ? size : s->remaining;
+
+    if (s->carrySize == 0)
+    {
+        ret = decodeEvents(s, data, n, &used);
+        s->remaining -= used;
+        if (ret == MIDI_STREAM_STOP)
+            s->state = MIDI_STREAM_DONE;
+        else if (ret == MIDI_STREAM_EOT)
+            s->state = MIDI_STREAM_SKIP;
+        else if (s->remaining == 0)
+            endTrack(s);
+        else if (used < n)
+        {
+            // Cut off by the end of the block, keep the start of the event
+            if (appendCarry(s, data + used, n - used) != 0)
+                return -1;
+            s->remaining -= n - used;
+            used = n;
+            if (s->remaining == 0)
+                endTrack(s);
+        }
+        return used;
+    }
+
+    // Complete the cut off event, a few bytes first and then the whole block
+    carried = s->carrySize;
+    for (step = (n < MIDI_STREAM_CARRY_STEP) ? n : MIDI_STREAM_CARRY_STEP;; step = n)
+    {
+        if (appendCarry(s, data + (s->carrySize - carried), step - (s->carrySize - carried)) != 0)
+            return -1;
+        ret = decodeEvents(s, s->carry, s->carrySize, &used);
+        if ((used > 0) || (ret != MIDI_STREAM_MORE) || (step == n))
+            break;
+    }
+
+    if (used == 0)
+    {
+        // Still cut off, all of the block is in the carry buffer
+        s->remaining -= n;
+        if (s->remaining == 0)
+            endTrack(s);
+        return n;
+    }
+
+    // Events decoded from the carry buffer, give back the bytes after them
+    used -= carried;
+    s->carrySize = 0;
+    s->remaining -= used;
+    if (ret == MIDI_STREAM_STOP)
+        s->state = MIDI_STREAM_DONE;
+    else if (ret == MIDI_STREAM_EOT)
+        s->state = MIDI_STREAM_SKIP;
+    else if (s->remaining == 0)
+        endTrack(s);
+    return used;
+}
+
+/** @fn int pushMidiStream(struct MidiStream *s, const unsigned char *data, size_t size)
+ *  @brief Decode the next block of a file
+ *
+ * Blocks may be of any size and split the file anywhere, events are
+ * passed to the visitor as soon as they are complete.
+ *
+ * @param s: The parser
+ * @param data: The next bytes of the file
+ * @param size: Number of bytes
+ * @return 0 if more data is expected, 1 if decoding is finished (all
+ *         tracks read or stopped by a callback), -1 if memory could not be allocated
+ */
+int pushMidiStream(struct MidiStream *s, const unsigned char *data, size_t size)
+{
+    long used;
+
+    while ((size > 0) && (s->state != MIDI_STREAM_DONE))
+    {
+        switch (s->state)
+        {
+        case MIDI_STREAM_HEADER:
+            used = collect(s, data, size, MIDI_STREAM_HEADER_SIZE);
+            if (s->headSize == MIDI_STREAM_HEADER_SIZE)
+                startHeader(s);
+            break;
+        case MIDI_STREAM_CHUNK:
+            used = collect(s, data, size, MIDI_STREAM_CHUNK_SIZE);
+            if (s->headSize == MIDI_STREAM_CHUNK_SIZE)
+                startTrack(s);
+            break;
+        case MIDI_STREAM_EVENTS:
+        {
+            MIDI_PROFILE_START(start);
+            used = pushEvents(s, data, size);
+            MIDI_PROFILE_STOP(start, MIDI_PROFILE_DECODE);
+            if (used < 0)
+                return -1;
+            break;
+        }
+        default:
+            used = (size < s->remaining) ? size : s->remaining;
+            s->remaining -= used;
+            if (s->remaining == 0)
+                endTrack(s);
+            break;
+        }
+        data += used;
+        size -= used;
+    }
+    return (s->state == MIDI_STREAM_DONE) ? 1 : 0;
+}
+
+/** @fn int finishMidiStream(struct MidiStream *s)
+ *  @brief Signal the end of the input
+ *
+ * A header or track cut short by the end of the input is passed on the
+ * same way the cursor functions see it: short chunk headers have an
+ * empty id, a short track ends at the last complete event and tracks
+ * that never arrived are reported through onTrack with an empty id.
+ *
+ * @param s: The parser
+ * @return 0 if the whole file had arrived, 1 if it was cut short
+ */
+int finishMidiStream(struct MidiStream *s)
+{
+    int ret = (s->state == MIDI_STREAM_DONE) ? 0 : 1;
+
+    if (s->state == MIDI_STREAM_HEADER)
+        startHeader(s);
+    while (s->state != MIDI_STREAM_DONE)
+    {
+        if (s->state == MIDI_STREAM_CHUNK)
+            startTrack(s);
+        else
+            endTrack(s);
+    }
+    return ret;
+}
+
+/** @fn int readMidiStream(int fd, struct MidiStream *s)
+ *  @brief Decode a whole file from a descriptor, a block at a time
+ *
+ * Suits pipes and stdin, reading stops as soon as decoding is finished.
+ *
+ * @param fd: The descriptor to read from
+ * @param s: A parser set up with initMidiStream()
+ * @return 0 on success, 1 if the input was cut short, -1 on a read error or if memory could not be allocated
+ */
+int readMidiStream(int fd, struct MidiStream *s)
+{
+    unsigned char *block;
+    ssize_t n;
+    int ret = 0;
+
+    block = (unsigned char *)malloc(MIDI_STREAM_BLOCK);
+    if (block == NULL)
+        return -1;
+    for (;;)
+    {
+        MIDI_PROFILE_START(start);
+        n = read(fd, block, MIDI_STREAM_BLOCK);
+        MIDI_PROFILE_STOP(start, MIDI_PROFILE_LOAD);
+        if (n > 0)
+            MIDI_PROFILE_ADD(bytes, n);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            ret = -1;
+            break;
+        }
+        if (n == 0)
+        {
+            ret = finishMidiStream(s);
+            break;
+        }
+        if ((ret = pushMidiStream(s, block, n)) != 0)
+        {
+            if (ret > 0)
+                ret = 0;
+            break;
+        }
+    }
+    free(block);
+    return ret;
+}
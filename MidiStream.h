@@ -0,0 +1,74 @@
+/** @file MidiStream.h
+ *  @brief Incremental push parser for streamed or partial MIDI input
+ *
+ *  This contains the data structure and functions needed to decode a
+ *  MIDI file handed over in blocks of any size, as it arrives from a
+ *  pipe or an upload. Events are passed to a struct MidiVisitor as
+ *  soon as their last byte has arrived.
+ *
+ *  Between blocks the parser keeps its place: the chunk header being
+ *  read, the bytes left in the current chunk, the running status and
+ *  absolute tick of the current track, and the start of an event that
+ *  was cut off at the end of the block. Only that partial event is
+ *  copied, so memory use depends on the largest event and not on the
+ *  size of the file.
+ *
+ *  Decoding follows the same rules as the cursor functions in
+ *  MidiBuffer.c, a file pushed in any number of blocks gives the same
+ *  events as cursorReadEvent() over the whole file.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#ifndef MIDIVISITOR_H_
+#include "MidiVisitor.h"
+#endif
+
+#ifndef MIDISTREAM_H_
+#define MIDISTREAM_H_
+
+/// @brief Bytes of the MIDI header chunk, id, length and the 6 byte body
+#define MIDI_STREAM_HEADER_SIZE 14
+
+/// @brief Bytes of a track chunk header, id and length
+#define MIDI_STREAM_CHUNK_SIZE 8
+
+// Data Structures
+/** @struct MidiStream
+ *  @brief State of the push parser between blocks
+ *
+ * State is one of the MIDI_STREAM_* values in MidiStream.c.\n
+ * Head collects the header chunk or a track chunk header.\n
+ * Remaining is the number of event bytes left in the current track.\n
+ * Carry holds the start of an event cut off at the end of a block.\n
+ */
+struct MidiStream
+{
+	const struct MidiVisitor *visitor;
+	int state;
+
+	unsigned char head[MIDI_STREAM_HEADER_SIZE];
+	size_t headSize;
+	struct MidiHeader midiHead;
+
+	int track;
+	unsigned long remaining;
+	unsigned long tick;
+	unsigned char runningStatus;
+	unsigned char sysExOpen;
+
+	unsigned char *carry;
+	size_t carrySize, carryCapacity;
+};
+
+// Function Prototypes
+void initMidiStream(struct MidiStream *s, const struct MidiVisitor *v);
+int pushMidiStream(struct MidiStream *s, const unsigned char *data, size_t size);
+int finishMidiStream(struct MidiStream *s);
+void freeMidiStream(struct MidiStream *s);
+int readMidiStream(int fd, struct MidiStream *s);
+
+#endif
@@ -0,0 +1,227 @@
+/** @file MidiTempo.c
+ *  @brief Tempo map, conversion of ticks to wall clock time
+ *
+ *  This contains the functions that build a tempo map from the Set
+ *  Tempo events of every track and look up the segment of a tick.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#include <limits.h>
+#include <math.h>
+
+#ifndef MIDITEMPO_H_
+#include "MidiTempo.h"
+#endif
+
+/** @struct TempoChange
+ *  @brief A Set Tempo event found while building the map
+ *
+ * Order is the position the event was found in, it keeps the sort
+ * stable so the last of several changes at the same tick wins.\n
+ */
+struct TempoChange
+{
+    unsigned long tick;
+    unsigned long tempo;
+    unsigned long order;
+};
+
+/** @fn static int compareTempoChange(const void *a, const void *b)
+ *  @brief qsort() comparison, by tick then by the order the events were found
+ */
+static int compareTempoChange(const void *a, const void *b)
+{
+    const struct TempoChange *x = (const struct TempoChange *)a;
+    const struct TempoChange *y = (const struct TempoChange *)b;
+
+    if (x->tick != y->tick)
+        return (x->tick < y->tick) ? -1 : 1;
+    if (x->order != y->order)
+        return (x->order < y->order) ? -1 : 1;
+    return 0;
+}
+
+/** @fn static int collectTempoChanges(const struct MidiCursor *tracks, int numTracks, struct TempoChange **changes, unsigned long *count)
+ *  @brief Find the Set Tempo events of every track
+ *
+ * Tracks are read with cursorReadMetaEvent() through copies of their
+ * cursors, the cursors passed in are left where they are.
+ *
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+static int collectTempoChanges(const struct MidiCursor *tracks, int numTracks, struct TempoChange **changes, unsigned long *count)
+{
+    struct MidiCursor c;
+    struct MidiEvent ev;
+    unsigned long tick, capacity = 0;
+    void *p;
+    int i;
+
+    *changes = NULL;
+    *count = 0;
+    for (i = 0; i < numTracks; i++)
+    {
+        c = tracks[i];
+        tick = 0;
+        while (cursorReadMetaEvent(&c, &ev) && (ev.data1 != 0x2f))
+        {
+            tick += ev.deltaTime;
+            if ((ev.data1 != 0x51) || (ev.length < 3))
+                continue;
+            if (*count == capacity)
+            {
+                capacity = capacity ? capacity * 2 : 16;
+                if ((p = realloc(*changes, capacity * sizeof(struct TempoChange))) == NULL)
+                    return -1;
+                *changes = (struct TempoChange *)p;
+            }
+            (*changes)[*count].tick = tick;
+            (*changes)[*count].tempo = (ev.data[0] << 16) | (ev.data[1] << 8) | ev.data[2];
+            (*changes)[*count].order = *count;
+            (*count)++;
+        }
+    }
+    return 0;
+}
+
+/** @fn int buildTempoMap(struct TempoMap *map, short sTimeDiv, const struct MidiCursor *tracks, int numTracks)
+ *  @brief Build the tempo map of a file
+ *
+ * Set Tempo events are collected from all tracks and sorted by tick,
+ * when several fall on the same tick the last one found applies.
+ * Until the first one the tempo is MIDI_DEFAULT_TEMPO.\n
+ * With an SMPTE time division ticks are a fixed fraction of a second
+ * (29 frames per second meaning 29.97 drop frame) and no tracks are read.
+ *
+ * @param map: Receives the tempo map, release with freeTempoMap()
+ * @param sTimeDiv: Time division from the MIDI header
+ * @param tracks: A cursor per track (see cursorIndexTracks()), not moved
+ * @param numTracks: Number of tracks
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+int buildTempoMap(struct TempoMap *map, short sTimeDiv, const struct MidiCursor *tracks, int numTracks)
+{
+    struct TempoChange *changes = NULL;
+    struct TempoSegment *s;
+    unsigned long i, count = 0;
+    double fps, division = sTimeDiv;
+
+    map->count = 0;
+    map->smpte = (sTimeDiv & 0x8000) != 0;
+    if (!map->smpte && (collectTempoChanges(tracks, numTracks, &changes, &count) != 0))
+    {
+        free(changes);
+        map->segments = NULL;
+        return -1;
+    }
+    map->segments = (struct TempoSegment *)malloc((count + 1) * sizeof(struct TempoSegment));
+    if (map->segments == NULL)
+    {
+        free(changes);
+        return -1;
+    }
+
+    s = &map->segments[0];
+    s->tick = 0;
+    s->micros = 0;
+    s->tempo = MIDI_DEFAULT_TEMPO;
+    if (map->smpte)
+    {
+        // Negative frame rate in the upper byte, ticks per frame in the lower
+        fps = -(signed char)(sTimeDiv >> 8);
+        if (fps == 29)
+            fps = 30000.0 / 1001.0;
+        division = fps * (sTimeDiv & 0x00ff);
+        s->microsPerTick = (division > 0) ? 1000000.0 / division : 0;
+        map->count = 1;
+        return 0;
+    }
+    s->microsPerTick = (division > 0) ? s->tempo / division : 0;
+    map->count = 1;
+
+    // No tempo events leaves changes NULL, which qsort() must not be given
+    if (count > 1)
+        qsort(changes, count, sizeof(struct TempoChange), compareTempoChange);
+    for (i = 0; i < count; i++)
+    {
+        s = &map->segments[map->count - 1];
+        if (changes[i].tick != s->tick)
+        {
+            map->segments[map->count].micros = tempoSegmentMicros(map, map->count - 1, changes[i].tick);
+            s = &map->segments[map->count++];
+            s->tick = changes[i].tick;
+        }
+        s->tempo = changes[i].tempo;
+        s->microsPerTick = (division > 0) ? s->tempo / division : 0;
+    }
+
+    free(changes);
+    return 0;
+}
+
+/** @fn void freeTempoMap(struct TempoMap *map)
+ *  @brief Release a tempo map filled by buildTempoMap()
+ */
+void freeTempoMap(struct TempoMap *map)
+{
+    free(map->segments);
+    map->segments = NULL;
+    map->count = 0;
+}
+
+/** @fn unsigned long tempoFindSegment(const struct TempoMap *map, unsigned long tick)
+ *  @brief Find the segment holding a tick with a binary search
+ *
+ * @param map: The tempo map
+ * @param tick: Absolute tick
+ * @return Index of the last segment starting at or before tick
+ */
+unsigned long tempoFindSegment(const struct TempoMap *map, unsigned long tick)
+{
+    unsigned long lo = 0, hi = map->count, mid;
+
+    // First segment starting after tick, the one before it holds tick
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (map->segments[mid].tick <= tick)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo ? lo - 1 : 0;
+}
+
+/** @fn unsigned long tempoMicrosToTick(const struct TempoMap *map, double micros)
+ *  @brief Find the first tick at or after a time, the inverse of tempoTickToMicros()
+ *
+ * @param map: The tempo map
+ * @param micros: Time from the start of the file in microseconds
+ * @return The first absolute tick whose time is not before micros
+ */
+unsigned long tempoMicrosToTick(const struct TempoMap *map, double micros)
+{
+    unsigned long lo = 0, hi = map->count, mid;
+    const struct TempoSegment *s;
+    double ticks;
+
+    if (micros <= 0)
+        return 0;
+    // First segment starting after micros, the one before it holds micros
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (map->segments[mid].micros <= micros)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    s = &map->segments[lo ? lo - 1 : 0];
+    ticks = ceil((micros - s->micros) / s->microsPerTick);
+    if (ticks >= (double)(ULONG_MAX - s->tick))
+        return ULONG_MAX;
+    return s->tick + (unsigned long)ticks;
+}
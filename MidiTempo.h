@@ -0,0 +1,103 @@
+/** @file MidiTempo.h
+ *  @brief Tempo map, conversion of ticks to wall clock time
+ *
+ *  This contains the data structures and functions needed to collect
+ *  the Set Tempo events of a file into a tempo map and to convert
+ *  absolute ticks to microseconds from the start of the file.
+ *
+ *  The map is a sorted array of segments, each holding the time at its
+ *  first tick and the length of one tick, so a conversion is a binary
+ *  search and one multiply. Conversions of ticks in increasing order
+ *  can skip the search with tempoSegment().
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#ifndef MIDIBUFFER_H_
+#include "MidiBuffer.h"
+#endif
+
+#ifndef MIDITEMPO_H_
+#define MIDITEMPO_H_
+
+/// @brief Tempo in microseconds per quarter note until the first Set Tempo event, 120 BPM
+#ifndef MIDI_DEFAULT_TEMPO
+#define MIDI_DEFAULT_TEMPO 500000
+#endif
+
+// Data Structures
+/** @struct TempoSegment
+ *  @brief A run of ticks with the same tempo
+ *
+ * Tick is the first tick of the segment, micros the time at that tick.\n
+ * Tempo is the Set Tempo value (microseconds per quarter note) and
+ * microsPerTick the resulting length of one tick.\n
+ */
+struct TempoSegment
+{
+	unsigned long tick;
+	double micros;
+	double microsPerTick;
+	unsigned long tempo;
+};
+
+/** @struct TempoMap
+ *  @brief Tempo segments of a whole file, sorted by tick
+ *
+ * There is always at least one segment, starting at tick 0.\n
+ * Files with an SMPTE time division have a single segment, ticks
+ * have a fixed length and Set Tempo events do not apply.\n
+ */
+struct TempoMap
+{
+	struct TempoSegment *segments;
+	unsigned long count;
+	int smpte;
+};
+
+// Function Prototypes
+int buildTempoMap(struct TempoMap *map, short sTimeDiv, const struct MidiCursor *tracks, int numTracks);
+void freeTempoMap(struct TempoMap *map);
+unsigned long tempoFindSegment(const struct TempoMap *map, unsigned long tick);
+unsigned long tempoMicrosToTick(const struct TempoMap *map, double micros);
+
+/** @fn static inline unsigned long tempoSegment(const struct TempoMap *map, unsigned long seg, unsigned long tick)
+ *  @brief Step a segment index forward to the segment holding tick
+ *
+ * For ticks visited in increasing order, such as the events of one
+ * track, this replaces the binary search of tempoFindSegment().
+ *
+ * @param map: The tempo map
+ * @param seg: Segment of an earlier tick, 0 to start
+ * @param tick: Absolute tick, not before the tick seg was found for
+ * @return The index of the segment holding tick
+ */
+static inline unsigned long tempoSegment(const struct TempoMap *map, unsigned long seg, unsigned long tick)
+{
+	while ((seg + 1 < map->count) && (map->segments[seg + 1].tick <= tick))
+		seg++;
+	return seg;
+}
+
+/** @fn static inline double tempoSegmentMicros(const struct TempoMap *map, unsigned long seg, unsigned long tick)
+ *  @brief Time of a tick within a known segment, in microseconds
+ */
+static inline double tempoSegmentMicros(const struct TempoMap *map, unsigned long seg, unsigned long tick)
+{
+	const struct TempoSegment *s = &map->segments[seg];
+
+	return s->micros + (double)(tick - s->tick) * s->microsPerTick;
+}
+
+/** @fn static inline double tempoTickToMicros(const struct TempoMap *map, unsigned long tick)
+ *  @brief Time of an absolute tick from the start of the file, in microseconds
+ */
+static inline double tempoTickToMicros(const struct TempoMap *map, unsigned long tick)
+{
+	return tempoSegmentMicros(map, tempoFindSegment(map, tick), tick);
+}
+
+#endif
@@ -0,0 +1,232 @@
+/** @file MidiVarLen.c
+ *  @brief Fast decoding of Variable-Length Quantities from memory
+ *
+ *  This contains the bulk decoder for runs of consecutive quantities.
+ *  The end of every quantity in a 16 byte (SSE2) or 32 byte (AVX2)
+ *  block is found with one movemask, the quantities ending in the block
+ *  are then decoded with varLenDecode4(). The AVX2 version is chosen at
+ *  run time when the processor supports it, other processors use the
+ *  scalar loop.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#include <pthread.h>
+
+#ifndef MIDIVARLEN_H_
+#include "MidiVarLen.h"
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MIDI_VARLEN_X86 1
+#endif
+
+/** @fn static size_t scalarVarLen(const unsigned char *p, size_t size, unsigned long *val)
+ *  @brief Decode one quantity a byte at a time, the same loop as readVarLen()
+ *
+ * @return The length of the quantity, 0 if it runs past size
+ */
+static size_t scalarVarLen(const unsigned char *p, size_t size, unsigned long *val)
+{
+    unsigned long v = 0;
+    size_t i;
+
+    for (i = 0; i < size; i++)
+    {
+        v = (v << 7) + (p[i] & 0x7F);
+        if (!(p[i] & 0x80))
+        {
+            *val = v;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/** @fn static inline size_t decodeEnds(const unsigned char *p, size_t size, uint32_t ends, unsigned long *values, size_t *n, size_t count)
+ *  @brief Decode the quantities ending in one block
+ *
+ * @param p: Start of the block, also the start of a quantity
+ * @param size: Bytes readable from p
+ * @param ends: Bit i set if byte i of the block ends a quantity
+ * @param values: Output array
+ * @param n: Number of values in the output array, updated
+ * @param count: Size of the output array
+ * @return The number of bytes consumed, the start of the first quantity not ending in the block
+ */
+static inline size_t decodeEnds(const unsigned char *p, size_t size, uint32_t ends, unsigned long *values, size_t *n, size_t count)
+{
+    size_t start = 0, k;
+
+    while ((ends != 0) && (*n < count))
+    {
+        k = __builtin_ctz(ends);
+        if ((k - start < 4) && (start + 4 <= size))
+            varLenDecode4(p + start, &values[*n]);
+        else
+            scalarVarLen(p + start, k - start + 1, &values[*n]);
+        (*n)++;
+        start = k + 1;
+        ends &= ends - 1;
+    }
+    return start;
+}
+
+/** @fn static size_t decodeTail(const unsigned char *p, size_t size, size_t pos, unsigned long *values, size_t n, size_t count, size_t *used)
+ *  @brief Decode the remaining quantities one at a time
+ */
+static size_t decodeTail(const unsigned char *p, size_t size, size_t pos, unsigned long *values, size_t n, size_t count, size_t *used)
+{
+    size_t len;
+
+    while ((n < count) && (pos < size))
+    {
+        if ((len = scalarVarLen(p + pos, size - pos, &values[n])) == 0)
+            break;
+        pos += len;
+        n++;
+    }
+    *used = pos;
+    return n;
+}
+
+#ifdef MIDI_VARLEN_X86
+/** @fn static size_t decodeBlockSSE2(const unsigned char *p, size_t size, unsigned long *values, size_t count, size_t *used)
+ *  @brief decodeVarLenBlock() 16 bytes at a time
+ */
+static size_t decodeBlockSSE2(const unsigned char *p, size_t size, unsigned long *values, size_t count, size_t *used)
+{
+    size_t pos = 0, n = 0, len;
+    uint32_t ends;
+
+    while ((n < count) && (pos + 16 <= size))
+    {
+        ends = ~_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(p + pos))) & 0xffff;
+        len = decodeEnds(p + pos, size - pos, ends, values, &n, count);
+        if (len == 0)
+        {
+            // A quantity longer than the block
+            if ((len = scalarVarLen(p + pos, size - pos, &values[n])) == 0)
+                break;
+            n++;
+        }
+        pos += len;
+    }
+    return decodeTail(p, size, pos, values, n, count, used);
+}
+
+/** @fn static size_t decodeBlockAVX2(const unsigned char *p, size_t size, unsigned long *values, size_t count, size_t *used)
+ *  @brief decodeVarLenBlock() 32 bytes at a time
+ */
+__attribute__((target("avx2"))) static size_t decodeBlockAVX2(const unsigned char *p, size_t size, unsigned long *values, size_t count, size_t *used)
+{
+    size_t pos = 0, n = 0, len;
+    uint32_t ends;
+
+    while ((n < count) && (pos + 32 <= size))
+    {
+        ends = ~(uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)(p + pos)));
+        len = decodeEnds(p + pos, size - pos, ends, values, &n, count);
+        if (len == 0)
+        {
+            if ((len = scalarVarLen(p + pos, size - pos, &values[n])) == 0)
+                break;
+            n++;
+        }
+        pos += len;
+    }
+    return decodeTail(p, size, pos, values, n, count, used);
+}
+#endif
+
+/** @fn static size_t decodeBlockScalar(const unsigned char *p, size_t size, unsigned long *values, size_t count, size_t *used)
+ *  @brief decodeVarLenBlock() one quantity at a time
+ */
+static size_t decodeBlockScalar(const unsigned char *p, size_t size, unsigned long *values, size_t count, size_t *used)
+{
+    size_t pos = 0, n = 0;
+    int len;
+
+    // Branch-free for quantities of up to 4 bytes while 4 bytes remain
+    while ((n < count) && (pos + 4 <= size))
+    {
+        if ((len = varLenDecode4(p + pos, &values[n])) == 0)
+            break;
+        pos += len;
+        n++;
+    }
+    return decodeTail(p, size, pos, values, n, count, used);
+}
+
+/** @struct VarLenDecoder
+ *  @brief A bulk decoder and its name for reports
+ */
+struct VarLenDecoder
+{
+    const char *name;
+    size_t (*decode)(const unsigned char *p, size_t size, unsigned long *values, size_t count, size_t *used);
+};
+
+static const struct VarLenDecoder decoders[] = {
+    {"scalar", decodeBlockScalar},
+#ifdef MIDI_VARLEN_X86
+    {"sse2", decodeBlockSSE2},
+    {"avx2", decodeBlockAVX2},
+#endif
+};
+
+// The decoder every thread uses, set once by chooseDecoder()
+static const struct VarLenDecoder *chosen;
+static pthread_once_t chosenOnce = PTHREAD_ONCE_INIT;
+
+/** @fn static void chooseDecoder(void)
+ *  @brief Pick the widest decoder the processor supports, unless MIDI_VARLEN forces one
+ */
+static void chooseDecoder(void)
+{
+    const char *force = getenv("MIDI_VARLEN");
+
+    chosen = &decoders[0];
+#ifdef MIDI_VARLEN_X86
+    if ((force != NULL) && (strcmp(force, "scalar") == 0))
+        return;
+    __builtin_cpu_init();
+    chosen = (__builtin_cpu_supports("avx2") && ((force == NULL) || (strcmp(force, "sse2") != 0))) ? &decoders[2] : &decoders[1];
+#else
+    (void)force;
+#endif
+}
+
+/** @fn size_t decodeVarLenBlock(const unsigned char *p, size_t size, unsigned long *values, size_t count, size_t *used)
+ *  @brief Decode a run of consecutive Variable-Length Quantities
+ *
+ * Decoding stops after count values, at the end of the data or before
+ * a quantity that runs past the end, which is not decoded.\n
+ * Setting the environment variable MIDI_VARLEN=scalar or sse2 forces a
+ * decoder, for comparing them. The choice is made once, whichever
+ * thread calls first.
+ *
+ * @param p: The quantities
+ * @param size: Number of bytes at p
+ * @param values: Receives the values
+ * @param count: Most values to decode
+ * @param used: Receives the number of bytes consumed
+ * @return The number of values decoded
+ */
+size_t decodeVarLenBlock(const unsigned char *p, size_t size, unsigned long *values, size_t count, size_t *used)
+{
+    pthread_once(&chosenOnce, chooseDecoder);
+    return chosen->decode(p, size, values, count, used);
+}
+
+/** @fn const char *varLenDecoderName(void)
+ *  @brief Name of the decoder decodeVarLenBlock() uses, for benchmark reports
+ */
+const char *varLenDecoderName(void)
+{
+    pthread_once(&chosenOnce, chooseDecoder);
+    return chosen->name;
+}
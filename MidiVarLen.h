@@ -0,0 +1,56 @@
+/** @file MidiVarLen.h
+ *  @brief Fast decoding of Variable-Length Quantities from memory
+ *
+ *  This contains a branch-free decoder for a single quantity of up to
+ *  4 bytes, used by cursorReadVarLen(), and a bulk decoder for runs of
+ *  consecutive quantities that finds the end of each one 16 or 32 bytes
+ *  at a time with SSE2 or AVX2 movemask, with a scalar fallback.
+ *
+ *  Both give exactly the values of readVarLen(), see there for the
+ *  format, including quantities longer than the 4 bytes the MIDI
+ *  specification allows.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#ifndef MIDIINFO_H_
+#include "MidiInfo.h"
+#endif
+
+#ifndef MIDIVARLEN_H_
+#define MIDIVARLEN_H_
+
+// Function Prototypes
+size_t decodeVarLenBlock(const unsigned char *p, size_t size, unsigned long *values, size_t count, size_t *used);
+const char *varLenDecoderName(void);
+
+/** @fn static inline int varLenDecode4(const unsigned char *p, unsigned long *val)
+ *  @brief Decode a quantity of up to 4 bytes without branching on its bytes
+ *
+ * The four bytes at p are read as one big-endian word, the first byte
+ * with bit 7 clear ends the quantity. The bytes after it are shifted out
+ * and the 7 bit groups are packed together with masks.\n
+ * All four bytes must be readable even when the quantity is shorter.
+ *
+ * @param p: The quantity
+ * @param val: Receives the value
+ * @return The length of the quantity, 1 to 4, or 0 if it is longer than 4 bytes
+ */
+static inline int varLenDecode4(const unsigned char *p, unsigned long *val)
+{
+	uint32_t w = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+	uint32_t ends = ~w & 0x80808080;
+	int len;
+
+	if (ends == 0)
+		return 0;
+	len = __builtin_clz(ends) / 8 + 1;
+	w >>= 8 * (4 - len);
+	*val = (w & 0x7f) | ((w >> 1) & 0x3f80) | ((w >> 2) & 0x1fc000) | ((w >> 3) & 0xfe00000);
+	return len;
+}
+
+#endif
@@ -0,0 +1,111 @@
+/** @file MidiVisitor.c
+ *  @brief Walks a MIDI file held in memory, passing each part to a visitor
+ *
+ *  The file is decoded in order with a cursor: the header chunk, then
+ *  for each track its chunk header, its events and its end. Nothing is
+ *  allocated or printed while walking, a callback that wants text
+ *  formats it itself (see printMidiEvent()).
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#ifndef MIDIVISITOR_H_
+#include "MidiVisitor.h"
+#endif
+
+#ifndef MIDIPROFILE_H_
+#include "MidiProfile.h"
+#endif
+
+/** @fn int visitTrackEvents(const struct MidiVisitor *v, int track, struct MidiCursor *c)
+ *  @brief Pass the events of one track to a visitor
+ *
+ * Decoding stops at the End of Track event or the end of the data, the
+ * same as cursorReadTrackEvents(). onTrackEnd is not called.
+ *
+ * @param v: The callbacks
+ * @param track: Track index passed to the callbacks
+ * @param c: A cursor over the event data of the track
+ * @return 0 at the end of the track, 1 if a callback stopped decoding
+ */
+int visitTrackEvents(const struct MidiVisitor *v, int track, struct MidiCursor *c)
+{
+    struct MidiEvent ev;
+    unsigned long tick = 0;
+    int ret = 0;
+    MIDI_PROFILE_START(start);
+
+    while (cursorReadEvent(c, &ev))
+    {
+        tick += ev.deltaTime;
+        if (visitEvent(v, track, tick, &ev))
+        {
+            ret = 1;
+            break;
+        }
+        if ((ev.status == 0xFF) && (ev.data1 == 0x2f))
+            break;
+    }
+    MIDI_PROFILE_STOP(start, MIDI_PROFILE_DECODE);
+    return ret;
+}
+
+/** @fn int visitMidiBuffer(const struct MidiVisitor *v, const unsigned char *data, size_t size)
+ *  @brief Pass the header, tracks and events of a file in memory to a visitor
+ *
+ * Like cursorIndexTracks(), decoding stops at the first chunk where a
+ * track is expected that is not one, after passing it to onTrack.
+ *
+ * @param v: The callbacks
+ * @param data: The whole file
+ * @param size: Size of the file in bytes
+ * @return 0 if the file was walked to its end, 1 if a callback stopped decoding
+ */
+int visitMidiBuffer(const struct MidiVisitor *v, const unsigned char *data, size_t size)
+{
+    struct MidiCursor c, track;
+    struct MidiHeader midiHead;
+    struct TrackHeader trackHead;
+    int i;
+
+    initCursor(&c, data, size);
+    midiHead = cursorReadMidiChunk(&c);
+    if ((v->onHeader != NULL) && v->onHeader(v->ctx, &midiHead))
+        return 1;
+
+    for (i = 0; i < midiHead.uNumTracks; i++)
+    {
+        trackHead = cursorReadTrackChunk(&c);
+        if ((v->onTrack != NULL) && v->onTrack(v->ctx, i, &trackHead))
+            return 1;
+        if (strcmp(trackHead.cChunkType, MIDI_TRACK_ID) != 0)
+            break;
+        cursorTrackEvents(&c, &trackHead, &track);
+        if (visitTrackEvents(v, i, &track))
+            return 1;
+        if ((v->onTrackEnd != NULL) && v->onTrackEnd(v->ctx, i))
+            return 1;
+    }
+    return 0;
+}
+
+/** @fn int visitMidiFile(const struct MidiVisitor *v, const char *filename)
+ *  @brief Load a file with loadMidiBuffer() and walk it with visitMidiBuffer()
+ *
+ * @param v: The callbacks
+ * @param filename: The MIDI file, - for stdin
+ * @return The result of visitMidiBuffer(), -1 if the file could not be loaded
+ */
+int visitMidiFile(const struct MidiVisitor *v, const char *filename)
+{
+    struct MidiBuffer buf;
+    int ret;
+
+    if (loadMidiBuffer(filename, &buf) != 0)
+        return -1;
+    ret = visitMidiBuffer(v, buf.data, buf.size);
+    freeMidiBuffer(&buf);
+    return ret;
+}
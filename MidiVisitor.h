@@ -0,0 +1,78 @@
+/** @file MidiVisitor.h
+ *  @brief Callbacks receiving the parts of a MIDI file as they are decoded
+ *
+ *  This contains the visitor structure filled in by code that wants
+ *  the header, tracks and events of a file without printing them, the
+ *  helper that hands an event to the right callback and the functions
+ *  walking a file held in memory.
+ *
+ *  This is the entry point of libmidiinfo for embedding the parser:
+ *  decoding a buffer allocates nothing and formats nothing, the
+ *  callbacks see each event as the cursor decodes it.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#ifndef MIDIBUFFER_H_
+#include "MidiBuffer.h"
+#endif
+
+#ifndef MIDIVISITOR_H_
+#define MIDIVISITOR_H_
+
+// Data Structures
+/** @struct MidiVisitor
+ *  @brief Callbacks for the parts of a MIDI file, any of them may be NULL
+ *
+ * Ctx is passed back to every callback unchanged.\n
+ * onHeader receives the MIDI header chunk, whatever its id.\n
+ * onTrack receives the header of each chunk where a track is expected,
+ * check its cChunkType, and onTrackEnd follows the last event of a track.\n
+ * Events are given with their track index and absolute tick:
+ * - onChannelEvent for MIDI events, status 0x80-0xEF, and for data bytes
+ *   found without any running status (status below 0x80)
+ * - onMeta for Meta events, status 0xFF
+ * - onSysEx for SysEx events, 0xF0/0xF7, and other System messages\n
+ *
+ * Event payloads point into the data being decoded, copy them to keep
+ * them past the callback.\n
+ * A callback returning non-zero stops decoding.\n
+ */
+struct MidiVisitor
+{
+	void *ctx;
+	int (*onHeader)(void *ctx, const struct MidiHeader *midiHead);
+	int (*onTrack)(void *ctx, int track, const struct TrackHeader *trackHead);
+	int (*onChannelEvent)(void *ctx, int track, unsigned long tick, const struct MidiEvent *ev);
+	int (*onMeta)(void *ctx, int track, unsigned long tick, const struct MidiEvent *ev);
+	int (*onSysEx)(void *ctx, int track, unsigned long tick, const struct MidiEvent *ev);
+	int (*onTrackEnd)(void *ctx, int track);
+};
+
+// Function Prototypes
+int visitTrackEvents(const struct MidiVisitor *v, int track, struct MidiCursor *c);
+int visitMidiBuffer(const struct MidiVisitor *v, const unsigned char *data, size_t size);
+int visitMidiFile(const struct MidiVisitor *v, const char *filename);
+
+/** @fn static inline int visitEvent(const struct MidiVisitor *v, int track, unsigned long tick, const struct MidiEvent *ev)
+ *  @brief Hand an event to the callback for its kind
+ *
+ * @return The callback's return value, 0 if there is no callback
+ */
+static inline int visitEvent(const struct MidiVisitor *v, int track, unsigned long tick, const struct MidiEvent *ev)
+{
+	int (*cb)(void *, int, unsigned long, const struct MidiEvent *);
+
+	if (ev->status == 0xFF)
+		cb = v->onMeta;
+	else if (ev->status >= 0xF0)
+		cb = v->onSysEx;
+	else
+		cb = v->onChannelEvent;
+	return (cb != NULL) ? cb(v->ctx, track, tick, ev) : 0;
+}
+
+#endif
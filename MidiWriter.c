@@ -0,0 +1,214 @@
+/** @file MidiWriter.c
+ *  @brief Buffered Standard MIDI File writer
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#ifndef MIDIWRITER_H_
+#include "MidiWriter.h"
+#endif
+
+/// @brief Largest encoding of an event apart from its payload: delta time, status, type and length
+#define MIDI_WRITER_EVENT_MAX 24
+
+/** @fn static int reserveTrack(struct MidiTrackWriter *t, size_t n)
+ *  @brief Make room for n more bytes of track data
+ *
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+static int reserveTrack(struct MidiTrackWriter *t, size_t n)
+{
+    size_t capacity;
+    void *p;
+
+    if (t->error)
+        return -1;
+    if (t->capacity - t->size >= n)
+        return 0;
+    capacity = t->capacity ? t->capacity : 4096;
+    while (capacity - t->size < n)
+        capacity *= 2;
+    if ((p = realloc(t->data, capacity)) == NULL)
+    {
+        t->error = 1;
+        return -1;
+    }
+    t->data = (unsigned char *)p;
+    t->capacity = capacity;
+    return 0;
+}
+
+/** @fn void initMidiTrackWriter(struct MidiTrackWriter *t)
+ *  @brief Start an empty track
+ */
+void initMidiTrackWriter(struct MidiTrackWriter *t)
+{
+    t->data = NULL;
+    t->size = 0;
+    t->capacity = 0;
+    t->runningStatus = 0;
+    t->error = 0;
+}
+
+/** @fn void resetMidiTrackWriter(struct MidiTrackWriter *t)
+ *  @brief Empty a track to encode the next one, keeping its memory
+ */
+void resetMidiTrackWriter(struct MidiTrackWriter *t)
+{
+    t->size = 0;
+    t->runningStatus = 0;
+    t->error = 0;
+}
+
+/** @fn int writeMidiEvent(struct MidiTrackWriter *t, const struct MidiEvent *ev)
+ *  @brief Encode an event at the end of a track
+ *
+ * The event is encoded from its fields as cursorReadEvent() fills them
+ * in, its delta time is relative to the event before it. A status below
+ * 0x80, a data byte that was read without any running status, is
+ * written back as that single byte.
+ *
+ * @param t: The track
+ * @param ev: The event
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+int writeMidiEvent(struct MidiTrackWriter *t, const struct MidiEvent *ev)
+{
+    const struct MidiStatus *status = &midiStatusTable[ev->status];
+    unsigned char *p;
+
+    if (reserveTrack(t, MIDI_WRITER_EVENT_MAX + ev->length) != 0)
+        return -1;
+    p = t->data + t->size;
+    p += putVarLen(p, ev->deltaTime);
+    switch (status->kind)
+    {
+    case MIDI_STATUS_CHANNEL:
+        if (ev->status != t->runningStatus)
+            *p++ = ev->status;
+        t->runningStatus = ev->status;
+        *p++ = ev->data1;
+        if (status->length == 2)
+            *p++ = ev->data2;
+        break;
+    case MIDI_STATUS_META:
+        t->runningStatus = 0;
+        *p++ = 0xFF;
+        *p++ = ev->data1;
+        p += putVarLen(p, ev->length);
+        if (ev->length > 0)
+            memcpy(p, ev->data, ev->length);
+        p += ev->length;
+        break;
+    case MIDI_STATUS_SYSEX:
+        t->runningStatus = 0;
+        *p++ = ev->status;
+        p += putVarLen(p, ev->length);
+        if (ev->length > 0)
+            memcpy(p, ev->data, ev->length);
+        p += ev->length;
+        break;
+    case MIDI_STATUS_SYSTEM:
+        t->runningStatus = 0;
+        *p++ = ev->status;
+        if (status->length > 0)
+            *p++ = ev->data1;
+        if (status->length > 1)
+            *p++ = ev->data2;
+        break;
+    default:
+        *p++ = ev->status;
+        break;
+    }
+    t->size = p - t->data;
+    return 0;
+}
+
+/** @fn void freeMidiTrackWriter(struct MidiTrackWriter *t)
+ *  @brief Release the encoded data of a track
+ */
+void freeMidiTrackWriter(struct MidiTrackWriter *t)
+{
+    free(t->data);
+    initMidiTrackWriter(t);
+}
+
+/** @fn static void outU32(struct MidiOutput *o, uint32_t val)
+ *  @brief Append a big-endian 32 bit value
+ */
+static void outU32(struct MidiOutput *o, uint32_t val)
+{
+    char b[4];
+
+    b[0] = val >> 24;
+    b[1] = val >> 16;
+    b[2] = val >> 8;
+    b[3] = val;
+    outBytes(o, b, 4);
+}
+
+/** @fn int openMidiWriter(struct MidiWriter *w, FILE *f, int format, int numTracks, short sTimeDiv)
+ *  @brief Start a MIDI file and write its header chunk
+ *
+ * @param w: The writer
+ * @param f: The stream to write to, opened in binary mode
+ * @param format: MIDI format, 0, 1 or 2
+ * @param numTracks: Number of track chunks that will follow
+ * @param sTimeDiv: Time division, as read from the MIDI header
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+int openMidiWriter(struct MidiWriter *w, FILE *f, int format, int numTracks, short sTimeDiv)
+{
+    char head[6];
+
+    w->tracks = 0;
+    if (openMidiOutput(&w->o, f) != 0)
+        return -1;
+    head[0] = format >> 8;
+    head[1] = format;
+    head[2] = numTracks >> 8;
+    head[3] = numTracks;
+    head[4] = (uint16_t)sTimeDiv >> 8;
+    head[5] = sTimeDiv;
+    outBytes(&w->o, MIDI_HEADER_ID, 4);
+    outU32(&w->o, 6);
+    outBytes(&w->o, head, 6);
+    return 0;
+}
+
+/** @fn void writeMidiTrackChunk(struct MidiWriter *w, const unsigned char *data, size_t size)
+ *  @brief Write a track chunk holding the given event data
+ *
+ * The data is either the data of a struct MidiTrackWriter or the event
+ * data of an unchanged track as it was read, which is copied unchanged.
+ *
+ * @param w: The writer
+ * @param data: The event data of the track
+ * @param size: Number of bytes of event data
+ */
+void writeMidiTrackChunk(struct MidiWriter *w, const unsigned char *data, size_t size)
+{
+    if (size > UINT32_MAX)
+    {
+        w->o.error = 1;
+        return;
+    }
+    outBytes(&w->o, MIDI_TRACK_ID, 4);
+    outU32(&w->o, size);
+    outBytes(&w->o, (const char *)data, size);
+    w->tracks++;
+}
+
+/** @fn int closeMidiWriter(struct MidiWriter *w)
+ *  @brief Write out what is buffered and release the writer
+ *
+ * The stream itself is left open.
+ *
+ * @return 0 on success, -1 if anything could not be written
+ */
+int closeMidiWriter(struct MidiWriter *w)
+{
+    return closeMidiOutput(&w->o);
+}
@@ -0,0 +1,91 @@
+/** @file MidiWriter.h
+ *  @brief Buffered Standard MIDI File writer
+ *
+ *  This contains the data structures and functions needed to write a
+ *  MIDI file: the header chunk, then one track chunk per track, either
+ *  encoded from decoded events or copied from existing track data.
+ *
+ *  Events are encoded as compactly as the format allows: delta times
+ *  and lengths use the shortest Variable-Length Quantity, and the
+ *  status byte of a MIDI event is left out when it repeats the running
+ *  status. Meta and SysEx events cancel running status, as the
+ *  specification requires, so the output is read the same way by
+ *  strict readers and by cursorReadEvent().
+ *
+ *  A track that was not changed should be written with
+ *  writeMidiTrackChunk() straight from the data it was read from, it
+ *  is then copied byte for byte and not encoded again.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+// Includes
+#ifndef MIDIBUFFER_H_
+#include "MidiBuffer.h"
+#endif
+
+#ifndef MIDIWRITER_H_
+#define MIDIWRITER_H_
+
+// Data Structures
+/** @struct MidiTrackWriter
+ *  @brief The encoded events of one track, before they are written as a chunk
+ *
+ * Running status is the status byte a MIDI event may leave out, 0 if none.\n
+ * Error is set when memory could not be allocated, later events are dropped.\n
+ */
+struct MidiTrackWriter
+{
+	unsigned char *data;
+	size_t size, capacity;
+	unsigned char runningStatus;
+	int error;
+};
+
+/** @struct MidiWriter
+ *  @brief A MIDI file being written
+ *
+ * Tracks counts the track chunks written so far.\n
+ */
+struct MidiWriter
+{
+	struct MidiOutput o;
+	int tracks;
+};
+
+// Function Prototypes
+void initMidiTrackWriter(struct MidiTrackWriter *t);
+void resetMidiTrackWriter(struct MidiTrackWriter *t);
+int writeMidiEvent(struct MidiTrackWriter *t, const struct MidiEvent *ev);
+void freeMidiTrackWriter(struct MidiTrackWriter *t);
+
+int openMidiWriter(struct MidiWriter *w, FILE *f, int format, int numTracks, short sTimeDiv);
+void writeMidiTrackChunk(struct MidiWriter *w, const unsigned char *data, size_t size);
+int closeMidiWriter(struct MidiWriter *w);
+
+/** @fn static inline size_t putVarLen(unsigned char *p, unsigned long val)
+ *  @brief Encode a Variable-Length Quantity in as few bytes as possible
+ *
+ * Values above 0x0FFFFFFF take more than the 4 bytes the specification
+ * allows, readVarLen() still reads them back.
+ *
+ * @param p: Receives the quantity, up to 10 bytes
+ * @param val: The value
+ * @return The length of the quantity
+ */
+static inline size_t putVarLen(unsigned char *p, unsigned long val)
+{
+	unsigned char tmp[10];
+	size_t n = 0, i;
+
+	tmp[n++] = val & 0x7F;
+	while ((val >>= 7) != 0)
+		tmp[n++] = 0x80 | (val & 0x7F);
+	for (i = 0; i < n; i++)
+		p[i] = tmp[n - 1 - i];
+	return n;
+}
+
+#endif
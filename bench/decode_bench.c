@@ -0,0 +1,221 @@
+/** @file decode_bench.c
+ *  @brief Decode throughput of the FILE and cursor based parsers
+ *
+ *  Decodes the MIDI file supplied as an argument repeatedly with
+ *  - readTrackEvents(), the FILE based parser
+ *  - cursorReadTrackEvents(), the memory mapped cursor parser with
+ *    the buffered formatter of MidiOutput.h
+ *  - cursorReadEvent() alone, the cursor parser without any printing
+ *  - visitMidiFile() with a callback counting events, the library API
+ *  - decodeMidiTracksParallel(), decoding to memory one track per thread
+ *
+ *  and reports MB/sec and events/sec for each. Printed output is
+ *  sent to /dev/null so only decoding and formatting are measured.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef MIDIBUFFER_H_
+#include "MidiBuffer.h"
+#endif
+
+#ifndef MIDIVISITOR_H_
+#include "MidiVisitor.h"
+#endif
+
+#ifndef MIDISTORE_H_
+#include "MidiStore.h"
+#endif
+
+/// @brief Default number of passes over the file
+#ifndef BENCH_ITERATIONS
+#define BENCH_ITERATIONS 5
+#endif
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, double secs, size_t bytes, unsigned long events, int iterations)
+{
+    printf("%-24s %8.3f s  %10.2f MB/s  %12.0f events/s\n", name, secs,
+           (double)bytes * iterations / secs / (1024.0 * 1024.0), (double)events * iterations / secs);
+}
+
+// Legacy parser, one pass over the file
+static void runStdio(const char *filename)
+{
+    FILE *f;
+    struct MidiHeader midiHead;
+    struct TrackHeader trackHead;
+    int i;
+
+    f = fopen(filename, "rb");
+    if (f == NULL)
+        return;
+    midiHead = readMidiChunk(f);
+    for (i = 0; i < midiHead.uNumTracks; i++)
+    {
+        trackHead = readTrackChunk(f);
+        if (strcmp(trackHead.cChunkType, MIDI_TRACK_ID) != 0)
+            break;
+        readTrackEvents(f);
+    }
+    fclose(f);
+}
+
+// Cursor parser, one pass over the file, printing when out is set
+static unsigned long runCursor(const char *filename, struct MidiOutput *out)
+{
+    struct MidiBuffer buf;
+    struct MidiCursor c, track;
+    struct MidiHeader midiHead;
+    struct TrackHeader trackHead;
+    unsigned long events = 0;
+    int i;
+
+    if (loadMidiBuffer(filename, &buf) != 0)
+        return 0;
+    initCursor(&c, buf.data, buf.size);
+    midiHead = cursorReadMidiChunk(&c);
+    for (i = 0; i < midiHead.uNumTracks; i++)
+    {
+        trackHead = cursorReadTrackChunk(&c);
+        if (strcmp(trackHead.cChunkType, MIDI_TRACK_ID) != 0)
+            break;
+        cursorTrackEvents(&c, &trackHead, &track);
+        events += cursorReadTrackEvents(&track, out);
+    }
+    freeMidiBuffer(&buf);
+    return events;
+}
+
+// Visitor callback, counts every event
+static int countEvent(void *ctx, int track, unsigned long tick, const struct MidiEvent *ev)
+{
+    (void)track;
+    (void)tick;
+    (void)ev;
+    (*(unsigned long *)ctx)++;
+    return 0;
+}
+
+// Decode into memory, one pass over the file
+static void runStore(const char *filename, int numWorkers)
+{
+    struct MidiBuffer buf;
+    struct MidiCursor c;
+    struct MidiHeader midiHead;
+
+    if (loadMidiBuffer(filename, &buf) != 0)
+        return;
+    initCursor(&c, buf.data, buf.size);
+    midiHead = cursorReadMidiChunk(&c);
+    decodeMidiTracksParallel(&c, &midiHead, numWorkers);
+    freeMidiTracks(&midiHead);
+    freeMidiBuffer(&buf);
+}
+
+int main(int argc, char **argv)
+{
+    struct MidiBuffer buf;
+    struct MidiOutput o;
+    FILE *devNull;
+    unsigned long events, visited = 0;
+    struct MidiVisitor counter = {&visited, NULL, NULL, countEvent, countEvent, countEvent, NULL};
+    size_t bytes;
+    double t;
+    int i, iterations = BENCH_ITERATIONS, savedStdout;
+
+    if ((argc < 2) || (argc > 3))
+    {
+        printf("Usage: %s filename [iterations]\n", argv[0]);
+        return 0;
+    }
+    if (argc == 3)
+        iterations = atoi(argv[2]);
+    if (iterations < 1)
+        iterations = 1;
+
+    if (loadMidiBuffer(argv[1], &buf) != 0)
+    {
+        printf("Unable to open file: %s\n", argv[1]);
+        return 1;
+    }
+    bytes = buf.size;
+    freeMidiBuffer(&buf);
+
+    devNull = fopen("/dev/null", "w");
+    if (devNull == NULL)
+    {
+        perror("Unable to open /dev/null");
+        return 1;
+    }
+
+    // Count events once, this also warms the page cache
+    events = runCursor(argv[1], NULL);
+    printf("%s: %zu bytes, %lu events, %d iterations\n", argv[1], bytes, events, iterations);
+
+    // readTrackEvents() always prints to stdout, point it at /dev/null
+    fflush(stdout);
+    savedStdout = dup(STDOUT_FILENO);
+    dup2(fileno(devNull), STDOUT_FILENO);
+    t = now();
+    for (i = 0; i < iterations; i++)
+        runStdio(argv[1]);
+    fflush(stdout);
+    t = now() - t;
+    freeMidiPayloads();
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+    report("stdio + printf", t, bytes, events, iterations);
+
+    if (openMidiOutput(&o, devNull) != 0)
+    {
+        printf("Error allocating memory for output buffer\n");
+        return 1;
+    }
+    t = now();
+    for (i = 0; i < iterations; i++)
+        runCursor(argv[1], &o);
+    closeMidiOutput(&o);
+    t = now() - t;
+    report("cursor + MidiOutput", t, bytes, events, iterations);
+
+    t = now();
+    for (i = 0; i < iterations; i++)
+        runCursor(argv[1], NULL);
+    t = now() - t;
+    report("cursor decode only", t, bytes, events, iterations);
+
+    t = now();
+    for (i = 0; i < iterations; i++)
+        visitMidiFile(&counter, argv[1]);
+    t = now() - t;
+    report("visitor, counting", t, bytes, events, iterations);
+
+    t = now();
+    for (i = 0; i < iterations; i++)
+        runStore(argv[1], 1);
+    t = now() - t;
+    report("store, 1 thread", t, bytes, events, iterations);
+
+    t = now();
+    for (i = 0; i < iterations; i++)
+        runStore(argv[1], 0);
+    t = now() - t;
+    report("store, all threads", t, bytes, events, iterations);
+
+    fclose(devNull);
+    return 0;
+}
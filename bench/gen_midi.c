@@ -0,0 +1,390 @@
+/** @file gen_midi.c
+ *  @brief Reproducible synthetic MIDI file generator for the benchmarks
+ *
+ *  Writes a Standard MIDI File with a configurable number of tracks,
+ *  events per track, mix of MIDI event types, running status density,
+ *  SysEx size and amount of text events. The same options and seed
+ *  always give the same file, so benchmark runs can be compared.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// @brief Number of MIDI event kinds in the event mix
+#define GEN_KINDS 5
+
+/// @brief Most notes left sounding per track before one is released
+#define GEN_OPEN_NOTES 8
+
+/** @struct GenOptions
+ *  @brief Generator settings, see usage()
+ */
+struct GenOptions
+{
+    int tracks;
+    long events;
+    int runningStatus;
+    long sysexSize;
+    int sysexCount;
+    int textCount;
+    int textLength;
+    int mix[GEN_KINDS];
+    int format;
+    int division;
+    uint64_t seed;
+};
+
+/** @struct GenTrack
+ *  @brief A track being built in memory
+ */
+struct GenTrack
+{
+    unsigned char *data;
+    size_t size, capacity;
+    unsigned char runningStatus;
+};
+
+static uint64_t rngState;
+
+// xorshift64*, the same seed gives the same file on every platform
+static uint32_t rng(void)
+{
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return (uint32_t)((rngState * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [options] output.mid\n", name);
+    printf("  -t tracks      Number of tracks (default 16)\n");
+    printf("  -e events      MIDI events per track (default 20000)\n");
+    printf("  -r percent     Chance that a repeated status uses running status (default 80)\n");
+    printf("  -m n,c,b,p,a   Event mix weights: note, controller, pitch bend, program, aftertouch (default 70,15,10,3,2)\n");
+    printf("  -T count       Text events per track (default 4)\n");
+    printf("  -L length      Length of each text event (default 24)\n");
+    printf("  -X count       SysEx events per track (default 0)\n");
+    printf("  -x bytes       Size of each SysEx event (default 64)\n");
+    printf("  -f format      SMF format 0 or 1 (default 1, format 0 forces one track)\n");
+    printf("  -d division    Ticks per quarter note (default 480)\n");
+    printf("  -s seed        Random seed (default 1)\n");
+}
+
+static void put(struct GenTrack *t, const void *p, size_t n)
+{
+    void *q;
+
+    if (t->size + n > t->capacity)
+    {
+        t->capacity = (t->capacity ? t->capacity : 4096) * 2 + n;
+        if ((q = realloc(t->data, t->capacity)) == NULL)
+        {
+            perror("gen_midi");
+            exit(1);
+        }
+        t->data = (unsigned char *)q;
+    }
+    memcpy(t->data + t->size, p, n);
+    t->size += n;
+}
+
+static void putByte(struct GenTrack *t, unsigned char b)
+{
+    put(t, &b, 1);
+}
+
+static void putVarLen(struct GenTrack *t, unsigned long val)
+{
+    unsigned char buf[5];
+    int n = sizeof(buf);
+
+    buf[--n] = val & 0x7f;
+    while ((val >>= 7) != 0)
+        buf[--n] = (val & 0x7f) | 0x80;
+    put(t, buf + n, sizeof(buf) - n);
+}
+
+// Mostly zero or short deltas, the odd long gap
+static unsigned long randomDelta(void)
+{
+    uint32_t r = rng() % 100;
+
+    if (r < 45)
+        return 0;
+    if (r < 85)
+        return rng() % 128;
+    if (r < 98)
+        return rng() % 16384;
+    return rng() % 2097152;
+}
+
+static void putMeta(struct GenTrack *t, unsigned long delta, unsigned char type, const void *data, unsigned long length)
+{
+    putVarLen(t, delta);
+    putByte(t, 0xFF);
+    putByte(t, type);
+    putVarLen(t, length);
+    put(t, data, length);
+}
+
+// A channel event, status byte left out when running status applies and is chosen
+static void putChannelEvent(struct GenTrack *t, const struct GenOptions *opts, unsigned long delta,
+                            unsigned char status, unsigned char d1, unsigned char d2, int length)
+{
+    putVarLen(t, delta);
+    if ((status != t->runningStatus) || ((int)(rng() % 100) >= opts->runningStatus))
+        putByte(t, status);
+    t->runningStatus = status;
+    putByte(t, d1 & 0x7f);
+    if (length == 2)
+        putByte(t, d2 & 0x7f);
+}
+
+static void putText(struct GenTrack *t, const struct GenOptions *opts, unsigned long delta)
+{
+    static const unsigned char types[] = {0x01, 0x05, 0x06, 0x07};
+    static const char letters[] = "abcdefghijklmnopqrstuvwxyz ";
+    char *text;
+    int i;
+
+    text = (char *)malloc(opts->textLength + 1);
+    if (text == NULL)
+        return;
+    for (i = 0; i < opts->textLength; i++)
+        text[i] = letters[rng() % (sizeof(letters) - 1)];
+    putMeta(t, delta, types[rng() % sizeof(types)], text, opts->textLength);
+    free(text);
+}
+
+// F0, length, data, F7, the length counts the closing F7
+static void putSysEx(struct GenTrack *t, const struct GenOptions *opts, unsigned long delta)
+{
+    long i;
+
+    putVarLen(t, delta);
+    putByte(t, 0xF0);
+    putVarLen(t, opts->sysexSize + 1);
+    putByte(t, 0x43); // Manufacturer ID
+    for (i = 1; i < opts->sysexSize; i++)
+        putByte(t, rng() & 0x7f);
+    putByte(t, 0xF7);
+    t->runningStatus = 0;
+}
+
+static void genTrack(struct GenTrack *t, const struct GenOptions *opts, int index)
+{
+    unsigned char openNotes[GEN_OPEN_NOTES], channel, tempo[3] = {0x07, 0xA1, 0x20}, timeSig[4] = {4, 2, 24, 8};
+    char name[32];
+    long e, text = 0, sysex = 0, every;
+    int i, kind, weight, total = 0, numOpen = 0;
+
+    sprintf(name, "Track %d", index);
+    putMeta(t, 0, 0x03, name, strlen(name));
+    if (index == 0)
+    {
+        putMeta(t, 0, 0x51, tempo, sizeof(tempo));
+        putMeta(t, 0, 0x58, timeSig, sizeof(timeSig));
+    }
+
+    for (i = 0; i < GEN_KINDS; i++)
+        total += opts->mix[i];
+    channel = index % 16;
+    every = opts->events / (opts->textCount + opts->sysexCount + 1) + 1;
+
+    for (e = 0; e < opts->events; e++)
+    {
+        if ((e % every == every - 1) && (text < opts->textCount))
+        {
+            putText(t, opts, randomDelta());
+            text++;
+        }
+        else if ((e % every == every / 2) && (sysex < opts->sysexCount))
+        {
+            putSysEx(t, opts, randomDelta());
+            sysex++;
+        }
+
+        weight = total ? rng() % total : 0;
+        for (kind = 0; (kind < GEN_KINDS - 1) && (weight >= opts->mix[kind]); kind++)
+            weight -= opts->mix[kind];
+
+        // Stay on the track's channel most of the time so running status has a chance
+        if (rng() % 16 == 0)
+            channel = rng() % 16;
+        switch (kind)
+        {
+        case 0:
+            if ((numOpen < GEN_OPEN_NOTES) && ((numOpen == 0) || (rng() & 1)))
+            {
+                openNotes[numOpen] = 36 + rng() % 60;
+                putChannelEvent(t, opts, randomDelta(), 0x90 | channel, openNotes[numOpen], 1 + rng() % 127, 2);
+                numOpen++;
+            }
+            else
+            {
+                // Release the oldest note, as a Note Off or a Note On with velocity 0
+                if (rng() & 1)
+                    putChannelEvent(t, opts, randomDelta(), 0x80 | channel, openNotes[0], 64, 2);
+                else
+                    putChannelEvent(t, opts, randomDelta(), 0x90 | channel, openNotes[0], 0, 2);
+                memmove(openNotes, openNotes + 1, --numOpen);
+            }
+            break;
+        case 1:
+            putChannelEvent(t, opts, randomDelta(), 0xB0 | channel, rng() % 120, rng(), 2);
+            break;
+        case 2:
+            putChannelEvent(t, opts, randomDelta(), 0xE0 | channel, rng(), rng(), 2);
+            break;
+        case 3:
+            putChannelEvent(t, opts, randomDelta(), 0xC0 | channel, rng(), 0, 1);
+            break;
+        default:
+            if (rng() & 1)
+                putChannelEvent(t, opts, randomDelta(), 0xD0 | channel, rng(), 0, 1);
+            else
+                putChannelEvent(t, opts, randomDelta(), 0xA0 | channel, 36 + rng() % 60, rng(), 2);
+            break;
+        }
+    }
+    putMeta(t, 0, 0x2F, NULL, 0);
+}
+
+static void putUInt32(FILE *f, uint32_t val)
+{
+    fputc(val >> 24, f);
+    fputc(val >> 16, f);
+    fputc(val >> 8, f);
+    fputc(val, f);
+}
+
+static void putUInt16(FILE *f, uint16_t val)
+{
+    fputc(val >> 8, f);
+    fputc(val, f);
+}
+
+static int parseMix(const char *s, int *mix)
+{
+    char *end;
+    int i;
+
+    for (i = 0; i < GEN_KINDS; i++)
+    {
+        mix[i] = strtol(s, &end, 10);
+        if ((end == s) || (mix[i] < 0))
+            return -1;
+        s = end;
+        if (*s == ',')
+            s++;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct GenOptions opts = {16, 20000, 80, 64, 0, 4, 24, {70, 15, 10, 3, 2}, 1, 480, 1};
+    struct GenTrack t;
+    FILE *f;
+    int i, opt;
+
+    while ((opt = getopt(argc, argv, "t:e:r:m:T:L:X:x:f:d:s:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            opts.tracks = atoi(optarg);
+            break;
+        case 'e':
+            opts.events = atol(optarg);
+            break;
+        case 'r':
+            opts.runningStatus = atoi(optarg);
+            break;
+        case 'm':
+            if (parseMix(optarg, opts.mix) != 0)
+            {
+                printf("Bad event mix: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'T':
+            opts.textCount = atoi(optarg);
+            break;
+        case 'L':
+            opts.textLength = atoi(optarg);
+            break;
+        case 'X':
+            opts.sysexCount = atoi(optarg);
+            break;
+        case 'x':
+            opts.sysexSize = atol(optarg);
+            break;
+        case 'f':
+            opts.format = atoi(optarg);
+            break;
+        case 'd':
+            opts.division = atoi(optarg);
+            break;
+        case 's':
+            opts.seed = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+            return 0;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        usage(argv[0]);
+        return 0;
+    }
+    if (opts.format == 0)
+        opts.tracks = 1;
+    if ((opts.tracks < 1) || (opts.tracks > 65535) || (opts.events < 0) || (opts.textLength < 0) ||
+        (opts.sysexSize < 1) || (opts.division < 1) || (opts.division > 0x7fff))
+    {
+        printf("Option out of range\n");
+        return 1;
+    }
+    rngState = opts.seed ? opts.seed : 1;
+
+    f = fopen(argv[optind], "wb");
+    if (f == NULL)
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+    fwrite("MThd", 1, 4, f);
+    putUInt32(f, 6);
+    putUInt16(f, opts.format);
+    putUInt16(f, opts.tracks);
+    putUInt16(f, opts.division);
+
+    memset(&t, 0, sizeof(t));
+    for (i = 0; i < opts.tracks; i++)
+    {
+        t.size = 0;
+        t.runningStatus = 0;
+        genTrack(&t, &opts, i);
+        fwrite("MTrk", 1, 4, f);
+        putUInt32(f, t.size);
+        fwrite(t.data, 1, t.size, f);
+    }
+    free(t.data);
+
+    if (fclose(f) != 0)
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+    return 0;
+}
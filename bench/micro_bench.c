@@ -0,0 +1,398 @@
+/** @file micro_bench.c
+ *  @brief Micro-benchmarks of the low level readers
+ *
+ *  Times, each on its own,
+ *  - readVarLen(), cursorReadVarLen() and decodeVarLenBlock() over a
+ *    block of variable length quantities with a realistic mix of 1 to 4
+ *    byte values
+ *  - readMidiChunk()/readTrackChunk() and their cursor versions over the
+ *    chunk headers of the MIDI file supplied as an argument
+ *  - readTrackEvents() and cursorReadEvent() over its track events
+ *  - seeking to evenly spaced ticks of every track, decoding from the
+ *    start of the track and from the checkpoints of midiSeekTick()
+ *
+ *  and reports values, chunks or events per second and MB/sec.
+ *  See decode_bench.c for whole-file decoding and printing.
+ *
+ *  @author Darren Eckert
+ *  @version 0.2
+ *  @bug No known bugs currently.
+ */
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef MIDIBUFFER_H_
+#include "MidiBuffer.h"
+#endif
+
+#ifndef MIDIVARLEN_H_
+#include "MidiVarLen.h"
+#endif
+
+#ifndef MIDISEEK_H_
+#include "MidiSeek.h"
+#endif
+
+/// @brief Default number of passes over each input
+#ifndef BENCH_ITERATIONS
+#define BENCH_ITERATIONS 5
+#endif
+
+/// @brief Number of values in the variable length quantity block
+#ifndef BENCH_VLQ_VALUES
+#define BENCH_VLQ_VALUES (1 << 22)
+#endif
+
+/// @brief Number of seeks per track and iteration
+#ifndef BENCH_SEEKS
+#define BENCH_SEEKS 16
+#endif
+
+/// @brief Chunk headers are few, scan them this many times per iteration
+#ifndef BENCH_CHUNK_REPEAT
+#define BENCH_CHUNK_REPEAT 1000
+#endif
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, const char *unit, double secs, size_t bytes, unsigned long items, int iterations)
+{
+    printf("%-28s %8.3f s  %10.2f MB/s  %12.0f %s/s\n", name, secs,
+           (double)bytes * iterations / secs / (1024.0 * 1024.0), (double)items * iterations / secs, unit);
+}
+
+// Fixed seed so the block is the same on every run
+static unsigned long vlqRandom(unsigned long *state)
+{
+    *state = *state * 6364136223846793005UL + 1442695040888963407UL;
+    return *state >> 33;
+}
+
+/** @fn static unsigned char *makeVarLenBlock(unsigned long count, size_t *size, unsigned long *sum)
+ *  @brief Encode count values, 60% 1 byte, 30% 2 bytes, 8% 3 bytes and 2% 4 bytes long
+ */
+static unsigned char *makeVarLenBlock(unsigned long count, size_t *size, unsigned long *sum)
+{
+    unsigned char *block, *p, buf[4];
+    unsigned long i, val, state = 1, r;
+    int n;
+
+    block = (unsigned char *)malloc(count * 4);
+    if (block == NULL)
+        return NULL;
+    p = block;
+    *sum = 0;
+    for (i = 0; i < count; i++)
+    {
+        r = vlqRandom(&state) % 100;
+        if (r < 60)
+            val = vlqRandom(&state) % 0x80;
+        else if (r < 90)
+            val = 0x80 + vlqRandom(&state) % (0x4000 - 0x80);
+        else if (r < 98)
+            val = 0x4000 + vlqRandom(&state) % (0x200000 - 0x4000);
+        else
+            val = 0x200000 + vlqRandom(&state) % (0x10000000 - 0x200000);
+        *sum += val;
+
+        n = sizeof(buf);
+        buf[--n] = val & 0x7f;
+        while ((val >>= 7) != 0)
+            buf[--n] = (val & 0x7f) | 0x80;
+        memcpy(p, buf + n, sizeof(buf) - n);
+        p += sizeof(buf) - n;
+    }
+    *size = p - block;
+    return block;
+}
+
+static void benchVarLen(int iterations)
+{
+    unsigned char *block;
+    unsigned long i, sum, check, *values;
+    struct MidiCursor c;
+    char name[32];
+    size_t size, used;
+    double t;
+    FILE *f;
+    int k;
+
+    block = makeVarLenBlock(BENCH_VLQ_VALUES, &size, &sum);
+    if (block == NULL)
+        return;
+    f = fmemopen(block, size, "rb");
+    if (f == NULL)
+    {
+        free(block);
+        return;
+    }
+
+    t = now();
+    for (k = 0; k < iterations; k++)
+    {
+        rewind(f);
+        for (check = 0, i = 0; i < BENCH_VLQ_VALUES; i++)
+            check += readVarLen(f);
+    }
+    t = now() - t;
+    report("readVarLen", "values", t, size, BENCH_VLQ_VALUES, iterations);
+    if (check != sum)
+        printf("   readVarLen checksum mismatch\n");
+
+    t = now();
+    for (k = 0; k < iterations; k++)
+    {
+        initCursor(&c, block, size);
+        for (check = 0, i = 0; i < BENCH_VLQ_VALUES; i++)
+            check += cursorReadVarLen(&c);
+    }
+    t = now() - t;
+    report("cursorReadVarLen", "values", t, size, BENCH_VLQ_VALUES, iterations);
+    if (check != sum)
+        printf("   cursorReadVarLen checksum mismatch\n");
+
+    values = (unsigned long *)malloc(BENCH_VLQ_VALUES * sizeof(unsigned long));
+    if (values != NULL)
+    {
+        t = now();
+        for (k = 0; k < iterations; k++)
+            decodeVarLenBlock(block, size, values, BENCH_VLQ_VALUES, &used);
+        t = now() - t;
+        snprintf(name, sizeof(name), "decodeVarLenBlock (%s)", varLenDecoderName());
+        report(name, "values", t, size, BENCH_VLQ_VALUES, iterations);
+        for (check = 0, i = 0; i < BENCH_VLQ_VALUES; i++)
+            check += values[i];
+        if ((check != sum) || (used != size))
+            printf("   decodeVarLenBlock checksum mismatch\n");
+        free(values);
+    }
+
+    fclose(f);
+    free(block);
+}
+
+static void benchChunks(const struct MidiBuffer *buf, int iterations)
+{
+    struct MidiHeader midiHead;
+    struct TrackHeader trackHead, *trackHeaders;
+    struct MidiCursor c, *tracks;
+    unsigned long chunks = 0;
+    double t;
+    FILE *f;
+    int i, k;
+
+    f = fmemopen(buf->data, buf->size, "rb");
+    if (f == NULL)
+        return;
+    t = now();
+    for (k = 0; k < iterations * BENCH_CHUNK_REPEAT; k++)
+    {
+        rewind(f);
+        midiHead = readMidiChunk(f);
+        for (chunks = 1, i = 0; i < midiHead.uNumTracks; i++, chunks++)
+        {
+            trackHead = readTrackChunk(f);
+            if (strcmp(trackHead.cChunkType, MIDI_TRACK_ID) != 0)
+                break;
+            fseek(f, trackHead.uLength, SEEK_CUR);
+        }
+    }
+    t = now() - t;
+    fclose(f);
+    // Only the chunk headers are read, the track bodies are skipped
+    report("readMidiChunk/TrackChunk", "chunks", t, 6 + 8 * chunks, chunks, iterations * BENCH_CHUNK_REPEAT);
+
+    initCursor(&c, buf->data, buf->size);
+    midiHead = cursorReadMidiChunk(&c);
+    trackHeaders = malloc(sizeof(struct TrackHeader) * (midiHead.uNumTracks + 1));
+    tracks = malloc(sizeof(struct MidiCursor) * (midiHead.uNumTracks + 1));
+    if ((trackHeaders != NULL) && (tracks != NULL))
+    {
+        t = now();
+        for (k = 0; k < iterations * BENCH_CHUNK_REPEAT; k++)
+        {
+            initCursor(&c, buf->data, buf->size);
+            midiHead = cursorReadMidiChunk(&c);
+            midiHead.trackHeaders = trackHeaders;
+            chunks = 1 + cursorIndexTracks(&c, &midiHead, tracks);
+        }
+        t = now() - t;
+        report("cursorReadMidi/TrackChunk", "chunks", t, 6 + 8 * chunks, chunks, iterations * BENCH_CHUNK_REPEAT);
+    }
+    free(trackHeaders);
+    free(tracks);
+}
+
+static void benchTrackEvents(const struct MidiBuffer *buf, int iterations)
+{
+    struct MidiHeader midiHead;
+    struct TrackHeader trackHead;
+    struct MidiCursor c, track;
+    struct MidiEvent ev;
+    unsigned long events = 0;
+    int i, k, savedStdout, devNull;
+    double t;
+    FILE *f;
+
+    // readTrackEvents() always prints to stdout, point it at /dev/null
+    f = fmemopen(buf->data, buf->size, "rb");
+    devNull = open("/dev/null", O_WRONLY);
+    if ((f == NULL) || (devNull < 0))
+        return;
+    fflush(stdout);
+    savedStdout = dup(STDOUT_FILENO);
+    dup2(devNull, STDOUT_FILENO);
+    t = now();
+    for (k = 0; k < iterations; k++)
+    {
+        rewind(f);
+        midiHead = readMidiChunk(f);
+        for (i = 0; i < midiHead.uNumTracks; i++)
+        {
+            trackHead = readTrackChunk(f);
+            if (strcmp(trackHead.cChunkType, MIDI_TRACK_ID) != 0)
+                break;
+            readTrackEvents(f);
+        }
+    }
+    fflush(stdout);
+    t = now() - t;
+    freeMidiPayloads();
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+    close(devNull);
+    fclose(f);
+
+    // Count the events with the cursor decoder, then time it
+    initCursor(&c, buf->data, buf->size);
+    midiHead = cursorReadMidiChunk(&c);
+    for (i = 0; i < midiHead.uNumTracks; i++)
+    {
+        trackHead = cursorReadTrackChunk(&c);
+        cursorTrackEvents(&c, &trackHead, &track);
+        events += cursorReadTrackEvents(&track, NULL);
+    }
+    report("readTrackEvents + printf", "events", t, buf->size, events, iterations);
+
+    t = now();
+    for (k = 0; k < iterations; k++)
+    {
+        initCursor(&c, buf->data, buf->size);
+        midiHead = cursorReadMidiChunk(&c);
+        for (i = 0; i < midiHead.uNumTracks; i++)
+        {
+            trackHead = cursorReadTrackChunk(&c);
+            if (strcmp(trackHead.cChunkType, MIDI_TRACK_ID) != 0)
+                break;
+            cursorTrackEvents(&c, &trackHead, &track);
+            while (cursorReadEvent(&track, &ev) && !((ev.status == 0xFF) && (ev.data1 == 0x2f)))
+                ;
+        }
+    }
+    t = now() - t;
+    report("cursorReadEvent", "events", t, buf->size, events, iterations);
+}
+
+static void benchSeek(const struct MidiBuffer *buf, int iterations)
+{
+    struct MidiHeader midiHead;
+    struct MidiCursor c, *tracks, track;
+    struct MidiSeekIndex seek;
+    struct MidiEvent ev;
+    unsigned long *lastTick, tick, at, seeks = 0;
+    int i, j, k, numTracks;
+    double t;
+
+    initCursor(&c, buf->data, buf->size);
+    midiHead = cursorReadMidiChunk(&c);
+    midiHead.trackHeaders = (struct TrackHeader *)malloc(sizeof(struct TrackHeader) * (midiHead.uNumTracks + 1));
+    tracks = (struct MidiCursor *)malloc(sizeof(struct MidiCursor) * (midiHead.uNumTracks + 1));
+    lastTick = (unsigned long *)calloc(midiHead.uNumTracks + 1, sizeof(unsigned long));
+    if ((midiHead.trackHeaders == NULL) || (tracks == NULL) || (lastTick == NULL))
+        return;
+    numTracks = cursorIndexTracks(&c, &midiHead, tracks);
+    for (i = 0; i < numTracks; i++)
+    {
+        track = tracks[i];
+        while (cursorReadEvent(&track, &ev))
+            lastTick[i] += ev.deltaTime;
+    }
+
+    t = now();
+    for (k = 0; k < iterations; k++)
+    {
+        for (i = 0; i < numTracks; i++)
+        {
+            for (j = 0; j < BENCH_SEEKS; j++)
+            {
+                track = tracks[i];
+                tick = 0;
+                while (cursorReadEvent(&track, &ev) && (tick + ev.deltaTime < lastTick[i] / BENCH_SEEKS * j))
+                    tick += ev.deltaTime;
+                seeks++;
+            }
+        }
+    }
+    t = now() - t;
+    report("seek from track start", "seeks", t, 0, seeks / iterations, iterations);
+
+    t = now();
+    if (buildMidiSeekIndex(&seek, midiHead.sTimeDiv, tracks, numTracks, MIDI_SEEK_EVENTS, MIDI_SEEK_TICKS) != 0)
+        return;
+    report("build seek index", "indexes", now() - t, buf->size, 1, 1);
+    t = now();
+    for (k = 0; k < iterations; k++)
+    {
+        for (i = 0; i < numTracks; i++)
+        {
+            for (j = 0; j < BENCH_SEEKS; j++)
+                midiSeekTick(&seek, i, lastTick[i] / BENCH_SEEKS * j, &track, &at);
+        }
+    }
+    t = now() - t;
+    report("seek from checkpoint", "seeks", t, 0, seeks / iterations, iterations);
+
+    freeMidiSeekIndex(&seek);
+    free(midiHead.trackHeaders);
+    free(tracks);
+    free(lastTick);
+}
+
+int main(int argc, char **argv)
+{
+    struct MidiBuffer buf;
+    int iterations = BENCH_ITERATIONS;
+
+    if ((argc < 2) || (argc > 3))
+    {
+        printf("Usage: %s filename [iterations]\n", argv[0]);
+        return 0;
+    }
+    if (argc == 3)
+        iterations = atoi(argv[2]);
+    if (iterations < 1)
+        iterations = 1;
+
+    if (loadMidiBuffer(argv[1], &buf) != 0)
+    {
+        printf("Unable to open file: %s\n", argv[1]);
+        return 1;
+    }
+    printf("%s: %zu bytes, %d iterations\n", argv[1], buf.size, iterations);
+
+    benchVarLen(iterations);
+    benchChunks(&buf, iterations);
+    benchTrackEvents(&buf, iterations);
+    benchSeek(&buf, iterations);
+
+    freeMidiBuffer(&buf);
+    return 0;
+}
@@ -11,127 +11,1825 @@
  *	The program is currently undergoing a rewrite to improve
  *	the inner workings and also to incorporate doxygen.
  *
+ *	Several files, directories or a manifest file can be given
+ *	to process a whole collection on a pool of worker threads.
+ *
  *  @author Darren Eckert
  *  @version 0.2
  *  @bug No known bugs currently.
  *  @todo Read track event data
  */
 
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #ifndef MIDIINFO_H_
 #include "MidiInfo.h"
 #endif
 
-// Main entrypoint
-int main(int argc, char **argv)
+#ifndef MIDIBUFFER_H_
+#include "MidiBuffer.h"
+#endif
+
+#ifndef MIDIBATCH_H_
+#include "MidiBatch.h"
+#endif
+
+#ifndef MIDIEXPORT_H_
+#include "MidiExport.h"
+#endif
+
+#ifndef MIDITEMPO_H_
+#include "MidiTempo.h"
+#endif
+
+#ifndef MIDIMERGE_H_
+#include "MidiMerge.h"
+#endif
+
+#ifndef MIDISTREAM_H_
+#include "MidiStream.h"
+#endif
+
+#ifndef MIDINOTES_H_
+#include "MidiNotes.h"
+#endif
+
+#ifndef MIDISTATS_H_
+#include "MidiStats.h"
+#endif
+
+#ifndef MIDICACHE_H_
+#include "MidiCache.h"
+#endif
+
+#ifndef MIDIFINGERPRINT_H_
+#include "MidiFingerprint.h"
+#endif
+
+#ifndef MIDIINDEX_H_
+#include "MidiIndex.h"
+#endif
+
+#ifndef MIDISEEK_H_
+#include "MidiSeek.h"
+#endif
+
+#ifndef MIDIWRITER_H_
+#include "MidiWriter.h"
+#endif
+
+#ifndef MIDIPROFILE_H_
+#include "MidiProfile.h"
+#endif
+
+/** @struct Options
+ *  @brief Command line options, passed to the per-file functions
+ */
+struct Options
 {
+	int batch;
+	int workers;
+	int trackWorkers;
+	int quiet;
+	int exportFormat;
+	int merge;
+	int stream;
+	int statsJson;
+	double seekStart, seekEnd;
+	const char *rewritePath;
+	int (*job)(const char *filename, FILE *out, void *arg);
+	int (*uncachedJob)(const char *filename, FILE *out, void *arg);
+	struct MidiCache *cache;
+	int profile;
+	int (*profiledJob)(const char *filename, FILE *out, void *arg);
+};
 
-	// Variables
-	FILE *fMIDI = NULL;
-	struct MidiHeader midiHead;
-	struct TrackHeader trackHead;
+/** @struct MidiTracks
+ *  @brief A MIDI file in memory with the event data of its tracks located, see openMidiTracks()
+ *
+ * Tracks holds a cursor over each of the numTracks tracks found, fewer
+ * than head.uNumTracks when a track chunk has the wrong id.\n
+ */
+struct MidiTracks
+{
+	struct MidiBuffer buf;
+	struct MidiHeader head;
+	struct MidiCursor *tracks;
+	int numTracks;
+};
+
+/** @struct TrackOutput
+ *  @brief Printed output of the tracks of one file, see printTracks()
+ */
+struct TrackOutput
+{
+	const struct TrackHeader *trackHeaders;
+	struct MidiCursor *tracks;
+	int quiet;
+	char **text;
+	size_t *size;
+};
+
+/** @struct PrintVisitor
+ *  @brief Visitor context printing a file, see initPrintVisitor()
+ */
+struct PrintVisitor
+{
+	struct MidiVisitor v;
+	FILE *out;
+	struct MidiOutput o;
+	int quiet;
+	int failed;
+	unsigned long events;
+};
+
+/** @fn static void usage(const char *name)
+ *  @brief Print the command line usage
+ */
+static void usage(const char *name)
+{
+	printf("Usage: %s filename\n", name);
+	printf("       %s [options] path...\n", name);
+	printf("  -s, --summary          Format, tracks, time division and track sizes only, no events\n");
+	printf("      --meta             Meta events only: names, copyright, tempo, signatures, lyrics, ...\n");
+	printf("      --notes            Notes with their start, duration, channel, key and velocity\n");
+	printf("      --stats[=json]     Event counts, pitch range, velocities, programs, polyphony and controllers\n");
+	printf("      --seek from[,to]   Events of each track from a time to another, in seconds (decodes the whole file)\n");
+	printf("      --fingerprint      Hash of the normalized events, the same for re-saved copies of a song\n");
+	printf("      --index-build file Index the words of the text Meta events of every path in file\n");
+	printf("      --index-query file Print the files of the index file containing all the words given\n");
+	printf("      --rewrite file     Write a compacted copy of a single file: running status, shortest delta times\n");
+	printf("  -q, --quiet            Decode every event but only print the number of events per track\n");
+	printf("  -e, --export format    Write every event as ndjson, csv or binary records instead of text\n");
+	printf("      --merge            Export the events of all tracks in one time ordered stream\n");
+	printf("      --stream           Decode while reading instead of loading the whole file (- reads stdin)\n");
+	printf("  -c, --cache file       Keep --summary/--stats results in file, unchanged files are not read again\n");
+	printf("      --cache-verify     Also compare a hash of the contents of cached files\n");
+	printf("  -j, --jobs workers     Number of worker threads in batch mode (default: one per processor)\n");
+	printf("  -t, --threads threads  Decode the tracks of each file on several threads (0: one per processor)\n");
+	printf("  -m, --manifest file    Read paths from a file, one per line (- for stdin)\n");
+	printf("      --stats-timing[=json] Throughput, time per phase and slowest files on stderr (make PROFILE=1)\n");
+	printf("Batch mode is used for several paths, a directory (searched recursively) or a manifest.\n");
+}
+
+/** @fn static int checkMidiHeader(FILE *out, const struct MidiHeader *midiHead)
+ *  @brief Validate the MIDI header chunk, printing the reason if it is not valid
+ *
+ * @return 0 if the header is valid, 1 if not
+ */
+static int checkMidiHeader(FILE *out, const struct MidiHeader *midiHead)
+{
+	if (strcmp(midiHead->cChunkType, MIDI_HEADER_ID) != 0)
+	{
+		fprintf(out, "Incorrect file header id: %s\n", midiHead->cChunkType);
+		return 1;
+	}
+
+	if (midiHead->uLength != MIDI_HEADER_CHUNK_SIZE)
+	{
+		fprintf(out, "Incorrect chunk size: %d\n", midiHead->uLength);
+		return 1;
+	}
+
+	if ((midiHead->uFormat == 0) && (midiHead->uNumTracks > 1))
+	{
+		fprintf(out, "Incorrect number of tracks for a format 0 file: %d\n", midiHead->uNumTracks);
+		return 1;
+	}
+	return 0;
+}
+
+/** @fn static void printTimeDivision(FILE *out, short sTimeDiv)
+ *  @brief Print the time division format being used
+ */
+static void printTimeDivision(FILE *out, short sTimeDiv)
+{
 	short val, fps, ticks;
-	// unsigned char *cBuffer;
-	int i;
 
-	// Usage check
-	if (argc != 2)
+	// Determine time divsion format being used
+	val = (sTimeDiv & 0x8000);
+	if (val != 0)
+	{
+		// Frames per second, extract negative SMPTE frame rate (mask 0x7f00) and tick per frame (mask 0x00ff)
+		// FPS is in negative 2's compliment format,
+		fps = sTimeDiv >> 8;		 // Get the first 2 bytes for frame rate
+		fps = ~fps + 1;				 // 1's compliment + 1 to get 2's compliment
+		ticks = (sTimeDiv & 0x00ff); // Get the last 2 bytes for tick per frame
+		fprintf(out, "Time division: (SMPTE format) %d frames per second, %d ticks per frame\n", fps, ticks);
+	}
+	else
+	{
+		fprintf(out, "Time division: %d ticks per quarter note\n", sTimeDiv);
+	}
+}
+
+/** @fn static void printMidiHeader(FILE *out, const struct MidiHeader *midiHead)
+ *  @brief Print the format, number of tracks and time division of a file
+ */
+static void printMidiHeader(FILE *out, const struct MidiHeader *midiHead)
+{
+	fprintf(out, "MIDI format:   %d, ", midiHead->uFormat);
+	fprintf(out, "%d tracks found\n", midiHead->uNumTracks);
+	printTimeDivision(out, midiHead->sTimeDiv);
+}
+
+/** @fn static int openMidiTracks(struct MidiTracks *t, const char *filename, FILE *err)
+ *  @brief Load a MIDI file, check its header and locate the event data of its tracks
+ *
+ * The reason a file cannot be used is printed to err. A track chunk
+ * with the wrong id is not an error here, see checkMidiTracks().
+ *
+ * @param t: Receives the file and its tracks, release with closeMidiTracks()
+ * @param filename: The MIDI file to read
+ * @param err: The stream to print errors to
+ * @return 0 on success, 1 if the header is not valid, -1 if the file could not be read or memory allocated
+ */
+static int openMidiTracks(struct MidiTracks *t, const char *filename, FILE *err)
+{
+	struct MidiCursor c;
+
+	if (loadMidiBuffer(filename, &t->buf) != 0)
+	{
+		fprintf(err, "Unable to open file: %s\n", filename);
+		return -1;
+	}
+	initCursor(&c, t->buf.data, t->buf.size);
+
+	t->head = cursorReadMidiChunk(&c);
+	if (checkMidiHeader(err, &t->head) != 0)
 	{
-		printf("Usage: %s filename\n", argv[0]);
+		freeMidiBuffer(&t->buf);
+		return 1;
+	}
+
+	t->head.trackHeaders = malloc(sizeof(struct TrackHeader) * t->head.uNumTracks);
+	t->tracks = malloc(sizeof(struct MidiCursor) * t->head.uNumTracks);
+	if (((t->head.trackHeaders == NULL) || (t->tracks == NULL)) && (t->head.uNumTracks > 0))
+	{
+		fprintf(err, "Error allocating memory for track headers\n");
+		free(t->head.trackHeaders);
+		free(t->tracks);
+		freeMidiBuffer(&t->buf);
+		return -1;
+	}
+	t->numTracks = cursorIndexTracks(&c, &t->head, t->tracks);
+	return 0;
+}
+
+/** @fn static int checkMidiTracks(FILE *err, const struct MidiTracks *t)
+ *  @brief Print the track chunk that has the wrong id, if any
+ *
+ * @return 0 if every track was found, 1 if not
+ */
+static int checkMidiTracks(FILE *err, const struct MidiTracks *t)
+{
+	if (t->numTracks == t->head.uNumTracks)
 		return 0;
+	fprintf(err, "Track %d: incorrect track header id: %s\n", t->numTracks,
+			t->head.trackHeaders[t->numTracks].cChunkType);
+	return 1;
+}
+
+/** @fn static void closeMidiTracks(struct MidiTracks *t)
+ *  @brief Release a file opened with openMidiTracks()
+ */
+static void closeMidiTracks(struct MidiTracks *t)
+{
+	free(t->head.trackHeaders);
+	free(t->tracks);
+	freeMidiBuffer(&t->buf);
+}
+
+/** @fn static void printTrack(struct MidiOutput *o, int i, const struct TrackHeader *trackHead, struct MidiCursor *track, int quiet)
+ *  @brief Print the header and events of one track
+ *
+ * In quiet mode the events are decoded but only their number is printed.
+ */
+static void printTrack(struct MidiOutput *o, int i, const struct TrackHeader *trackHead, struct MidiCursor *track, int quiet)
+{
+	unsigned long events;
+
+	outFormat(o, "Reading track %d - ", i);
+	outFormat(o, "   Found track, event data is %d bytes long.\n", trackHead->uLength);
+	events = cursorReadTrackEvents(track, quiet ? NULL : o);
+	if (quiet)
+		outFormat(o, "   %lu events\n", events);
+	outFormat(o, "   End of track\n");
+}
+
+/** @fn static void printTrackBuffer(size_t i, void *arg)
+ *  @brief runMidiParallel() item, prints one track to a memory buffer
+ */
+static void printTrackBuffer(size_t i, void *arg)
+{
+	struct TrackOutput *work = (struct TrackOutput *)arg;
+	struct MidiOutput o;
+	FILE *out;
+
+	out = open_memstream(&work->text[i], &work->size[i]);
+	if (out == NULL)
+		return;
+	if (openMidiOutput(&o, out) == 0)
+	{
+		printTrack(&o, i, &work->trackHeaders[i], &work->tracks[i], work->quiet);
+		closeMidiOutput(&o);
 	}
+	fclose(out);
+}
 
-	// Attempt to open file, exit with error if it fails
-	fMIDI = fopen(argv[1], "rb");
-	if (fMIDI == NULL)
+/** @fn static int printTracks(FILE *out, const struct TrackHeader *trackHeaders, struct MidiCursor *tracks, int numTracks, const struct Options *opts)
+ *  @brief Print indexed tracks, decoding several tracks at once
+ *
+ * Each track is printed to its own memory buffer by a worker thread,
+ * the buffers are then written out in track order.
+ *
+ * @return 0 on success, 1 if memory could not be allocated
+ */
+static int printTracks(FILE *out, const struct TrackHeader *trackHeaders, struct MidiCursor *tracks, int numTracks, const struct Options *opts)
+{
+	struct TrackOutput work;
+	int i, ret = 0;
+
+	work.trackHeaders = trackHeaders;
+	work.tracks = tracks;
+	work.quiet = opts->quiet;
+	work.text = (char **)calloc(numTracks, sizeof(char *));
+	work.size = (size_t *)calloc(numTracks, sizeof(size_t));
+	if ((work.text == NULL) || (work.size == NULL) ||
+		(runMidiParallel(numTracks, opts->trackWorkers, printTrackBuffer, &work) != 0))
 	{
-		printf("Unable to open file: %s\n", argv[1]);
+		fprintf(out, "Error allocating memory for track output\n");
+		free(work.text);
+		free(work.size);
 		return 1;
 	}
 
-	// Attempt to read the MIDI file header chunk
-	midiHead = readMidiChunk(fMIDI);
+	for (i = 0; i < numTracks; i++)
+	{
+		if (work.text[i] == NULL)
+			ret = 1;
+		else
+			fwrite(work.text[i], 1, work.size[i], out);
+		free(work.text[i]);
+	}
+	free(work.text);
+	free(work.size);
+	return ret;
+}
 
-	if (strcmp(midiHead.cChunkType, MIDI_HEADER_ID) != 0)
+/** @fn static int printHeaderCb(void *ctx, const struct MidiHeader *midiHead)
+ *  @brief Visitor callback, prints the MIDI header chunk
+ */
+static int printHeaderCb(void *ctx, const struct MidiHeader *midiHead)
+{
+	struct PrintVisitor *pv = (struct PrintVisitor *)ctx;
+
+	if (checkMidiHeader(pv->out, midiHead) != 0)
 	{
-		printf("Incorrect file header id: %s\n", midiHead.cChunkType);
-		fclose(fMIDI);
+		pv->failed = 1;
+		return 1;
+	}
+	fprintf(pv->out, "Valid MIDI header chunk found\n");
+	fprintf(pv->out, "MIDI format:   %d, ", midiHead->uFormat);
+	fprintf(pv->out, "%d tracks found\n", midiHead->uNumTracks);
+	printTimeDivision(pv->out, midiHead->sTimeDiv);
+	return 0;
+}
+
+/** @fn static int printTrackCb(void *ctx, int track, const struct TrackHeader *trackHead)
+ *  @brief Visitor callback, prints a track header
+ */
+static int printTrackCb(void *ctx, int track, const struct TrackHeader *trackHead)
+{
+	struct PrintVisitor *pv = (struct PrintVisitor *)ctx;
+
+	outFormat(&pv->o, "Reading track %d - ", track);
+	if (strcmp(trackHead->cChunkType, MIDI_TRACK_ID) != 0)
+	{
+		outFormat(&pv->o, "incorrect track header id: %s\n", trackHead->cChunkType);
+		pv->failed = 1;
 		return 1;
 	}
+	outFormat(&pv->o, "   Found track, event data is %d bytes long.\n", trackHead->uLength);
+	if (!pv->quiet)
+	{
+		outReserve(&pv->o);
+		OUT_LIT(&pv->o, "      Begin Processing Track Chunk\n");
+	}
+	pv->events = 0;
+	return 0;
+}
+
+/** @fn static int printEventCb(void *ctx, int track, unsigned long tick, const struct MidiEvent *ev)
+ *  @brief Visitor callback, prints an event of any kind
+ */
+static int printEventCb(void *ctx, int track, unsigned long tick, const struct MidiEvent *ev)
+{
+	struct PrintVisitor *pv = (struct PrintVisitor *)ctx;
+
+	(void)track;
+	(void)tick;
+	pv->events++;
+	if (!pv->quiet)
+		printMidiEvent(&pv->o, ev);
+	return 0;
+}
+
+/** @fn static int printTrackEndCb(void *ctx, int track)
+ *  @brief Visitor callback, prints the end of a track
+ */
+static int printTrackEndCb(void *ctx, int track)
+{
+	struct PrintVisitor *pv = (struct PrintVisitor *)ctx;
+
+	(void)track;
+	if (pv->quiet)
+		outFormat(&pv->o, "   %lu events\n", pv->events);
+	outFormat(&pv->o, "   End of track\n");
+	return 0;
+}
+
+/** @fn static int openPrintVisitor(struct PrintVisitor *pv, FILE *out, int quiet)
+ *  @brief Set up the visitor printing a file in the text form of printMidiFile()
+ *
+ * @return 0 on success, 1 if memory could not be allocated
+ */
+static int openPrintVisitor(struct PrintVisitor *pv, FILE *out, int quiet)
+{
+	struct MidiVisitor v = {pv, printHeaderCb, printTrackCb, printEventCb, printEventCb, printEventCb, printTrackEndCb};
 
-	if (midiHead.uLength != MIDI_HEADER_CHUNK_SIZE)
+	if (openMidiOutput(&pv->o, out) != 0)
 	{
-		printf("Incorrect chunk size: %d\n", midiHead.uLength);
-		fclose(fMIDI);
+		fprintf(out, "Error allocating memory for track output\n");
 		return 1;
 	}
+	pv->v = v;
+	pv->out = out;
+	pv->quiet = quiet;
+	pv->failed = 0;
+	pv->events = 0;
+	return 0;
+}
+
+/** @fn static int closePrintVisitor(struct PrintVisitor *pv)
+ *  @brief Flush the printed file and close it off
+ *
+ * @return 0 if the whole file was printed, 1 if it was not valid
+ */
+static int closePrintVisitor(struct PrintVisitor *pv)
+{
+	closeMidiOutput(&pv->o);
+	if (pv->failed)
+		return 1;
+
+	// Everything is done, close the file and exit
+	fprintf(pv->out, "All done, closing file and exiting.\n");
+	return 0;
+}
+
+/** @fn static int streamMidiFile(const char *filename, FILE *out, void *arg)
+ *  @brief Print the headers and events of a MIDI file while it is read
+ *
+ * The file is pushed through the incremental parser a block at a time,
+ * so "-" (stdin) and pipes are printed as the data arrives. The output
+ * is the same as printMidiFile() gives for the whole file.
+ *
+ * @param filename: The MIDI file to read, - for stdin
+ * @param out: The stream to print to
+ * @param arg: The command line options
+ * @return 0 on success, 1 if the file could not be read or is not valid
+ */
+static int streamMidiFile(const char *filename, FILE *out, void *arg)
+{
+	const struct Options *opts = (const struct Options *)arg;
+	struct PrintVisitor pv;
+	struct MidiStream s;
+	int fd, ret;
 
-	if ((midiHead.uFormat == 0) && (midiHead.uNumTracks > 1))
+	if (opts->batch)
+		fprintf(out, "File: %s\n", filename);
+
+	fd = (strcmp(filename, "-") == 0) ? STDIN_FILENO : open(filename, O_RDONLY);
+	if (fd < 0)
 	{
-		printf("Incorrect number of tracks for a format 0 file: %d\n", midiHead.uNumTracks);
-		fclose(fMIDI);
+		fprintf(out, "Unable to open file: %s\n", filename);
+		return 1;
+	}
+	if (openPrintVisitor(&pv, out, opts->quiet) != 0)
+	{
+		if (fd != STDIN_FILENO)
+			close(fd);
 		return 1;
 	}
-	printf("Valid MIDI header chunk found\n");
-	printf("MIDI format:   %d, ", midiHead.uFormat);
-	printf("%d tracks found\n", midiHead.uNumTracks);
 
-	// Determine time divsion format being used
-	val = (midiHead.sTimeDiv & 0x8000);
-	if (val != 0)
+	initMidiStream(&s, &pv.v);
+	ret = readMidiStream(fd, &s);
+	freeMidiStream(&s);
+	if (fd != STDIN_FILENO)
+		close(fd);
+	if (ret < 0)
 	{
-		// Frames per second, extract negative SMPTE frame rate (mask 0x7f00) and tick per frame (mask 0x00ff)
-		// FPS is in negative 2's compliment format,
-		fps = midiHead.sTimeDiv >> 8;		  // Get the first 2 bytes for frame rate
-		fps = ~fps + 1;						  // 1's compliment + 1 to get 2's compliment
-		ticks = (midiHead.sTimeDiv & 0x00ff); // Get the last 2 bytes for tick per frame
-		printf("Time division: (SMPTE format) %d frames per second, %d ticks per frame\n", fps, ticks);
+		outFormat(&pv.o, "Error reading file: %s\n", filename);
+		pv.failed = 1;
+	}
+	return closePrintVisitor(&pv);
+}
+
+/** @fn static int printMidiFile(const char *filename, FILE *out, void *arg)
+ *  @brief Print the headers and events of a MIDI file
+ *
+ * The file is walked with the printing visitor, or with -t or -q its
+ * tracks are indexed first and then printed.
+ *
+ * @param filename: The MIDI file to read
+ * @param out: The stream to print to
+ * @param arg: The command line options
+ * @return 0 on success, 1 if the file could not be read or is not valid
+ */
+static int printMidiFile(const char *filename, FILE *out, void *arg)
+{
+	// Variables
+	const struct Options *opts = (const struct Options *)arg;
+	struct MidiBuffer bufMIDI;
+	struct MidiTracks t;
+	struct MidiOutput o;
+	struct PrintVisitor pv;
+	int i, ret = 0;
+
+	if (opts->stream || (strcmp(filename, "-") == 0))
+		return streamMidiFile(filename, out, arg);
+
+	if (opts->batch)
+		fprintf(out, "File: %s\n", filename);
+
+	// One track at a time, walk the file with the printing visitor.
+	// Quiet mode keeps the bare decode loop of cursorReadTrackEvents()
+	if ((opts->trackWorkers == 1) && !opts->quiet)
+	{
+		// Attempt to load the whole file, exit with error if it fails
+		if (loadMidiBuffer(filename, &bufMIDI) != 0)
+		{
+			fprintf(out, "Unable to open file: %s\n", filename);
+			return 1;
+		}
+		ret = openPrintVisitor(&pv, out, opts->quiet);
+		if (ret == 0)
+		{
+			visitMidiBuffer(&pv.v, bufMIDI.data, bufMIDI.size);
+			ret = closePrintVisitor(&pv);
+		}
+		freeMidiBuffer(&bufMIDI);
+		return ret;
+	}
+
+	// Locate every track first, then print them
+	if (openMidiTracks(&t, filename, out) != 0)
+		return 1;
+	fprintf(out, "Valid MIDI header chunk found\n");
+	printMidiHeader(out, &t.head);
+
+	if ((opts->trackWorkers != 1) && (t.numTracks > 1))
+	{
+		ret = printTracks(out, t.head.trackHeaders, t.tracks, t.numTracks, opts);
+	}
+	else if (openMidiOutput(&o, out) == 0)
+	{
+		for (i = 0; i < t.numTracks; i++)
+			printTrack(&o, i, &t.head.trackHeaders[i], &t.tracks[i], opts->quiet);
+		closeMidiOutput(&o);
 	}
 	else
 	{
-		printf("Time division: %d ticks per quarter note\n", midiHead.sTimeDiv);
+		fprintf(out, "Error allocating memory for track output\n");
+		ret = 1;
+	}
+
+	if (t.numTracks < t.head.uNumTracks)
+	{
+		fprintf(out, "Reading track %d - ", t.numTracks);
+		fprintf(out, "incorrect track header id: %s\n", t.head.trackHeaders[t.numTracks].cChunkType);
+		ret = 1;
+	}
+	// Everything is done, close the file and exit
+	if (ret == 0)
+		fprintf(out, "All done, closing file and exiting.\n");
+	closeMidiTracks(&t);
+	return ret;
+}
+
+/** @fn static int summariseMidiFile(const char *filename, FILE *out, void *arg)
+ *  @brief Print the format, time division and track sizes of a MIDI file
+ *
+ * Only the header chunks are read, the event data of each track is
+ * skipped with fseek() so no events are decoded.
+ *
+ * @param filename: The MIDI file to read
+ * @param out: The stream to print to
+ * @param arg: The command line options
+ * @return 0 on success, 1 if the file could not be read or is not valid
+ */
+static int summariseMidiFile(const char *filename, FILE *out, void *arg)
+{
+	const struct Options *opts = (const struct Options *)arg;
+	FILE *fMIDI;
+	struct MidiHeader midiHead;
+	unsigned long long totalBytes = 0;
+	long fileSize, endOfTracks;
+	int i, numTracks, ret = 0;
+
+	if (opts->batch)
+		fprintf(out, "File: %s\n", filename);
+
+	fMIDI = fopen(filename, "rb");
+	if (fMIDI == NULL)
+	{
+		fprintf(out, "Unable to open file: %s\n", filename);
+		return 1;
+	}
+
+	midiHead = readMidiChunk(fMIDI);
+	if (checkMidiHeader(out, &midiHead) != 0)
+	{
+		fclose(fMIDI);
+		return 1;
 	}
+	printMidiHeader(out, &midiHead);
 
 	midiHead.trackHeaders = malloc(sizeof(struct TrackHeader) * midiHead.uNumTracks);
-	if (midiHead.trackHeaders == NULL)
+	if ((midiHead.trackHeaders == NULL) && (midiHead.uNumTracks > 0))
 	{
-		printf("Error allocating memory for track headers\n");
+		fprintf(out, "Error allocating memory for track headers\n");
 		fclose(fMIDI);
 		return 1;
 	}
 
-	for (i = 0; i < midiHead.uNumTracks; i++)
+	numTracks = scanTrackChunks(fMIDI, &midiHead);
+	for (i = 0; i < numTracks; i++)
+	{
+		fprintf(out, "   Track %d: %u bytes\n", i, midiHead.trackHeaders[i].uLength);
+		totalBytes += midiHead.trackHeaders[i].uLength;
+	}
+	if (numTracks < midiHead.uNumTracks)
 	{
-		printf("Reading track %d - ", i);
-		trackHead = readTrackChunk(fMIDI);
-		midiHead.trackHeaders[i] = trackHead;
-		if (strcmp(trackHead.cChunkType, MIDI_TRACK_ID) != 0)
+		fprintf(out, "   Track %d: incorrect track header id: %s\n", numTracks, midiHead.trackHeaders[numTracks].cChunkType);
+		ret = 1;
+	}
+	else
+	{
+		// Seeking past the end of the file does not fail, compare with its size
+		endOfTracks = ftell(fMIDI);
+		fseek(fMIDI, 0, SEEK_END);
+		fileSize = ftell(fMIDI);
+		if (endOfTracks > fileSize)
 		{
-			printf("incorrect track header id: %s\n", trackHead.cChunkType);
-			free(midiHead.trackHeaders);
-			fclose(fMIDI);
-			return 1;
+			fprintf(out, "   Last track is truncated, %ld bytes missing\n", endOfTracks - fileSize);
+			ret = 1;
 		}
-		//*
-		printf("   Found track, event data is %d bytes long.\n", trackHead.uLength);
-		readTrackEvents(fMIDI);
-		printf("   End of track\n");
-		// * /
-		/*
-		printf("TODO: read events , skip them for now\n");
-		cBuffer = (unsigned char *)malloc(trackHead.uLength);
-		if (cBuffer == NULL)
-		{
-			printf("Unable to allocate memory, exiting\n");
-			free(midiHead.trackHeaders);
-			fclose(fMIDI);
-			exit(1);
-		}
-		fread(cBuffer, trackHead.uLength, 1, fMIDI);
-		free(cBuffer);
-		// */
 	}
-	// Everything is done, close the file and exit
-	printf("All done, closing file and exiting.\n");
+	fprintf(out, "Total event data: %llu bytes in %d tracks\n", totalBytes, numTracks);
+
+	free(midiHead.trackHeaders);
 	fclose(fMIDI);
-	return 0;
-}
\ No newline at end of file
+	return ret;
+}
+
+/** @fn static int printMidiMeta(const char *filename, FILE *out, void *arg)
+ *  @brief Print the Meta events of a MIDI file
+ *
+ * MIDI events are skipped by their length without being decoded or
+ * printed, see cursorReadMetaEvent(). Each event is printed with its
+ * tick and its time in seconds from the tempo map of the file.
+ *
+ * @param filename: The MIDI file to read
+ * @param out: The stream to print to
+ * @param arg: The command line options
+ * @return 0 on success, 1 if the file could not be read or is not valid
+ */
+static int printMidiMeta(const char *filename, FILE *out, void *arg)
+{
+	const struct Options *opts = (const struct Options *)arg;
+	struct MidiTracks t;
+	struct MidiEvent ev;
+	struct MidiOutput o;
+	struct TempoMap tempo;
+	unsigned long tick, seg;
+	int i, ret = 0;
+
+	if (opts->batch)
+		fprintf(out, "File: %s\n", filename);
+
+	// Every track is needed for the tempo map before the first event is printed
+	if (openMidiTracks(&t, filename, out) != 0)
+		return 1;
+	printMidiHeader(out, &t.head);
+
+	if (buildTempoMap(&tempo, t.head.sTimeDiv, t.tracks, t.numTracks) != 0)
+	{
+		fprintf(out, "Error allocating memory for the tempo map\n");
+		ret = 1;
+	}
+	else if (openMidiOutput(&o, out) != 0)
+	{
+		fprintf(out, "Error allocating memory for track output\n");
+		freeTempoMap(&tempo);
+		ret = 1;
+	}
+	else
+	{
+		for (i = 0; i < t.numTracks; i++)
+		{
+			MIDI_PROFILE_START(start);
+			outFormat(&o, "Track %d\n", i);
+			tick = 0;
+			seg = 0;
+			while (cursorReadMetaEvent(&t.tracks[i], &ev) && (ev.data1 != 0x2f))
+			{
+				tick += ev.deltaTime;
+				seg = tempoSegment(&tempo, seg, tick);
+				outFormat(&o, "   Tick %lu, %.3f s: ", tick, tempoSegmentMicros(&tempo, seg, tick) / 1e6);
+				printMetaEvent(&o, &ev);
+			}
+			MIDI_PROFILE_STOP(start, MIDI_PROFILE_DECODE);
+		}
+		closeMidiOutput(&o);
+		freeTempoMap(&tempo);
+		ret = checkMidiTracks(out, &t);
+	}
+
+	closeMidiTracks(&t);
+	return ret;
+}
+
+/** @fn static void printNotes(struct MidiOutput *o, const struct NoteList *list, const struct TempoMap *tempo)
+ *  @brief Print the notes of a track with their times in seconds
+ */
+static void printNotes(struct MidiOutput *o, const struct NoteList *list, const struct TempoMap *tempo)
+{
+	const struct MidiNote *note;
+	double start;
+	size_t i;
+
+	for (i = 0; i < list->count; i++)
+	{
+		note = &list->notes[i];
+		start = tempoTickToMicros(tempo, note->start);
+		outFormat(o, "   Tick %lu, %.3f s: Channel %d, Note %d Velocity %d, %lu ticks (%.3f s)%s\n",
+				  note->start, start / 1e6, note->channel, note->key, note->velocity, note->duration,
+				  (tempoTickToMicros(tempo, note->start + note->duration) - start) / 1e6,
+				  note->open ? ", still open at end of track" : "");
+	}
+}
+
+/** @fn static int printMidiNotes(const char *filename, FILE *out, void *arg)
+ *  @brief Print the notes of each track of a MIDI file
+ *
+ * Note-on and note-off events are paired in one pass over each track,
+ * see MidiNotes.h. Notes are printed in the order they start, with
+ * times from the tempo map of the file.
+ *
+ * @param filename: The MIDI file to read
+ * @param out: The stream to print to
+ * @param arg: The command line options
+ * @return 0 on success, 1 if the file could not be read or is not valid
+ */
+static int printMidiNotes(const char *filename, FILE *out, void *arg)
+{
+	const struct Options *opts = (const struct Options *)arg;
+	struct MidiTracks t;
+	struct MidiEvent ev;
+	struct MidiOutput o;
+	struct TempoMap tempo;
+	struct NoteList list;
+	struct NotePairer *pairer;
+	unsigned long tick;
+	size_t open;
+	int i, ret = 0;
+
+	if (opts->batch)
+		fprintf(out, "File: %s\n", filename);
+
+	if (openMidiTracks(&t, filename, out) != 0)
+		return 1;
+	printMidiHeader(out, &t.head);
+
+	if ((pairer = malloc(sizeof(struct NotePairer))) == NULL)
+	{
+		fprintf(out, "Error allocating memory for notes\n");
+		closeMidiTracks(&t);
+		return 1;
+	}
+	initNoteList(&list);
+
+	if (buildTempoMap(&tempo, t.head.sTimeDiv, t.tracks, t.numTracks) != 0)
+	{
+		fprintf(out, "Error allocating memory for the tempo map\n");
+		ret = 1;
+	}
+	else if (openMidiOutput(&o, out) != 0)
+	{
+		fprintf(out, "Error allocating memory for track output\n");
+		freeTempoMap(&tempo);
+		ret = 1;
+	}
+	else
+	{
+		for (i = 0; (i < t.numTracks) && (ret == 0); i++)
+		{
+			outFormat(&o, "Track %d\n", i);
+			list.count = 0;
+			initNotePairer(pairer, &list);
+			tick = 0;
+			MIDI_PROFILE_START(start);
+			while (cursorReadEvent(&t.tracks[i], &ev))
+			{
+				tick += ev.deltaTime;
+				if (pairNoteEvent(pairer, tick, &ev) != 0)
+				{
+					outFormat(&o, "Error allocating memory for notes\n");
+					ret = 1;
+					break;
+				}
+				if ((ev.status == 0xFF) && (ev.data1 == 0x2f))
+					break;
+			}
+			MIDI_PROFILE_STOP(start, MIDI_PROFILE_DECODE);
+			open = endNotePairer(pairer, tick);
+			printNotes(&o, &list, &tempo);
+			outFormat(&o, "   %zu notes, %zu still open, %lu note-offs without a note-on\n", list.count, open, pairer->orphans);
+		}
+		closeMidiOutput(&o);
+		freeTempoMap(&tempo);
+		if (ret == 0)
+			ret = checkMidiTracks(out, &t);
+	}
+
+	freeNoteList(&list);
+	free(pairer);
+	closeMidiTracks(&t);
+	return ret;
+}
+
+/** @fn static int statsMidiFile(const char *filename, FILE *out, void *arg)
+ *  @brief Print the musical statistics of a MIDI file
+ *
+ * The tracks are decoded once, merged into time order so polyphony is
+ * counted across tracks, and every event only updates the counters of
+ * MidiStats.h. With --stats=json errors go to stderr so the output
+ * stays one JSON object per file.
+ *
+ * @param filename: The MIDI file to read
+ * @param out: The stream to print to
+ * @param arg: The command line options
+ * @return 0 on success, 1 if the file could not be read or is not valid
+ */
+static int statsMidiFile(const char *filename, FILE *out, void *arg)
+{
+	const struct Options *opts = (const struct Options *)arg;
+	FILE *err = opts->statsJson ? stderr : out;
+	struct MidiTracks t;
+	struct MidiEvent ev;
+	struct MidiMerge merge;
+	struct MidiOutput o;
+	struct MidiStats *stats;
+	unsigned long tick;
+	int track, ret = 0;
+
+	if (opts->batch && !opts->statsJson)
+		fprintf(out, "File: %s\n", filename);
+
+	if (openMidiTracks(&t, filename, err) != 0)
+		return 1;
+	if ((stats = malloc(sizeof(struct MidiStats))) == NULL)
+	{
+		fprintf(err, "Error allocating memory for statistics\n");
+		closeMidiTracks(&t);
+		return 1;
+	}
+
+	if (checkMidiTracks(err, &t) != 0)
+		ret = 1;
+	else if (openMidiMerge(&merge, t.tracks, t.numTracks) != 0)
+	{
+		fprintf(err, "Error allocating memory for track merge\n");
+		ret = 1;
+	}
+	else
+	{
+		MIDI_PROFILE_START(start);
+		initMidiStats(stats, t.numTracks);
+		while (midiMergeNext(&merge, &ev, &track, &tick))
+			addMidiStatsEvent(stats, track, tick, &ev);
+		MIDI_PROFILE_STOP(start, MIDI_PROFILE_DECODE);
+		closeMidiMerge(&merge);
+
+		if (openMidiOutput(&o, out) != 0)
+		{
+			fprintf(err, "Error allocating memory for track output\n");
+			ret = 1;
+		}
+		else
+		{
+			writeMidiStats(&o, stats, filename, opts->statsJson);
+			closeMidiOutput(&o);
+		}
+	}
+
+	free(stats);
+	closeMidiTracks(&t);
+	return ret;
+}
+
+/** @fn static int parseSeekRange(const char *arg, struct Options *opts)
+ *  @brief Read the from[,to] times of --seek, in seconds
+ *
+ * @return 0 on success, -1 if the range is not valid
+ */
+static int parseSeekRange(const char *arg, struct Options *opts)
+{
+	char *end;
+
+	opts->seekStart = strtod(arg, &end);
+	opts->seekEnd = -1;
+	if ((end == arg) || (opts->seekStart < 0))
+		return -1;
+	if (*end == ',')
+	{
+		arg = end + 1;
+		opts->seekEnd = strtod(arg, &end);
+		if ((end == arg) || (opts->seekEnd < opts->seekStart))
+			return -1;
+	}
+	return (*end == '\0') ? 0 : -1;
+}
+
+/** @fn static int seekMidiFile(const char *filename, FILE *out, void *arg)
+ *  @brief Print the events of each track between two times
+ *
+ * Each track is entered at its checkpoint nearest the start time, see
+ * MidiSeek.h, and printed until the end time or the end of the track.
+ * The index is built for this one seek and dropped, so the file is
+ * decoded in full; only callers that keep the index across seeks get
+ * seeks that do not depend on how far into the file they go.
+ *
+ * @param filename: The MIDI file to read
+ * @param out: The stream to print to
+ * @param arg: The command line options
+ * @return 0 on success, 1 if the file could not be read or is not valid
+ */
+static int seekMidiFile(const char *filename, FILE *out, void *arg)
+{
+	const struct Options *opts = (const struct Options *)arg;
+	struct MidiTracks t;
+	struct MidiCursor c;
+	struct MidiSeekIndex seek;
+	struct MidiEvent ev;
+	struct MidiOutput o;
+	unsigned long tick, endTick, seg;
+	int i, ret = 0;
+
+	if (opts->batch)
+		fprintf(out, "File: %s\n", filename);
+
+	if (openMidiTracks(&t, filename, out) != 0)
+		return 1;
+	printMidiHeader(out, &t.head);
+
+	if (buildMidiSeekIndex(&seek, t.head.sTimeDiv, t.tracks, t.numTracks, MIDI_SEEK_EVENTS, MIDI_SEEK_TICKS) != 0)
+	{
+		fprintf(out, "Error allocating memory for the seek index\n");
+		ret = 1;
+	}
+	else if (openMidiOutput(&o, out) != 0)
+	{
+		fprintf(out, "Error allocating memory for track output\n");
+		freeMidiSeekIndex(&seek);
+		ret = 1;
+	}
+	else
+	{
+		endTick = (opts->seekEnd < 0) ? ULONG_MAX : tempoMicrosToTick(&seek.tempo, opts->seekEnd * 1e6);
+		for (i = 0; i < t.numTracks; i++)
+		{
+			outFormat(&o, "Track %d\n", i);
+			if (!midiSeekMicros(&seek, i, opts->seekStart * 1e6, &c, &tick))
+				continue;
+			seg = tempoFindSegment(&seek.tempo, tick);
+			MIDI_PROFILE_START(start);
+			while (cursorReadEvent(&c, &ev) && (tick + ev.deltaTime < endTick))
+			{
+				tick += ev.deltaTime;
+				seg = tempoSegment(&seek.tempo, seg, tick);
+				outFormat(&o, "   Tick %lu, %.3f s\n", tick, tempoSegmentMicros(&seek.tempo, seg, tick) / 1e6);
+				printMidiEvent(&o, &ev);
+			}
+			MIDI_PROFILE_STOP(start, MIDI_PROFILE_DECODE);
+		}
+		closeMidiOutput(&o);
+		freeMidiSeekIndex(&seek);
+		ret = checkMidiTracks(out, &t);
+	}
+
+	closeMidiTracks(&t);
+	return ret;
+}
+
+/** @fn static int sameTrackEvents(struct MidiCursor a, struct MidiCursor b)
+ *  @brief Check that two tracks decode to the same events, up to End of Track
+ */
+static int sameTrackEvents(struct MidiCursor a, struct MidiCursor b)
+{
+	struct MidiEvent x, y;
+	int readA, readB;
+
+	for (;;)
+	{
+		readA = cursorReadEvent(&a, &x);
+		readB = cursorReadEvent(&b, &y);
+		if (!readA || !readB)
+			return (readA == readB) && !a.error && !b.error;
+		if ((x.deltaTime != y.deltaTime) || (x.status != y.status) || (x.data1 != y.data1) ||
+			(x.data2 != y.data2) || (x.length != y.length) || ((x.length > 0) && (memcmp(x.data, y.data, x.length) != 0)))
+			return 0;
+		if ((x.status == 0xFF) && (x.data1 == 0x2f))
+			return 1;
+	}
+}
+
+/** @fn static int rewriteMidiFile(const char *filename, FILE *out, void *arg)
+ *  @brief Write a compacted copy of a MIDI file and report the size of each track
+ *
+ * Each track is encoded again with running status and the shortest
+ * delta times, see MidiWriter.h, and anything after its End of Track
+ * event is dropped. A track is copied byte for byte instead when its
+ * encoding is not smaller, or does not decode to the same events (a
+ * truncated track, or events the decoder does not fully read).\n
+ * Nothing is written when a track chunk is missing or has a bad id.
+ *
+ * @param filename: The MIDI file to read
+ * @param out: The stream to print the report to
+ * @param arg: The command line options, holding the file to write
+ * @return 0 on success, 1 if the file could not be read or the copy could not be written
+ */
+static int rewriteMidiFile(const char *filename, FILE *out, void *arg)
+{
+	const struct Options *opts = (const struct Options *)arg;
+	struct MidiTracks t;
+	struct MidiCursor c, encoded;
+	struct MidiTrackWriter tw;
+	struct MidiWriter w;
+	struct MidiEvent ev;
+	size_t size, written = MIDI_STREAM_HEADER_SIZE;
+	FILE *f;
+	int i, ret = 0;
+
+	if (openMidiTracks(&t, filename, out) != 0)
+		return 1;
+
+	// A file with a bad track chunk is not rewritten, the copy would lose tracks
+	if (checkMidiTracks(out, &t) != 0)
+		ret = 1;
+	else if ((f = fopen(opts->rewritePath, "wb")) == NULL)
+	{
+		fprintf(out, "Unable to create file: %s\n", opts->rewritePath);
+		ret = 1;
+	}
+	else if (openMidiWriter(&w, f, t.head.uFormat, t.numTracks, t.head.sTimeDiv) != 0)
+	{
+		fprintf(out, "Error allocating memory for the MIDI writer\n");
+		fclose(f);
+		ret = 1;
+	}
+	else
+	{
+		initMidiTrackWriter(&tw);
+		for (i = 0; i < t.numTracks; i++)
+		{
+			resetMidiTrackWriter(&tw);
+			c = t.tracks[i];
+			MIDI_PROFILE_START(start);
+			while (cursorReadEvent(&c, &ev) && (writeMidiEvent(&tw, &ev) == 0) && !((ev.status == 0xFF) && (ev.data1 == 0x2f)))
+				;
+			MIDI_PROFILE_STOP(start, MIDI_PROFILE_DECODE);
+			size = t.tracks[i].end - t.tracks[i].pos;
+			initCursor(&encoded, tw.data, tw.size);
+			if (!tw.error && (tw.size < size) && sameTrackEvents(t.tracks[i], encoded))
+			{
+				writeMidiTrackChunk(&w, tw.data, tw.size);
+				fprintf(out, "Track %d: %zu -> %zu bytes\n", i, size, tw.size);
+				size = tw.size;
+			}
+			else
+			{
+				writeMidiTrackChunk(&w, t.tracks[i].pos, size);
+				fprintf(out, "Track %d: %zu bytes, copied\n", i, size);
+			}
+			written += MIDI_STREAM_CHUNK_SIZE + size;
+		}
+		freeMidiTrackWriter(&tw);
+		if ((closeMidiWriter(&w) != 0) | (fclose(f) != 0))
+		{
+			fprintf(out, "Error writing file: %s\n", opts->rewritePath);
+			ret = 1;
+		}
+		else
+			fprintf(out, "Wrote %s: %zu -> %zu bytes\n", opts->rewritePath, t.buf.size, written);
+	}
+
+	closeMidiTracks(&t);
+	return ret;
+}
+
+/** @fn static int fingerprintMidiFile(const char *filename, FILE *out, void *arg)
+ *  @brief Print the normalized fingerprint of a MIDI file
+ *
+ * One line per file, the fingerprint in hex and the file name, so the
+ * output of a batch can be sorted to bring copies together. Errors go
+ * to stderr.
+ *
+ * @param filename: The MIDI file to read
+ * @param out: The stream to print to
+ * @param arg: The command line options, not used
+ * @return 0 on success, 1 if the file could not be read or is not valid
+ */
+static int fingerprintMidiFile(const char *filename, FILE *out, void *arg)
+{
+	struct MidiBuffer bufMIDI;
+	uint64_t fingerprint;
+	int ret;
+
+	(void)arg;
+	if (loadMidiBuffer(filename, &bufMIDI) != 0)
+	{
+		fprintf(stderr, "Unable to open file: %s\n", filename);
+		return 1;
+	}
+	ret = midiFingerprint(bufMIDI.data, bufMIDI.size, &fingerprint);
+	freeMidiBuffer(&bufMIDI);
+	if (ret < 0)
+	{
+		fprintf(stderr, "Error allocating memory for track hashes: %s\n", filename);
+		return 1;
+	}
+	if (ret > 0)
+	{
+		fprintf(stderr, "Incorrect %s header id: %s\n", (ret == 1) ? "file" : "track", filename);
+		return 1;
+	}
+	fprintf(out, "%016llx  %s\n", (unsigned long long)fingerprint, filename);
+	return 0;
+}
+
+/** @struct IndexBuild
+ *  @brief The files being indexed and the words of each, see buildMidiIndex()
+ */
+struct IndexBuild
+{
+	const struct MidiFileList *files;
+	struct MidiTermList *lists;
+	int failed;
+};
+
+/** @fn static void indexMidiFile(size_t i, void *arg)
+ *  @brief runMidiParallel() item, collects the words of one file
+ */
+static void indexMidiFile(size_t i, void *arg)
+{
+	struct IndexBuild *build = (struct IndexBuild *)arg;
+	const char *filename = build->files->paths[i];
+	struct MidiBuffer bufMIDI;
+	int ret;
+
+	if (loadMidiBuffer(filename, &bufMIDI) != 0)
+	{
+		fprintf(stderr, "Unable to open file: %s\n", filename);
+		__atomic_add_fetch(&build->failed, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	ret = collectMidiTerms(&build->lists[i], bufMIDI.data, bufMIDI.size);
+	freeMidiBuffer(&bufMIDI);
+	if (ret != 0)
+	{
+		if (ret < 0)
+			fprintf(stderr, "Error allocating memory for index terms: %s\n", filename);
+		else
+			fprintf(stderr, "Incorrect file header id: %s\n", filename);
+		freeMidiTermList(&build->lists[i]);
+		__atomic_add_fetch(&build->failed, 1, __ATOMIC_RELAXED);
+	}
+}
+
+/** @fn static int buildMidiIndex(const char *indexPath, const struct MidiFileList *files, int workers)
+ *  @brief Write the index of the text Meta events of a list of files
+ *
+ * The words of each file are collected on a pool of worker threads,
+ * then sorted together into the index. Files that cannot be read keep
+ * their file ID but have no words.
+ *
+ * @param indexPath: The index file to write
+ * @param files: The files to index
+ * @param workers: Number of worker threads, 0 for one per processor
+ * @return 0 on success, 1 if any file failed or the index could not be written
+ */
+static int buildMidiIndex(const char *indexPath, const struct MidiFileList *files, int workers)
+{
+	struct IndexBuild build;
+	size_t i;
+	int ret = 0;
+
+	build.files = files;
+	build.failed = 0;
+	build.lists = (struct MidiTermList *)malloc((files->count ? files->count : 1) * sizeof(struct MidiTermList));
+	if (build.lists == NULL)
+	{
+		printf("Error allocating memory for index terms\n");
+		return 1;
+	}
+	for (i = 0; i < files->count; i++)
+		initMidiTermList(&build.lists[i]);
+
+	if (runMidiParallel(files->count, workers, indexMidiFile, &build) != 0)
+	{
+		printf("Error allocating memory for worker threads\n");
+		ret = 1;
+	}
+	else if (writeMidiIndex(indexPath, files->paths, build.lists, files->count) != 0)
+	{
+		fprintf(stderr, "Unable to write index: %s\n", indexPath);
+		ret = 1;
+	}
+	else if (build.failed > 0)
+	{
+		fprintf(stderr, "%d of %zu files failed\n", build.failed, files->count);
+		ret = 1;
+	}
+	for (i = 0; i < files->count; i++)
+		freeMidiTermList(&build.lists[i]);
+	free(build.lists);
+	return ret;
+}
+
+/** @fn static int queryMidiIndex(const char *indexPath, char *const *words, int numWords)
+ *  @brief Print the files of an index containing all the words of a query
+ *
+ * One line per file in the order they were indexed: the path and the
+ * Meta types the words were found in, see searchMidiIndex() for the
+ * query syntax.
+ *
+ * @param indexPath: The index file
+ * @param words: The query words
+ * @param numWords: Number of query words
+ * @return 0 if any file matched, 1 if none did or on error
+ */
+static int queryMidiIndex(const char *indexPath, char *const *words, int numWords)
+{
+	struct MidiIndex idx;
+	struct MidiIndexPosting *found;
+	const char *path, *sep;
+	size_t count, i;
+	uint32_t len;
+	int ret, t;
+
+	if ((ret = openMidiIndex(&idx, indexPath)) != 0)
+	{
+		fprintf(stderr, (ret < 0) ? "Unable to open index: %s\n" : "Not an index file: %s\n", indexPath);
+		return 1;
+	}
+	if (searchMidiIndex(&idx, words, numWords, &found, &count) != 0)
+	{
+		fprintf(stderr, "Error allocating memory for search results\n");
+		closeMidiIndex(&idx);
+		return 1;
+	}
+	for (i = 0; i < count; i++)
+	{
+		if ((path = midiIndexPath(&idx, found[i].file, &len)) == NULL)
+			continue;
+		fwrite(path, 1, len, stdout);
+		sep = "  ";
+		for (t = 0x01; t <= 0x07; t++)
+		{
+			if (found[i].types & MIDI_INDEX_TYPE(t))
+			{
+				printf("%s%s", sep, midiIndexTypeName(t));
+				sep = ",";
+			}
+		}
+		putchar('\n');
+	}
+	free(found);
+	closeMidiIndex(&idx);
+	return (count > 0) ? 0 : 1;
+}
+
+/** @fn static int cachedMidiFile(const char *filename, FILE *out, void *arg)
+ *  @brief Answer from the result cache, or run the job and cache its output
+ *
+ * A file whose size and modification time (and with --cache-verify its
+ * content hash) match its cache entry is not read, its cached output is
+ * written as it is. Only results of files that succeeded are cached,
+ * a failing file runs the job again so its error is always reported
+ * (with --stats=json errors go to stderr, which is not captured).
+ *
+ * @param filename: The MIDI file
+ * @param out: The stream to print to
+ * @param arg: The command line options
+ * @return The return value of the job, cached or not
+ */
+static int cachedMidiFile(const char *filename, FILE *out, void *arg)
+{
+	const struct Options *opts = (const struct Options *)arg;
+	struct MidiCache *cache = opts->cache;
+	const struct MidiCacheEntry *e;
+	const char *result;
+	struct stat st;
+	uint64_t hash = 0;
+	char *text = NULL;
+	size_t size = 0;
+	FILE *mem;
+	int ret;
+
+	if (stat(filename, &st) != 0)
+		return opts->uncachedJob(filename, out, arg);
+	if (cache->verify)
+		hash = hashMidiFile(filename);
+
+	if (((e = midiCacheLookup(cache, filename, &st, hash, &result)) != NULL) && (e->status == 0))
+	{
+		fwrite(result, 1, e->resultLen, out);
+		midiCacheAdd(cache, filename, &st, e->contentHash, result, e->resultLen, e->status);
+		return e->status;
+	}
+
+	if ((mem = open_memstream(&text, &size)) == NULL)
+		return opts->uncachedJob(filename, out, arg);
+	ret = opts->uncachedJob(filename, mem, arg);
+	fclose(mem);
+	fwrite(text, 1, size, out);
+	if (ret == 0)
+		midiCacheAdd(cache, filename, &st, hash, text, size, ret);
+	free(text);
+	return ret;
+}
+
+/** @fn static int openResultCache(struct Options *opts, struct MidiCache *cache, const char *path, int verify)
+ *  @brief Put the result cache in front of the job
+ *
+ * The cache mode records the job and the options changing its output,
+ * a cache built with others is not used.
+ *
+ * @return 0 on success, 1 if the job cannot be cached
+ */
+static int openResultCache(struct Options *opts, struct MidiCache *cache, const char *path, int verify)
+{
+	char mode[MIDI_CACHE_MODE];
+
+	if (opts->job == summariseMidiFile)
+		snprintf(mode, sizeof(mode), "summary%s", opts->batch ? ",batch" : "");
+	else if (opts->job == statsMidiFile)
+		snprintf(mode, sizeof(mode), "stats=%s", opts->statsJson ? "json" : (opts->batch ? "text,batch" : "text"));
+	else
+	{
+		printf("--cache only applies to --summary and --stats\n");
+		return 1;
+	}
+	openMidiCache(cache, path, mode, verify);
+	opts->cache = cache;
+	opts->uncachedJob = opts->job;
+	opts->job = cachedMidiFile;
+	return 0;
+}
+
+/** @fn static void closeResultCache(struct Options *opts, const char *path)
+ *  @brief Write the results of this run as the new cache file
+ */
+static void closeResultCache(struct Options *opts, const char *path)
+{
+	if (writeMidiCache(opts->cache, path) != 0)
+		fprintf(stderr, "Unable to write cache: %s\n", path);
+	closeMidiCache(opts->cache);
+	opts->cache = NULL;
+}
+
+#ifdef MIDI_PROFILE
+/** @fn static int profiledMidiFile(const char *filename, FILE *out, void *arg)
+ *  @brief Run the job on a file and add its time and size to the profile
+ *
+ * @param filename: The MIDI file
+ * @param out: The stream to print to
+ * @param arg: The command line options
+ * @return The return value of the job
+ */
+static int profiledMidiFile(const char *filename, FILE *out, void *arg)
+{
+	const struct Options *opts = (const struct Options *)arg;
+	unsigned long long bytes = midiProfile.bytes;
+	uint64_t start = midiProfileNow();
+	int ret;
+
+	ret = opts->profiledJob(filename, out, arg);
+	addMidiProfileFile(filename, midiProfileNow() - start, midiProfile.bytes - bytes, ret);
+	flushMidiProfile();
+	return ret;
+}
+#endif
+
+/** @fn static void startProfile(struct Options *opts)
+ *  @brief Put the profile in front of the job, outside the result cache
+ */
+static void startProfile(struct Options *opts)
+{
+#ifdef MIDI_PROFILE
+	if (opts->profile < 0)
+		return;
+	opts->profiledJob = opts->job;
+	opts->job = profiledMidiFile;
+#else
+	(void)opts;
+#endif
+}
+
+/** @fn static void finishProfile(const struct Options *opts, uint64_t start)
+ *  @brief Write the profile of the run to stderr, after the output of every file
+ *
+ * @param opts: The command line options
+ * @param start: Monotonic clock at the start of the run, see midiProfileNow()
+ */
+static void finishProfile(const struct Options *opts, uint64_t start)
+{
+#ifdef MIDI_PROFILE
+	struct MidiOutput o;
+
+	if (opts->profile < 0)
+		return;
+	fflush(stdout);
+	if (openMidiOutput(&o, stderr) != 0)
+		return;
+	writeMidiProfile(&o, opts->profile, midiProfileNow() - start);
+	closeMidiOutput(&o);
+#else
+	(void)opts;
+	(void)start;
+#endif
+}
+
+/** @fn static void writeExportHeader(const struct Options *opts)
+ *  @brief Write the start of an export to stdout, once before any file
+ */
+static void writeExportHeader(const struct Options *opts)
+{
+	struct MidiOutput o;
+
+	if (openMidiOutput(&o, stdout) != 0)
+		return;
+	exportHeader(&o, opts->exportFormat, opts->batch);
+	closeMidiOutput(&o);
+}
+
+/** @fn static int exportMergedTracks(struct MidiExport *x, const struct TempoMap *tempo, const struct MidiCursor *tracks, int numTracks)
+ *  @brief Export the events of all tracks in global tick order, see MidiMerge.h
+ *
+ * @return 0 on success, 1 if memory could not be allocated
+ */
+static int exportMergedTracks(struct MidiExport *x, const struct TempoMap *tempo, const struct MidiCursor *tracks, int numTracks)
+{
+	struct MidiMerge m;
+	struct MidiEvent ev;
+	unsigned long tick, seg = 0;
+	int track;
+
+	if (openMidiMerge(&m, tracks, numTracks) != 0)
+		return 1;
+	MIDI_PROFILE_START(start);
+	while (midiMergeNext(&m, &ev, &track, &tick))
+	{
+		seg = tempoSegment(tempo, seg, tick);
+		exportEvent(x, track, tick, tempoSegmentMicros(tempo, seg, tick), &ev);
+	}
+	MIDI_PROFILE_STOP(start, MIDI_PROFILE_DECODE);
+	closeMidiMerge(&m);
+	return 0;
+}
+
+/** @fn static int exportMidiFile(const char *filename, FILE *out, void *arg)
+ *  @brief Write the events of a MIDI file as machine readable records
+ *
+ * Records are written as each track is decoded, see MidiExport.h,
+ * track by track or merged into one time ordered stream.
+ * Errors go to stderr so they do not end up in the record stream.
+ *
+ * @param filename: The MIDI file to read
+ * @param out: The stream to write to
+ * @param arg: The command line options
+ * @return 0 on success, 1 if the file could not be read or is not valid
+ */
+static int exportMidiFile(const char *filename, FILE *out, void *arg)
+{
+	const struct Options *opts = (const struct Options *)arg;
+	struct MidiTracks t;
+	struct MidiOutput o;
+	struct MidiExport x;
+	struct TempoMap tempo;
+	int i, ret = 0;
+
+	// Every track is needed for the tempo map before the first event is written
+	if ((ret = openMidiTracks(&t, filename, stderr)) != 0)
+	{
+		if (ret > 0)
+			fprintf(stderr, "%s: not a valid MIDI file\n", filename);
+		return 1;
+	}
+	if (checkMidiTracks(stderr, &t) != 0)
+	{
+		fprintf(stderr, "%s: track %d not exported\n", filename, t.numTracks);
+		ret = 1;
+	}
+
+	if (buildTempoMap(&tempo, t.head.sTimeDiv, t.tracks, t.numTracks) != 0)
+	{
+		fprintf(stderr, "Error allocating memory for the tempo map\n");
+		ret = 1;
+	}
+	else if ((openMidiOutput(&o, out) != 0) ||
+			 (openMidiExport(&x, &o, opts->exportFormat, opts->batch ? filename : NULL, &tempo) != 0))
+	{
+		fprintf(stderr, "Error allocating memory for track output\n");
+		if (o.buf != NULL)
+			closeMidiOutput(&o);
+		freeTempoMap(&tempo);
+		ret = 1;
+	}
+	else
+	{
+		if (!opts->merge)
+		{
+			for (i = 0; i < t.numTracks; i++)
+				exportTrackEvents(&x, &t.tracks[i], i);
+		}
+		else if (exportMergedTracks(&x, &tempo, t.tracks, t.numTracks) != 0)
+		{
+			fprintf(stderr, "Error allocating memory for track merge\n");
+			ret = 1;
+		}
+		closeMidiExport(&x);
+		closeMidiOutput(&o);
+		freeTempoMap(&tempo);
+	}
+
+	closeMidiTracks(&t);
+	return ret;
+}
+
+// Main entrypoint
+int main(int argc, char **argv)
+{
+
+	// Variables
+	static const struct option longOpts[] = {
+		{"summary", no_argument, NULL, 's'},
+		{"meta", no_argument, NULL, 'M'},
+		{"quiet", no_argument, NULL, 'q'},
+		{"export", required_argument, NULL, 'e'},
+		{"merge", no_argument, NULL, 'O'},
+		{"stream", no_argument, NULL, 'S'},
+		{"notes", no_argument, NULL, 'N'},
+		{"stats", optional_argument, NULL, 'T'},
+		{"seek", required_argument, NULL, 'K'},
+		{"fingerprint", no_argument, NULL, 'F'},
+		{"rewrite", required_argument, NULL, 'W'},
+		{"index-build", required_argument, NULL, 'I'},
+		{"index-query", required_argument, NULL, 'Q'},
+		{"cache", required_argument, NULL, 'c'},
+		{"cache-verify", no_argument, NULL, 'V'},
+		{"stats-timing", optional_argument, NULL, 'P'},
+		{"jobs", required_argument, NULL, 'j'},
+		{"threads", required_argument, NULL, 't'},
+		{"manifest", required_argument, NULL, 'm'},
+		{"help", no_argument, NULL, 'h'},
+		{NULL, 0, NULL, 0}};
+	struct Options opts;
+	struct MidiFileList files = {NULL, 0, 0};
+	struct MidiCache cache;
+	const char *cachePath = NULL;
+	const char *indexBuild = NULL, *indexQuery = NULL;
+	int cacheVerify = 0;
+	uint64_t start = 0;
+	struct stat st;
+	int i, opt, ret;
+
+	opts.batch = 0;
+	opts.workers = 0;
+	opts.trackWorkers = 1;
+	opts.quiet = 0;
+	opts.exportFormat = MIDI_EXPORT_NONE;
+	opts.merge = 0;
+	opts.stream = 0;
+	opts.statsJson = 0;
+	opts.seekStart = 0;
+	opts.seekEnd = -1;
+	opts.rewritePath = NULL;
+	opts.uncachedJob = NULL;
+	opts.cache = NULL;
+	opts.profile = -1;
+	opts.profiledJob = NULL;
+	opts.job = printMidiFile;
+
+	while ((opt = getopt_long(argc, argv, "sqe:c:j:t:m:h", longOpts, NULL)) != -1)
+	{
+		switch (opt)
+		{
+		case 's':
+			opts.job = summariseMidiFile;
+			break;
+		case 'M':
+			opts.job = printMidiMeta;
+			break;
+		case 'q':
+			opts.quiet = 1;
+			break;
+		case 'e':
+			opts.exportFormat = midiExportFormat(optarg);
+			if (opts.exportFormat == MIDI_EXPORT_NONE)
+			{
+				printf("Unknown export format: %s\n", optarg);
+				freeMidiFileList(&files);
+				return 1;
+			}
+			opts.job = exportMidiFile;
+			break;
+		case 'O':
+			opts.merge = 1;
+			break;
+		case 'S':
+			opts.stream = 1;
+			break;
+		case 'N':
+			opts.job = printMidiNotes;
+			break;
+		case 'F':
+			opts.job = fingerprintMidiFile;
+			break;
+		case 'K':
+			if (parseSeekRange(optarg, &opts) != 0)
+			{
+				printf("Invalid seek range: %s\n", optarg);
+				freeMidiFileList(&files);
+				return 1;
+			}
+			opts.job = seekMidiFile;
+			break;
+		case 'W':
+			opts.rewritePath = optarg;
+			opts.job = rewriteMidiFile;
+			break;
+		case 'T':
+			if ((optarg != NULL) && (strcmp(optarg, "json") != 0) && (strcmp(optarg, "text") != 0))
+			{
+				printf("Unknown stats format: %s\n", optarg);
+				freeMidiFileList(&files);
+				return 1;
+			}
+			opts.statsJson = (optarg != NULL) && (strcmp(optarg, "json") == 0);
+			opts.job = statsMidiFile;
+			break;
+		case 'I':
+			indexBuild = optarg;
+			break;
+		case 'Q':
+			indexQuery = optarg;
+			break;
+		case 'c':
+			cachePath = optarg;
+			break;
+		case 'V':
+			cacheVerify = 1;
+			break;
+		case 'P':
+#ifdef MIDI_PROFILE
+			if ((optarg != NULL) && (strcmp(optarg, "json") != 0) && (strcmp(optarg, "text") != 0))
+			{
+				printf("Unknown stats timing format: %s\n", optarg);
+				freeMidiFileList(&files);
+				return 1;
+			}
+			opts.profile = (optarg != NULL) && (strcmp(optarg, "json") == 0);
+			start = midiProfileNow();
+			break;
+#else
+			printf("--stats-timing needs a build with make PROFILE=1\n");
+			freeMidiFileList(&files);
+			return 1;
+#endif
+		case 'j':
+			opts.workers = atoi(optarg);
+			opts.batch = 1;
+			break;
+		case 't':
+			opts.trackWorkers = atoi(optarg);
+			break;
+		case 'm':
+			if (addMidiManifest(&files, optarg) != 0)
+			{
+				printf("Unable to read manifest: %s\n", optarg);
+				freeMidiFileList(&files);
+				return 1;
+			}
+			opts.batch = 1;
+			break;
+		default:
+			usage(argv[0]);
+			freeMidiFileList(&files);
+			return 0;
+		}
+	}
+
+	// Usage check
+	if ((optind >= argc) && (files.count == 0))
+	{
+		usage(argv[0]);
+		freeMidiFileList(&files);
+		return 0;
+	}
+
+	// The index modes take the remaining arguments as paths or query words
+	if (indexQuery != NULL)
+	{
+		freeMidiFileList(&files);
+		return queryMidiIndex(indexQuery, argv + optind, argc - optind);
+	}
+	if (indexBuild != NULL)
+	{
+		for (i = optind; i < argc; i++)
+		{
+			if (addMidiPath(&files, argv[i]) != 0)
+			{
+				printf("Error allocating memory for file list\n");
+				freeMidiFileList(&files);
+				return 1;
+			}
+		}
+		ret = buildMidiIndex(indexBuild, &files, opts.workers);
+		freeMidiFileList(&files);
+		return ret;
+	}
+
+	// A rewrite has one output file, so one input file
+	if ((opts.rewritePath != NULL) && ((optind != argc - 1) || opts.batch))
+	{
+		printf("--rewrite takes a single MIDI file\n");
+		freeMidiFileList(&files);
+		return 1;
+	}
+
+	// A single file is printed directly, anything else is a batch
+	if ((optind == argc - 1) && !opts.batch)
+	{
+		if ((stat(argv[optind], &st) != 0) || !S_ISDIR(st.st_mode))
+		{
+			if (opts.exportFormat != MIDI_EXPORT_NONE)
+				writeExportHeader(&opts);
+			if ((cachePath != NULL) && (openResultCache(&opts, &cache, cachePath, cacheVerify) != 0))
+				return 1;
+			startProfile(&opts);
+			ret = opts.job(argv[optind], stdout, &opts);
+			fflush(stdout);
+			if (opts.cache != NULL)
+				closeResultCache(&opts, cachePath);
+			finishProfile(&opts, start);
+			return ret;
+		}
+	}
+	opts.batch = 1;
+	if (opts.exportFormat != MIDI_EXPORT_NONE)
+		writeExportHeader(&opts);
+	if ((cachePath != NULL) && (openResultCache(&opts, &cache, cachePath, cacheVerify) != 0))
+	{
+		freeMidiFileList(&files);
+		return 1;
+	}
+
+	for (i = optind; i < argc; i++)
+	{
+		if (addMidiPath(&files, argv[i]) != 0)
+		{
+			printf("Error allocating memory for file list\n");
+			freeMidiFileList(&files);
+			return 1;
+		}
+	}
+
+	startProfile(&opts);
+	ret = runMidiBatch(&files, opts.workers, opts.job, &opts, stdout);
+	if (ret < 0)
+		printf("Error allocating memory for worker threads\n");
+	else if (ret > 0)
+		fprintf(stderr, "%d of %zu files failed\n", ret, files.count);
+	if (opts.cache != NULL)
+		closeResultCache(&opts, cachePath);
+	finishProfile(&opts, start);
+	freeMidiFileList(&files);
+	return (ret != 0) ? 1 : 0;
+}